@@ -21,70 +21,289 @@
 #define MONYA_BINARY_TREE_PROGRAM_HPP__
 
 #include "common/types.hpp"
+#include "TreeProgram.hpp"
 #include "structures/BinaryTree.hpp"
 #include "structures/BinaryNode.hpp"
-#include "io/IOfactory.hpp"
-#include "structures/Scheduler.hpp"
+#include "structures/Stack.hpp"
+#include "structures/FlatBinaryTree.hpp"
+#include "structures/SampleVector.hpp"
+#include "common/distance.hpp"
+#include "common/NNVector.hpp"
 
 // NOTE: We initally assume all the Trees are the same
 namespace monya {
-    class BinaryTreeProgram: public container::BinaryTree {
+    class BinaryTreeProgram: public TreeProgram, public container::BinaryTree {
         private:
 
         protected:
-            tree_t tree_id; // The ID of this tree
-            short numa_id; // NUMA node
-            std::string exmem_fn;
-            io::IO::raw_ptr ioer;
-            size_t nsamples; // Max # of samples from which the tree is built
-            size_t nfeatures; // Number of features
-            container::Scheduler* scheduler;
+            container::FlatBinaryTree::ptr frozen; // Query layout
+
+            // A group of queries (by index into a block) bound for a node
+            struct blocked_visit {
+                node_id_t id;
+                std::vector<unsigned> qids;
+                bool far; // Not the side the queries fall into
+                // Per query lower bound on the distance to the node's
+                //  members: the farthest split plane crossed to reach it
+                std::vector<data_t> bounds;
+            };
+
+            // Squared distance from `sample` to the box around the members
+            static data_t box_dist2(const data_t* sample, const data_t* lower,
+                    const data_t* upper, const size_t nfeatures) {
+                data_t dist = 0;
+                for (size_t j = 0; j < nfeatures; j++) {
+                    data_t diff = sample[j] < lower[j] ? lower[j] - sample[j] :
+                        sample[j] > upper[j] ? sample[j] - upper[j] : 0;
+                    dist += diff*diff;
+                }
+                return dist;
+            }
 
-        public:
-            typedef std::shared_ptr<BinaryTreeProgram> ptr;
+            // Squared distance from `sample` to the farthest corner of the box
+            static data_t box_max_dist2(const data_t* sample,
+                    const data_t* lower, const data_t* upper,
+                    const size_t nfeatures) {
+                data_t dist = 0;
+                for (size_t j = 0; j < nfeatures; j++) {
+                    data_t diff = std::max(sample[j] - lower[j],
+                            upper[j] - sample[j]);
+                    dist += diff*diff;
+                }
+                return dist;
+            }
 
-            // Use BinaryTree ctor
-            BinaryTreeProgram() : container::BinaryTree() {
+            // Gather the leaf once & screen its distance to every query in
+            //  `qids` with one small GEMM. Members that may enter a query's
+            //  kNN get their distance recomputed directly so results match
+            //  find_neighbors exactly.
+            void scan_leaf(container::BinaryNode* leaf,
+                    const std::vector<unsigned>& qids,
+                    container::ProximityQuery** block, data_t* qdata) {
+                size_t nread = 0; // Shared by the queries in `qids`
+                if (pager) nread += leaf->cache(pager); // Fault the leaf in
+
+                std::vector<sample_id_t> ids;
+                for (IndexVal<data_t> iv : leaf->get_data_index())
+                    if (!is_deleted(iv.get_index()))
+                        ids.push_back(iv.get_index());
+
+                std::vector<data_t> members(ids.size()*nfeatures);
+                for (size_t i = 0; i < ids.size(); i++) {
+                    data_t* member = ioer->get_row(ids[i]);
+                    std::copy(member, member+nfeatures,
+                            &members[i*nfeatures]);
+                    if (ioer->get_orientation() != ROW)
+                        delete [] member;
+                }
+                if (pager) leaf->uncache(pager);
+                nread += members.size()*sizeof(data_t);
+
+                for (auto qid : qids) {
+                    container::QueryStats& stats = block[qid]->get_stats();
+                    stats[container::QueryStats::LEAVES]++;
+                    stats[container::QueryStats::DISTANCES] += ids.size();
+                    stats[container::QueryStats::IO_BYTES] +=
+                        nread / qids.size();
+                }
+                if (ids.empty())
+                    return;
+
+                // Centering on the members keeps the norms small so the
+                //  GEMM form loses little precision for nearby queries
+                std::vector<double> centroid(nfeatures, 0);
+                for (size_t i = 0; i < ids.size(); i++)
+                    for (size_t j = 0; j < nfeatures; j++)
+                        centroid[j] += members[i*nfeatures+j];
+                for (size_t j = 0; j < nfeatures; j++)
+                    centroid[j] /= ids.size();
+
+                data_t max_norm2 = 0; // Of the centered members
+                std::vector<data_t> centered(members.size());
+                for (size_t i = 0; i < ids.size(); i++) {
+                    data_t norm2 = 0;
+                    for (size_t j = 0; j < nfeatures; j++) {
+                        centered[i*nfeatures+j] =
+                            members[i*nfeatures+j] - centroid[j];
+                        norm2 += centered[i*nfeatures+j]*
+                            centered[i*nfeatures+j];
+                    }
+                    max_norm2 = std::max(max_norm2, norm2);
+                }
+
+                std::vector<data_t> queries(qids.size()*nfeatures);
+                std::vector<data_t> qnorm2(qids.size(), 0);
+                for (size_t i = 0; i < qids.size(); i++)
+                    for (size_t j = 0; j < nfeatures; j++) {
+                        queries[i*nfeatures+j] =
+                            qdata[qids[i]*nfeatures+j] - centroid[j];
+                        qnorm2[i] += queries[i*nfeatures+j]*
+                            queries[i*nfeatures+j];
+                    }
+
+                std::vector<data_t> dists(qids.size()*ids.size());
+                distance::euclidean(&queries[0], qids.size(), &centered[0],
+                        ids.size(), nfeatures, &dists[0]);
+
+                for (size_t i = 0; i < qids.size(); i++) {
+                    container::ProximityQuery* query = block[qids[i]];
+                    NNVector* nnv = query->getNN()[tree_id];
+                    const size_t k = query->get_k();
+                    data_t* sample = &qdata[qids[i]*nfeatures];
+                    const data_t slack = distance::gemm_slack(nfeatures,
+                            qnorm2[i], max_norm2);
+
+                    data_t kth = nnv->size() < k ?
+                        std::numeric_limits<data_t>::max() :
+                        (*nnv)[k-1].get_val();
+                    for (size_t j = 0; j < ids.size(); j++) {
+                        const data_t dist = dists[i*ids.size()+j];
+                        if (kth != std::numeric_limits<data_t>::max() &&
+                                dist*dist > kth*kth + slack)
+                            continue;
+
+                        query->eval(ids[j], distance::euclidean(sample,
+                                    &members[j*nfeatures], nfeatures),
+                                tree_id);
+                        query->get_stats()[
+                            container::QueryStats::RESCORED]++;
+                        if (nnv->size() == k)
+                            kth = (*nnv)[k-1].get_val();
+                    }
+                }
             }
 
-            void set_numa_id(const short numa_id) {
-                this->numa_id = numa_id;
+            // Carry `nquery` queries down the frozen layout together. At each
+            //  internal node the block is partitioned by the comparator; the
+            //  side a query falls into is visited first. Exact search also
+            //  visits the far side, dropping queries whose k-th neighbor is
+            //  closer than the split planes crossed to get there or a leaf's
+            //  bounds (when the program keeps them).
+            void descend_block(container::ProximityQuery** block,
+                    const size_t nquery, const bool exact) {
+                std::vector<data_t> qdata(nquery*nfeatures);
+                for (size_t i = 0; i < nquery; i++) {
+                    const data_t* sample = block[i]->get_qsample()->dense();
+                    std::copy(sample, sample+nfeatures, &qdata[i*nfeatures]);
+                }
+
+                std::vector<blocked_visit> visits(1);
+                visits[0].id = 0;
+                visits[0].far = false;
+                for (unsigned i = 0; i < nquery; i++)
+                    visits[0].qids.push_back(i);
+                visits[0].bounds.assign(nquery, 0);
+
+                while (!visits.empty()) {
+                    blocked_visit visit = std::move(visits.back());
+                    visits.pop_back();
+                    const container::FlatNode& node =
+                        frozen->get_node(visit.id);
+
+                    // The k-th neighbor may have moved closer since the far
+                    //  side was pushed. Compared unsquared so rounding can't
+                    //  drop a member nearer than the k-th
+                    if (visit.far) {
+                        std::vector<unsigned> live;
+                        std::vector<data_t> live_bounds;
+                        for (size_t i = 0; i < visit.qids.size(); i++) {
+                            const unsigned qid = visit.qids[i];
+                            NNVector* nnv = block[qid]->getNN()[tree_id];
+                            const size_t k = block[qid]->get_k();
+                            if (nnv->size() == k &&
+                                    visit.bounds[i] >= (*nnv)[k-1].get_val()) {
+                                block[qid]->get_stats()[
+                                    container::QueryStats::PRUNED]++;
+                                continue;
+                            }
+                            live.push_back(qid);
+                            live_bounds.push_back(visit.bounds[i]);
+                        }
+                        visit.qids.swap(live);
+                        visit.bounds.swap(live_bounds);
+                        if (visit.qids.empty())
+                            continue;
+                    }
+
+                    if (!node.is_leaf()) {
+                        blocked_visit lnear { node.child, {}, visit.far, {} };
+                        blocked_visit rnear { node.child+1, {}, visit.far, {} };
+                        blocked_visit lfar { node.child, {}, true, {} };
+                        blocked_visit rfar { node.child+1, {}, true, {} };
+                        for (size_t i = 0; i < visit.qids.size(); i++) {
+                            const unsigned qid = visit.qids[i];
+                            const data_t* sample = &qdata[qid*nfeatures];
+                            block[qid]->get_stats()[
+                                container::QueryStats::NODES]++;
+                            const bool left =
+                                frozen->get_child(node, sample) == node.child;
+                            blocked_visit& near = left ? lnear : rnear;
+                            near.qids.push_back(qid);
+                            near.bounds.push_back(visit.bounds[i]);
+
+                            if (exact) {
+                                blocked_visit& far = left ? rfar : lfar;
+                                far.qids.push_back(qid);
+                                far.bounds.push_back(std::max(visit.bounds[i],
+                                            std::abs(sample[node.split_dim] -
+                                                node.comparator)));
+                            }
+                        }
+
+                        // Stack: Far sides are popped after the near subtrees
+                        for (blocked_visit* next : { &lfar, &rfar, &rnear,
+                                &lnear })
+                            if (!next->qids.empty())
+                                visits.push_back(std::move(*next));
+                        continue;
+                    }
+
+                    container::BinaryNode* leaf = frozen->get_leaf(node);
+                    if (NULL == leaf)
+                        continue;
+
+                    const data_t* lower = leaf->get_lower_bounds();
+                    const data_t* upper = leaf->get_upper_bounds();
+                    if (visit.far && lower && upper) {
+                        std::vector<unsigned> live;
+                        for (auto qid : visit.qids) {
+                            NNVector* nnv = block[qid]->getNN()[tree_id];
+                            const size_t k = block[qid]->get_k();
+                            if (nnv->size() < k) {
+                                live.push_back(qid);
+                                continue;
+                            }
+                            data_t kth = (*nnv)[k-1].get_val();
+                            if (box_dist2(&qdata[qid*nfeatures], lower, upper,
+                                        nfeatures) < kth*kth)
+                                live.push_back(qid);
+                            else
+                                block[qid]->get_stats()[
+                                    container::QueryStats::PRUNED]++;
+                        }
+                        visit.qids.swap(live);
+                    }
+
+                    if (!visit.qids.empty())
+                        scan_leaf(leaf, visit.qids, block, &qdata[0]);
+                }
             }
 
-            const short get_numa_id() const {
-                return numa_id;
+        public:
+            typedef std::shared_ptr<BinaryTreeProgram> ptr;
+
+            // Use BinaryTree ctor
+            BinaryTreeProgram() : TreeProgram(), container::BinaryTree() {
             }
 
             BinaryTreeProgram(Params& params, const tree_t _tree_id,
                     const int _numa_id=0) :
-                tree_id (_tree_id), numa_id(_numa_id) {
-
-                exmem_fn = params.fn;
-                // Configure ioer
-                ioer = IOfactory::create(params.iotype);
-                ioer->set_fn(exmem_fn);
-                ioer->set_orientation(params.orientation);
-                ioer->shape(dimpair(params.nsamples, params.nfeatures));
-
-                if (params.iotype == io_t::MEM)
-                    static_cast<io::MemoryIO*>(ioer)->from_file();
+                TreeProgram(params, _tree_id, _numa_id) {
+                assert(params.fanout == 2);
 
                 // Configure Tree
                 max_depth = params.max_depth;
                 depth = 0;
-                nsamples = params.nsamples;
-                nfeatures = params.nfeatures;
-
-                assert(params.fanout == 2);
-                unsigned nworkers = std::max(1,
-                        static_cast<int>(params.nthread/params.ntree));
-#ifdef USE_NUMA
-                scheduler = new container::Scheduler(params.fanout,
-                        params.max_depth, tree_id, nworkers, numa_id);
-#else
-                scheduler = new container::Scheduler(params.fanout,
-                        params.max_depth, tree_id, nworkers, 0;
-#endif
             }
 
             void set_root(container::BinaryNode*& node) {
@@ -92,17 +311,10 @@ namespace monya {
                 assert(NULL != ioer);
 
                 node->set_ioer(ioer);
+                node->set_colcache(colcache);
                 BinaryTree::set_root(node);
             }
 
-            container::Scheduler* get_scheduler() {
-                return scheduler;
-            }
-
-            void set_scheduler(container::Scheduler* scheduler) {
-                this->scheduler = scheduler;
-            }
-
             static BinaryTreeProgram* create_raw() {
                 return new BinaryTreeProgram();
             }
@@ -111,43 +323,170 @@ namespace monya {
                 return ptr(new BinaryTreeProgram);
             }
 
-            void set_ioer(io::IO::raw_ptr ioer) {
-                this->ioer = ioer;
+            void descend() {
+                depth++;
             }
 
-            io::IO::raw_ptr get_ioer() {
-                assert(NULL != this->ioer);
-                return ioer;
+            void get_leaves(std::vector<container::NodeView*>& leaves)
+                override {
+                container::Stack<container::BinaryNode*> stack;
+                if (get_root())
+                    stack.push(get_root());
+
+                while (!stack.empty()) {
+                    container::BinaryNode* node = stack.pop();
+                    if (!node->has_child()) {
+                        leaves.push_back(node);
+                    } else {
+                        if (node->left) stack.push(node->left);
+                        if (node->right) stack.push(node->right);
+                    }
+                }
             }
 
-            void set_id(const tree_t tid) {
-                this->tree_id = tid;
+            // Sibling leaves form a group
+            void get_leaf_groups(
+                    std::vector<std::vector<container::NodeView*> >& groups)
+                override {
+                std::vector<container::NodeView*> leaves;
+                get_leaves(leaves);
+                for (auto node : leaves) {
+                    container::BinaryNode* leaf =
+                        container::BinaryNode::cast2(node);
+                    container::BinaryNode* parent = leaf->get_parent();
+                    if (NULL == parent) {
+                        groups.push_back({ leaf });
+                        continue;
+                    }
+
+                    container::BinaryNode* sibling = parent->left == leaf ?
+                        parent->right : parent->left;
+                    if (NULL == sibling || sibling->has_child())
+                        groups.push_back({ leaf });
+                    else if (parent->left == leaf)
+                        groups.push_back({ leaf, sibling });
+                    // else: Grouped with its left sibling
+                }
             }
 
-            const tree_t get_id() const {
-                return tree_id;
+            // Splits are a feature & a comparator (BinaryNode::to_em), which
+            //  FlatBinaryTree & EMForest rely on. Programs splitting any
+            //  other way return false
+            virtual const bool axis_aligned() const {
+                return true;
             }
 
-            const std::string get_exmem_fn() const {
-                return this->exmem_fn;
+            // Build the pointer free query layout. Call once training is done
+            virtual void freeze() override {
+                frozen = container::FlatBinaryTree::create(get_root());
             }
 
-            void set_exmem_fn(const std::string exmem_fn) {
-                this->exmem_fn = exmem_fn;
+            container::FlatBinaryTree::ptr get_frozen() {
+                return frozen;
             }
 
-            void descend() {
-                depth++;
+            virtual void find_neighbors(container::Query* q) override {
+                container::BinaryTree::find_neighbors(q);
+            }
+
+            /**
+              \brief Blocked euclidean kNN over the frozen layout. Programs
+                with axis aligned splits (FlatBinaryTree) can answer
+                find_neighbors_batch with this. Each leaf is read once per
+                block of queries reaching it. Blocks run in parallel.
+              */
+            void find_neighbors_blocked(container::BatchProximityQuery* batch) {
+                assert(NULL != frozen); // ComputeEngine::train freezes the tree
+                std::vector<container::ProximityQuery*>& queries =
+                    batch->get_queries();
+                const size_t block = batch->get_block();
+                const size_t nblock = (queries.size() + block - 1) / block;
+
+                container::ReadGuard guard(scheduler);
+#pragma omp parallel for num_threads (get_nthread()) schedule(dynamic)
+                for (size_t b = 0; b < nblock; b++)
+                    descend_block(&queries[b*block], std::min(block,
+                                queries.size() - b*block), batch->is_exact());
             }
 
-            void destroy() {
-                if (ioer)
-                    ioer->destroy();
+            /**
+              \brief Range search over the frozen layout for programs with
+                axis aligned splits. A subtree is skipped once the split
+                planes on its path put it beyond the radius, & so is a leaf
+                whose bounds (when the program keeps them) are. Count only
+                queries take leaves wholly inside the radius without
+                computing a single distance.
+              */
+            void find_in_range_axis(container::RangeQuery* query) {
+                assert(NULL != frozen); // ComputeEngine::train freezes the tree
+                container::SampleVector* qsample = query->get_qsample();
+                const data_t* sample = qsample->dense();
+                const data_t radius2 = query->get_radius()*query->get_radius();
+                // Leaves are only taken whole when rounding can't matter
+                const data_t inside2 = radius2*(1 - 1e-5);
+
+                container::ReadGuard guard(scheduler);
+
+                // Each entry holds a lower bound on the squared distance to
+                //  the node's members
+                container::Stack<std::pair<node_id_t, data_t> > visited;
+                visited.push(std::make_pair(0, 0));
+
+                while (!visited.empty()) {
+                    std::pair<node_id_t, data_t> top = visited.pop();
+                    if (top.second > radius2)
+                        continue;
+                    const container::FlatNode& node =
+                        frozen->get_node(top.first);
+
+                    if (!node.is_leaf()) {
+                        const node_id_t near = frozen->get_child(node, sample);
+                        const data_t diff =
+                            sample[node.split_dim] - node.comparator;
+                        visited.push(std::make_pair(near == node.child ?
+                                    near+1 : node.child,
+                                    std::max(top.second, diff*diff)));
+                        visited.push(std::make_pair(near, top.second));
+                        continue;
+                    }
+
+                    container::BinaryNode* leaf = frozen->get_leaf(node);
+                    if (NULL == leaf)
+                        continue;
+
+                    bool inside = false;
+                    const data_t* lower = leaf->get_lower_bounds();
+                    const data_t* upper = leaf->get_upper_bounds();
+                    if (lower && upper) {
+                        if (box_dist2(sample, lower, upper, nfeatures) >
+                                radius2)
+                            continue;
+                        inside = query->is_count_only() &&
+                            box_max_dist2(sample, lower, upper, nfeatures) <=
+                            inside2;
+                    }
+
+                    if (pager) leaf->cache(pager); // Fault the leaf in
+                    if (inside) {
+                        size_t nlive = 0;
+                        for (IndexVal<data_t> iv : leaf->get_data_index())
+                            nlive += !is_deleted(iv.get_index());
+                        query->count(nlive, tree_id);
+                    } else {
+                        for (IndexVal<data_t> iv : leaf->get_data_index())
+                            if (!is_deleted(iv.get_index()))
+                                query->eval(iv.get_index(), leaf->distance(
+                                            qsample, iv.get_index()),
+                                        tree_id);
+                    }
+                    if (pager) leaf->uncache(pager);
+                }
             }
 
             // User implemented for training phase
-            virtual void build() {
+            virtual void build() override {
                 assert(NULL != this->get_root());
+                prep_level(0);
                 scheduler->schedule(this->get_root());
 
                 bool one_spawned = false;
@@ -169,29 +508,37 @@ namespace monya {
                         if (curr_node->get_depth() < max_depth
                                 && curr_node->get_data_index().size() > 1) {
                             curr_node->spawn();
+                            // The children's columns load while the rest of
+                            //  the level spawns & the next one starts
+                            if (curr_node->left)
+                                curr_node->left->prefetch();
+                            if (curr_node->right)
+                                curr_node->right->prefetch();
                             if (!one_spawned) one_spawned = true;
                         }
+                        curr_node->release(); // Node is finished
                     }
 
                     // Terminal: No spawning or max depth reached
                     if (procd_level == max_depth || !one_spawned) break;
                     one_spawned = false; // Reset
 
+                    // Nodes that did not spawn leave the level short so it
+                    //  is handed over as a whole
+                    std::vector<container::NodeView*> next_level;
                     for (size_t i = 0; i < procd_nodes.size(); i++) {
                         container::BinaryNode* curr_node =
                             static_cast<container::BinaryNode*>(procd_nodes[i]);
                             if (curr_node->left)
-                                scheduler->schedule(curr_node->left);
+                                next_level.push_back(curr_node->left);
                             if (curr_node->right)
-                                scheduler->schedule(curr_node->right);
+                                next_level.push_back(curr_node->right);
                     }
-                }
-            }
+                    if (next_level.empty()) break; // Spawns can decline
 
-            const unsigned get_nthread() { return scheduler->get_nthread(); }
-
-            ~BinaryTreeProgram() {
-                delete scheduler;
+                    prep_level(procd_level+1);
+                    scheduler->schedule(next_level);
+                }
             }
     };
 } // End monya
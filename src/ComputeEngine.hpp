@@ -22,10 +22,18 @@
 
 #include <memory>
 #include <vector>
+#include <mutex>
+#include <future>
 #include "common/types.hpp"
 #include "common/exception.hpp"
 #include "structures/Query.hpp"
+#include "structures/Tombstone.hpp"
+#include "structures/EMNode.hpp"
+#include "structures/KNNGraph.hpp"
+#include "io/IO.hpp"
+#include "io/ColumnCache.hpp"
 #include "utils/utility.hpp"
+#include "utils/instrument.hpp"
 
 namespace monya {
     template <typename TreeProgramType>
@@ -34,6 +42,31 @@ namespace monya {
         private:
             std::vector<TreeProgramType*> forest; // For when there are more
             Params params;
+            container::Tombstone* tombstones; // Deleted samples
+            io::ColumnCache* colcache; // NULL if columns are in memory as is
+            // Work done by every query run through `query`
+            container::QueryHistograms query_stats;
+            std::mutex query_stats_lock;
+            std::mutex compact_lock; // One compaction pass at a time
+            std::shared_future<void> compaction; // The last background pass
+            std::mutex compaction_lock;
+
+            void init_tombstones() {
+                tombstones = new container::Tombstone(params.nsamples);
+                for (auto tree : forest)
+                    tree->set_tombstones(tombstones);
+            }
+
+            // Only worth it when `get_col` reads or copies
+            void init_colcache() {
+                colcache = NULL;
+                if (params.iotype == io_t::MEM && params.storage == F32 &&
+                        params.orientation == mat_orient_t::COL)
+                    return;
+                colcache = new io::ColumnCache;
+                for (auto tree : forest)
+                    tree->set_colcache(colcache);
+            }
 
             ComputeEngine(Params& params) {
                 this->params = params;
@@ -47,16 +80,17 @@ namespace monya {
                     forest.push_back(new TreeProgramType(params, tree_id));
 #endif
                 }
+                init_tombstones();
+                init_colcache();
             }
 
-            ComputeEngine(std::vector<TreeProgramType*>& forest) {
-                this->forest = forest;
-            }
-
+            // `params` sizes the tombstones & must describe `forest`
             ComputeEngine(Params& params,
                     std::vector<TreeProgramType*>& forest) {
                 this->params = params;
                 this->forest = forest;
+                init_tombstones();
+                init_colcache();
             }
 
         public:
@@ -67,10 +101,6 @@ namespace monya {
                 return ptr(new ComputeEngine<TreeProgramType>());
             }
 
-            static ptr create(std::vector<TreeProgramType*>& forest) {
-                return ptr(new ComputeEngine(forest));
-            }
-
             static ptr create(Params& params) {
                 return ptr(new ComputeEngine<TreeProgramType>(params));
             }
@@ -102,6 +132,9 @@ namespace monya {
 
             void add_tree(TreeProgramType* tree) {
                 this->forest.push_back(tree);
+                tree->set_tombstones(tombstones);
+                if (colcache)
+                    tree->set_colcache(colcache);
             }
 
             void train() {
@@ -111,18 +144,184 @@ namespace monya {
                 for (size_t i = 0; i < forest.size(); i++) {
                     printf("Builing tree %lu! \n", i);
                     forest[i]->build();
+                    forest[i]->freeze();
+                    forest[i]->page_out();
                 }
             }
 
+            /**
+              \brief Per-tree, per-level & per-thread build timings as JSON or,
+                with `chrome`, in Chrome trace format. Call after `train`.
+                Requires building with INSTRUMENT=1
+              */
+            void write_build_trace(std::ostream& os, const bool chrome=false) {
+#ifdef MONYA_INSTRUMENT
+                std::vector<const utils::BuildTrace*> traces;
+                for (auto tree : forest)
+                    traces.push_back(&tree->get_scheduler()->get_trace());
+
+                if (chrome)
+                    utils::write_chrome_trace(os, traces);
+                else
+                    utils::write_build_json(os, traces);
+#else
+                throw parameter_exception(
+                        "Build trace requires compiling with INSTRUMENT=1");
+#endif
+            }
+
             void query(container::Query* pq) {
+                pq->clear_stats();
                 // TODO: Parallelize
                 for (auto tree : forest) {
                     pq->run(tree);
                 }
+
+                std::lock_guard<std::mutex> lock(query_stats_lock);
+                pq->record_stats(query_stats);
+            }
+
+            // Per query counters of every query so far, e.g. to tune depth
+            //  & leaf size. Read while no queries run
+            const container::QueryHistograms& get_query_stats() const {
+                return query_stats;
             }
 
-            void predict() {
-                throw not_implemented_exception();
+            void clear_query_stats() {
+                std::lock_guard<std::mutex> lock(query_stats_lock);
+                query_stats.clear();
+            }
+
+            // Delete a sample from every tree. Safe to call while querying
+            void remove(const sample_id_t id) {
+                tombstones->set(id);
+            }
+
+            void remove(const std::vector<sample_id_t>& ids) {
+                for (auto id : ids)
+                    tombstones->set(id);
+            }
+
+            const size_t nremoved() const {
+                return tombstones->count();
+            }
+
+            // Reclaim the memory held by deleted samples in every tree.
+            //  Queries may run meanwhile; training may not
+            void compact() {
+                std::lock_guard<std::mutex> lock(compact_lock);
+#pragma omp parallel for num_threads(forest.size())
+                for (size_t i = 0; i < forest.size(); i++)
+                    forest[i]->compact();
+            }
+
+            // `compact` on its own thread. Wait on (or `get`, which rethrows)
+            //  the result to know the memory was reclaimed
+            std::shared_future<void> compact_async() {
+                std::lock_guard<std::mutex> lock(compaction_lock);
+                compaction = std::async(std::launch::async,
+                        [this] { compact(); }).share();
+                return compaction;
+            }
+
+            // Write the trained forest to `fn`. Map it back with
+            //  container::EMForest. Deleted samples are left out. Only axis
+            //  aligned splits can be persisted
+            void save(const std::string fn) {
+                std::vector<container::BinaryNode*> roots;
+                std::vector<container::NodePager*> pagers;
+                for (auto tree : forest) {
+                    if (!tree->axis_aligned())
+                        throw not_implemented_exception(__FILE__, __LINE__);
+                    roots.push_back(tree->get_root());
+                    pagers.push_back(tree->get_pager());
+                }
+                container::EMForest::write(fn, roots, params.nfeatures,
+                        pagers, tombstones);
+            }
+
+            /**
+              \brief The kNN of every sample. Since the queries are the data
+                each tree contributes all pairs within its leaf groups
+                (sibling leaves for binary trees) in parallel, then `nrefine`
+                rounds of neighbor-of-neighbor refinement mix the trees'
+                neighborhoods. Write it out with KNNGraph::write.
+              */
+            container::KNNGraph::ptr knn_graph(const unsigned k,
+                    const unsigned nrefine=0) {
+                assert(forest.size());
+                const size_t nsamples = params.nsamples;
+                const size_t nfeatures = params.nfeatures;
+
+                // Row major data. Copied unless it's in memory that way
+                io::IO* ioer = forest[0]->get_ioer();
+                std::vector<data_t> rows;
+                data_t* data;
+                if (params.iotype == io_t::MEM && params.storage == F32 &&
+                        ioer->get_orientation() == mat_orient_t::ROW) {
+                    data = io::MemoryIO::cast2(ioer)->get_data();
+                } else {
+                    rows.resize(nsamples*nfeatures);
+#pragma omp parallel for num_threads(params.nthread) \
+                    if (params.iotype == io_t::MEM)
+                    for (size_t i = 0; i < nsamples; i++) {
+                        data_t* row = ioer->get_row(i);
+                        std::copy(row, row+nfeatures, &rows[i*nfeatures]);
+                        if (ioer->get_orientation() != mat_orient_t::ROW)
+                            delete [] row;
+                    }
+                    data = &rows[0];
+                }
+
+                container::KNNGraph::ptr graph =
+                    container::KNNGraph::create(nsamples, k);
+
+                // Leaves of one tree are disjoint so groups join in parallel
+                for (auto tree : forest) {
+                    container::ReadGuard guard(tree->get_scheduler());
+                    std::vector<std::vector<container::NodeView*> > groups;
+                    tree->get_leaf_groups(groups);
+                    container::NodePager* pager = tree->get_pager();
+
+#pragma omp parallel for num_threads(params.nthread) schedule(dynamic)
+                    for (size_t g = 0; g < groups.size(); g++) {
+                        std::vector<sample_id_t> members;
+                        for (auto leaf : groups[g]) {
+                            if (pager) pager->pin(leaf);
+                            for (IndexVal<data_t> iv : leaf->get_data_index())
+                                if (!tree->is_deleted(iv.get_index()))
+                                    members.push_back(iv.get_index());
+                            if (pager) pager->unpin(leaf);
+                        }
+                        graph->join(members, data, nfeatures);
+                    }
+                }
+
+                for (unsigned round = 0; round < nrefine; round++)
+                    if (!graph->refine(data, nfeatures, params.nthread))
+                        break; // Converged
+
+                return graph;
+            }
+
+            // Average of every tree's output for a row major batch of
+            //  samples. Classifiers output class probabilities
+            void predict(data_t* samples, const size_t nsamples,
+                    std::vector<data_t>& out) {
+                assert(forest.size());
+                const size_t noutput = forest[0]->get_noutput();
+                out.assign(nsamples*noutput, 0);
+                std::vector<data_t> tree_out(out.size());
+
+                // Each tree spreads the batch over its own threads
+                for (auto tree : forest) {
+                    tree->predict(samples, nsamples, &tree_out[0]);
+                    for (size_t i = 0; i < out.size(); i++)
+                        out[i] += tree_out[i];
+                }
+
+                for (size_t i = 0; i < out.size(); i++)
+                    out[i] /= forest.size();
             }
 
             TreeProgramType* get_tree(const tree_t id) {
@@ -133,10 +332,18 @@ namespace monya {
                 return forest.size();
             }
 
+            const io::ColumnCache* get_colcache() const {
+                return colcache;
+            }
+
             ~ComputeEngine() {
+                if (compaction.valid())
+                    compaction.wait();
                 assert(forest.size() == params.ntree);
                 for (auto it = forest.begin(); it != forest.end(); ++it)
                     (*it)->destroy();
+                delete tombstones;
+                delete colcache;
             }
     };
 } // End monya
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_NARY_TREE_PROGRAM_HPP__
+#define MONYA_NARY_TREE_PROGRAM_HPP__
+
+#include "common/types.hpp"
+#include "TreeProgram.hpp"
+#include "structures/NAryNode.hpp"
+#include "structures/Stack.hpp"
+
+namespace monya {
+    // Trees whose nodes may have up to `fanout` children e.g. k-means trees
+    class NAryTreeProgram: public TreeProgram {
+        protected:
+            container::NAryNode* root;
+            unsigned fanout; // Max # of children per node
+            depth_t depth;
+            depth_t max_depth; // Maximum depth the tree can reach
+
+            void delete_node(container::NAryNode* node) {
+                for (child_t i = 0; i < node->get_nchild(); i++)
+                    delete_node(node->get_child(i));
+                delete node;
+            }
+
+        public:
+            typedef std::shared_ptr<NAryTreeProgram> ptr;
+
+            NAryTreeProgram() : TreeProgram(), root(NULL), fanout(0),
+                depth(0), max_depth(0) {
+            }
+
+            NAryTreeProgram(Params& params, const tree_t _tree_id,
+                    const int _numa_id=0) :
+                TreeProgram(params, _tree_id, _numa_id), root(NULL),
+                fanout(params.fanout), depth(0),
+                max_depth(params.max_depth) {
+                assert(fanout > 1);
+            }
+
+            void set_root(container::NAryNode* node) {
+                assert(NULL != node);
+                assert(NULL != ioer);
+
+                node->set_ioer(ioer);
+                node->set_colcache(colcache);
+                node->set_depth(0);
+                root = node;
+            }
+
+            container::NAryNode* get_root() {
+                return root;
+            }
+
+            const bool empty() const {
+                return NULL == root;
+            }
+
+            const unsigned get_fanout() const {
+                return fanout;
+            }
+
+            const depth_t get_depth() const {
+                return depth;
+            }
+
+            void get_leaves(std::vector<container::NodeView*>& leaves)
+                override {
+                container::Stack<container::NAryNode*> stack;
+                if (root)
+                    stack.push(root);
+
+                while (!stack.empty()) {
+                    container::NAryNode* node = stack.pop();
+                    if (!node->has_child()) {
+                        leaves.push_back(node);
+                    } else {
+                        for (child_t i = 0; i < node->get_nchild(); i++)
+                            stack.push(node->get_child(i));
+                    }
+                }
+            }
+
+            // Level synchronous like BinaryTreeProgram::build. Levels hold
+            //  however many children the previous level spawned.
+            virtual void build() override {
+                assert(NULL != root);
+                std::vector<container::NodeView*> level { root };
+
+                for (depth = 0; ; depth++) {
+                    prep_level(depth);
+                    scheduler->schedule(level);
+
+                    bool one_spawned = false;
+#pragma omp parallel for num_threads (get_nthread())
+                    for (size_t i = 0; i < level.size(); i++) {
+                        container::NAryNode* curr_node =
+                            container::NAryNode::cast2(level[i]);
+                        // Termination conditions:
+                        // 1. Max depth
+                        // 2. Fewer samples than children
+                        if (curr_node->get_depth() < max_depth &&
+                                curr_node->get_data_index().size() > fanout) {
+                            curr_node->spawn();
+                            // As in BinaryTreeProgram::build
+                            for (child_t c = 0; c < curr_node->get_nchild();
+                                    c++)
+                                curr_node->get_child(c)->prefetch();
+                            if (!one_spawned) one_spawned = true;
+                        }
+                        curr_node->release(); // Node is finished
+                    }
+
+                    // Terminal: No spawning or max depth reached
+                    if (depth == max_depth || !one_spawned) break;
+
+                    std::vector<container::NodeView*> next_level;
+                    for (auto node : level) {
+                        container::NAryNode* curr_node =
+                            container::NAryNode::cast2(node);
+                        for (child_t i = 0; i < curr_node->get_nchild(); i++)
+                            next_level.push_back(curr_node->get_child(i));
+                    }
+                    if (next_level.empty()) break;
+                    level.swap(next_level);
+                }
+            }
+
+            virtual ~NAryTreeProgram() {
+                if (root)
+                    delete_node(root);
+            }
+    };
+} // End monya
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_TREE_PROGRAM_HPP__
+#define MONYA_TREE_PROGRAM_HPP__
+
+#include "common/types.hpp"
+#include "io/IOfactory.hpp"
+#include "io/ColumnCache.hpp"
+#include "structures/NodeView.hpp"
+#include "structures/NodePager.hpp"
+#include "structures/Query.hpp"
+#include "structures/Scheduler.hpp"
+#include "structures/Tombstone.hpp"
+
+namespace monya {
+    // State & plumbing shared by every tree program regardless of fanout
+    class TreeProgram {
+        protected:
+            tree_t tree_id; // The ID of this tree
+            short numa_id; // NUMA node
+            std::string exmem_fn;
+            io::IO::raw_ptr ioer;
+            size_t nsamples; // Max # of samples from which the tree is built
+            size_t nfeatures; // Number of features
+            container::Scheduler* scheduler;
+            container::Tombstone* tombstones; // Shared by the forest
+            io::ColumnCache* colcache; // Shared by the forest. May be NULL
+            size_t ncompacted; // # deletes already dropped from the leaves
+            container::NodePager* pager; // NULL when every leaf is resident
+
+        public:
+            TreeProgram() : ioer(NULL), scheduler(NULL), tombstones(NULL),
+                colcache(NULL), ncompacted(0), pager(NULL) {
+            }
+
+            TreeProgram(Params& params, const tree_t _tree_id,
+                    const int _numa_id=0) :
+                tree_id (_tree_id), numa_id(_numa_id), tombstones(NULL),
+                colcache(NULL), ncompacted(0), pager(NULL) {
+
+                exmem_fn = params.fn;
+                // Configure ioer
+                ioer = IOfactory::create(params.iotype, params.storage,
+                        params.filetype);
+                ioer->set_fn(exmem_fn);
+                ioer->set_orientation(params.orientation);
+                ioer->shape(dimpair(params.nsamples, params.nfeatures));
+
+                if (params.iotype == io_t::MEM)
+                    ioer->from_file();
+
+                nsamples = params.nsamples;
+                nfeatures = params.nfeatures;
+
+                unsigned nworkers = std::max(1,
+                        static_cast<int>(params.nthread/params.ntree));
+#ifdef USE_NUMA
+                scheduler = new container::Scheduler(params.fanout,
+                        params.max_depth, tree_id, nworkers, numa_id);
+#else
+                scheduler = new container::Scheduler(params.fanout,
+                        params.max_depth, tree_id, nworkers, 0);
+#endif
+
+                // The budget is split evenly across the forest
+                if (params.resident_budget)
+                    pager = new container::NodePager(exmem_fn +
+                            std::string(".t") + std::to_string(tree_id) +
+                            std::string(".pages"),
+                            params.resident_budget/params.ntree);
+            }
+
+            void set_numa_id(const short numa_id) {
+                this->numa_id = numa_id;
+            }
+
+            const short get_numa_id() const {
+                return numa_id;
+            }
+
+            container::Scheduler* get_scheduler() {
+                return scheduler;
+            }
+
+            void set_scheduler(container::Scheduler* scheduler) {
+                this->scheduler = scheduler;
+            }
+
+            void set_ioer(io::IO::raw_ptr ioer) {
+                this->ioer = ioer;
+            }
+
+            io::IO::raw_ptr get_ioer() {
+                assert(NULL != this->ioer);
+                return ioer;
+            }
+
+            void set_id(const tree_t tid) {
+                this->tree_id = tid;
+            }
+
+            const tree_t get_id() const {
+                return tree_id;
+            }
+
+            const std::string get_exmem_fn() const {
+                return this->exmem_fn;
+            }
+
+            void set_exmem_fn(const std::string exmem_fn) {
+                this->exmem_fn = exmem_fn;
+            }
+
+            void set_tombstones(container::Tombstone* tombstones) {
+                this->tombstones = tombstones;
+                scheduler->set_tombstones(tombstones);
+            }
+
+            // Set before the root so the nodes share their columns
+            void set_colcache(io::ColumnCache* colcache) {
+                this->colcache = colcache;
+            }
+
+            // Leaf scans must skip these samples
+            const bool is_deleted(const sample_id_t id) const {
+                return NULL != tombstones && tombstones->is_set(id);
+            }
+
+            virtual void get_leaves(std::vector<container::NodeView*>& leaves)
+                = 0;
+
+            // Leaves near enough to be joined by kNN graph construction. Each
+            //  leaf is in exactly one group. Defaults to a group per leaf
+            virtual void get_leaf_groups(
+                    std::vector<std::vector<container::NodeView*> >& groups) {
+                std::vector<container::NodeView*> leaves;
+                get_leaves(leaves);
+                for (auto leaf : leaves)
+                    groups.push_back({ leaf });
+            }
+
+            // Drop deleted samples from the leaves on the scheduler's threads.
+            //  Queries holding the read lock only wait for the swap of each
+            //  leaf's rewritten index, never for the filtering itself.
+            virtual void compact() {
+                if (NULL == tombstones)
+                    return;
+
+                // Deletes landing mid-pass are picked up by the next pass
+                const size_t ndeleted = tombstones->count();
+                if (ndeleted == ncompacted)
+                    return;
+
+                std::vector<container::NodeView*> leaves;
+                get_leaves(leaves);
+                scheduler->compact(leaves, pager);
+                ncompacted = ndeleted;
+            }
+
+            container::NodePager* get_pager() {
+                return pager;
+            }
+
+            // Hand the finished leaves to the pager. Leaves beyond the
+            //  resident budget are written back & faulted in by queries.
+            void page_out() {
+                if (NULL == pager)
+                    return;
+
+                std::vector<container::NodeView*> leaves;
+                get_leaves(leaves);
+                for (auto leaf : leaves)
+                    pager->add(leaf);
+            }
+
+            // Build a query optimized layout. Call once training is done
+            virtual void freeze() {
+            }
+
+            void destroy() {
+                if (ioer)
+                    ioer->destroy();
+                delete pager; // Drops the scratch file
+                pager = NULL;
+            }
+
+            // Called before the nodes of `level` are scheduled. Programs that
+            //  compute per level state (e.g. projections) override this
+            virtual void prep_level(const depth_t level) {
+            }
+
+            // User implemented for training phase
+            virtual void build() = 0;
+
+            virtual void find_neighbors(container::Query* q) {
+                throw not_implemented_exception(__FILE__, __LINE__);
+            }
+
+            // One query at a time unless the program shares work across them
+            virtual void find_neighbors_batch(
+                    container::BatchProximityQuery* batch) {
+                for (auto query : batch->get_queries())
+                    find_neighbors(query);
+            }
+
+            // Every sample within a radius of the query. Exact per tree
+            virtual void find_in_range(container::RangeQuery* q) {
+                throw not_implemented_exception(__FILE__, __LINE__);
+            }
+
+            // # of values predict() writes per sample e.g. class probabilities
+            virtual const size_t get_noutput() const {
+                return 1;
+            }
+
+            // Batched inference. `samples` is row major nsamples x nfeatures
+            //  & `out` nsamples x get_noutput()
+            virtual void predict(data_t* samples, const size_t nsamples,
+                    data_t* out) {
+                throw not_implemented_exception(__FILE__, __LINE__);
+            }
+
+            const unsigned get_nthread() { return scheduler->get_nthread(); }
+
+            virtual ~TreeProgram() {
+                delete scheduler;
+                delete pager;
+            }
+    };
+} // End monya
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+  * Recall & latency of kd-tree forests over a sweep of shapes on a SIFT/GIST
+  *  style benchmark: fvecs base & query sets with an optional ivecs ground
+  *  truth. Prints one JSON object per configuration so runs can be diffed.
+  */
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+#include "../common/monya.hpp"
+#include "../utils/time.hpp"
+#include "../utils/FileUtil.hpp"
+#include "../io/vecs_reader.hpp"
+#include "../validate/BruteForcekNN.hpp"
+#include "../common/cxxopts/cxxopts.hpp"
+#include "../examples/kdtree.hpp"
+
+using namespace monya;
+
+namespace {
+// Comma separated e.g. 1,2,4
+std::vector<size_t> parse_list(const std::string& str) {
+    std::vector<size_t> vals;
+    std::stringstream ss(str);
+    std::string tok;
+    while (std::getline(ss, tok, ','))
+        vals.push_back(atol(tok.c_str()));
+    if (vals.empty())
+        throw parameter_exception("Empty list: '" + str + "'");
+    return vals;
+}
+
+// The first k ids of each row
+std::vector<std::vector<sample_id_t> > read_ivecs(const std::string& fn,
+        const size_t k, const unsigned nthread) {
+    dimpair shape = io::vecs_shape(fn, sizeof(int32_t));
+    if (shape.second < k)
+        throw parameter_exception("Ground truth has fewer than k neighbors");
+
+    std::vector<int32_t> ids;
+    io::ivecs_reader(fn, shape.first, shape.second, nthread).read(ids);
+    std::vector<std::vector<sample_id_t> > gt(shape.first);
+    for (size_t i = 0; i < shape.first; i++)
+        gt[i].assign(&ids[i*shape.second], &ids[i*shape.second + k]);
+    return gt;
+}
+
+double percentile(std::vector<double>& sorted, const double p) {
+    return sorted[std::min(sorted.size()-1, (size_t)(p*sorted.size()))];
+}
+
+// Fraction of the true neighbors found. By id since reduced precision
+//  storage perturbs the distances
+double id_recall(IndexVector found,
+        const std::vector<sample_id_t>& truth) {
+    std::unordered_set<sample_id_t> ids;
+    for (size_t i = 0; i < found.size(); i++)
+        ids.insert(found[i].get_index());
+    size_t nfound = 0;
+    for (auto id : truth)
+        nfound += ids.count(id);
+    return nfound / (double)truth.size();
+}
+
+// Make a query per row of `queries`
+std::vector<container::ProximityQuery*> make_queries(
+        std::vector<container::DenseVector>& qsamples, const short k,
+        const tree_t ntree) {
+    std::vector<container::ProximityQuery*> pqs;
+    for (auto& qsample : qsamples)
+        pqs.push_back(new container::ProximityQuery(&qsample, k, ntree));
+    return pqs;
+}
+
+// Top k distinct samples across the trees
+IndexVector merge(container::ProximityQuery* pq, const size_t k) {
+    std::vector<std::pair<data_t, sample_id_t> > found;
+    std::unordered_set<sample_id_t> seen;
+    for (auto nnv : pq->getNN())
+        for (size_t i = 0; i < nnv->size(); i++)
+            if (seen.insert((*nnv)[i].get_index()).second)
+                found.push_back(std::make_pair((*nnv)[i].get_val(),
+                            (*nnv)[i].get_index()));
+    std::sort(found.begin(), found.end());
+    // Short results count as misses
+    found.resize(k, std::make_pair(std::numeric_limits<data_t>::max(),
+                std::numeric_limits<sample_id_t>::max()));
+
+    IndexVector iv;
+    for (auto& nn : found)
+        iv.append(nn.second, nn.first);
+    return iv;
+}
+}
+
+int main(int argc, char* argv[]) {
+    std::string basefn;
+    std::string queryfn;
+    std::string gtfn;
+    std::string outfn;
+
+    std::vector<size_t> ntrees, depths, budgets;
+    short k;
+    unsigned nthread;
+    bool approx = false;
+    size_t qblock;
+    size_t nlatency;
+    std::string storage_name;
+    storage_t storage = storage_t::F32;
+
+    try {
+        cxxopts::Options options(argv[0],
+                "knnbench base.fvecs query.fvecs [bench-options]\n");
+        options.positional_help("[optional args]");
+
+        options.add_options()
+            ("B,base", "fvecs file the forest is built over",
+             cxxopts::value<std::string>(basefn), "FILE")
+            ("Q,query", "fvecs file of queries",
+             cxxopts::value<std::string>(queryfn), "FILE")
+            ("g,groundtruth", "ivecs kNN of each query. Computed if absent",
+             cxxopts::value<std::string>(gtfn), "FILE")
+            ("o,out", "Append results to FILE rather than stdout",
+             cxxopts::value<std::string>(outfn), "FILE")
+            ("t,ntree", "Comma separated # of trees to sweep",
+             cxxopts::value<std::string>()->default_value("1"))
+            ("d,depth", "Comma separated max depths to sweep",
+             cxxopts::value<std::string>()->default_value("10"))
+            ("r,resident", "Comma separated leaf index budgets in bytes "
+             "(0: all)", cxxopts::value<std::string>()->default_value("0"))
+            ("k,nneighbors", "Neighbors per query",
+             cxxopts::value<short>(k)->default_value("10"))
+            ("T,num_thread", "The number of threads to run",
+             cxxopts::value<unsigned>(nthread)->default_value("1"))
+            ("A,approx", "Only scan the leaf each query falls into",
+             cxxopts::value<bool>(approx))
+            ("b,qblock", "Queries carried down a tree together",
+             cxxopts::value<size_t>(qblock)->default_value("64"))
+            ("l,nlatency", "Queries timed one at a time for the percentiles",
+             cxxopts::value<size_t>(nlatency)->default_value("1000"))
+            ("s,storage", "In memory precision: f32, f16 or int8",
+             cxxopts::value<std::string>(storage_name)->default_value("f32"))
+            ("h,help", "Print help");
+
+        options.parse_positional(std::vector<std::string>({"base", "query"}));
+        int nargs = argc;
+        options.parse(argc, argv);
+
+        if (options.count("help") || nargs < 3) {
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        ntrees = parse_list(options["ntree"].as<std::string>());
+        depths = parse_list(options["depth"].as<std::string>());
+        budgets = parse_list(options["resident"].as<std::string>());
+        storage = storage_name == "f16" ? F16 :
+            storage_name == "int8" ? INT8 : F32;
+    } catch (const cxxopts::OptionException& e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const dimpair base_shape = io::vecs_shape(basefn, sizeof(data_t));
+    const size_t nsamples = base_shape.first;
+    const size_t nfeatures = base_shape.second;
+    const dimpair query_shape = io::vecs_shape(queryfn, sizeof(data_t));
+    const size_t nquery = query_shape.first;
+    if (query_shape.second != nfeatures)
+        throw parameter_exception("Base & queries differ in dimension");
+    nlatency = std::min(nlatency, nquery);
+
+    std::vector<data_t> queries(nquery*nfeatures);
+    io::fvecs_reader(queryfn, nquery, nfeatures, nthread).read(&queries[0]);
+    std::vector<container::DenseVector> qsamples;
+    qsamples.reserve(nquery);
+    for (size_t qid = 0; qid < nquery; qid++)
+        qsamples.emplace_back(&queries[qid*nfeatures], nfeatures);
+
+    utils::time timer;
+    std::vector<std::vector<sample_id_t> > gt;
+    if (gtfn.empty()) {
+        std::vector<data_t> base(nsamples*nfeatures);
+        io::fvecs_reader(basefn, nsamples, nfeatures, nthread).read(&base[0]);
+        timer.tic();
+        std::vector<IndexVector> truths;
+        validate::BruteForcekNN(&base[0], nsamples, nfeatures,
+                nthread).getNN(&queries[0], nquery, k, truths);
+        for (auto& truth : truths) {
+            gt.push_back(std::vector<sample_id_t>());
+            for (auto nn : truth)
+                gt.back().push_back(nn.get_index());
+        }
+        std::cerr << "Ground truth computed in " << timer.toc() << " sec\n";
+    } else {
+        gt = read_ivecs(gtfn, k, nthread);
+        if (gt.size() < nquery)
+            throw parameter_exception("Ground truth is missing queries");
+    }
+
+
+    std::ofstream outfile;
+    if (!outfn.empty())
+        outfile.open(outfn, std::ios::app);
+    std::ostream& out = outfn.empty() ? std::cout : outfile;
+
+    for (auto ntree : ntrees)
+    for (auto max_depth : depths)
+    for (auto budget : budgets) {
+        Params params(nsamples, nfeatures, basefn, io_t::MEM, ntree,
+                nthread, mat_orient_t::ROW, 2, max_depth, file_t::FVECS,
+                budget, metric_t::EUCLIDEAN, storage);
+
+        ComputeEngine<kdTreeProgram>::ptr engine =
+            ComputeEngine<kdTreeProgram>::create(params);
+        std::vector<kdTreeProgram*> forest = engine->get_forest();
+        for (tree_t tid = 0; tid < ntree; tid++) {
+            kdnode* root = new kdnode;
+            root->set_split_dim(tid % nfeatures);
+            root->set_index(tid % nfeatures);
+            container::BinaryNode* node = root;
+            forest[tid]->set_root(node);
+        }
+
+        // The data is already in memory so only the index is counted
+        const size_t rss = utils::get_resident_bytes();
+        timer.tic();
+        engine->train();
+        const double build_sec = timer.toc();
+        const ssize_t build_bytes = utils::get_resident_bytes() - rss;
+
+        std::vector<container::ProximityQuery*> pqs =
+            make_queries(qsamples, k, ntree);
+        container::BatchProximityQuery batch(pqs, !approx, qblock);
+        timer.tic();
+        engine->query(&batch);
+        const double qps = nquery / timer.toc();
+        // Work per query of the batch, before the latency runs add to it
+        std::ostringstream query_stats;
+        engine->get_query_stats().write_json(query_stats);
+
+        double recall = 0;
+        for (size_t qid = 0; qid < nquery; qid++) {
+            recall += id_recall(merge(pqs[qid], k), gt[qid]);
+            delete pqs[qid];
+        }
+        recall /= nquery;
+
+        // One query in flight at a time
+        std::vector<double> latency;
+        for (size_t qid = 0; qid < nlatency; qid++) {
+            container::ProximityQuery pq(&qsamples[qid], k, ntree);
+            std::vector<container::ProximityQuery*> one(1, &pq);
+            container::BatchProximityQuery single(one, !approx, 1);
+            timer.tic();
+            engine->query(&single);
+            latency.push_back(timer.toc()*1e3);
+        }
+        std::sort(latency.begin(), latency.end());
+
+        out << "{\"index\": \"kdtree\", \"nsamples\": " << nsamples <<
+            ", \"nfeatures\": " << nfeatures << ", \"nquery\": " << nquery <<
+            ", \"k\": " << k << ", \"exact\": " << (approx ? "false" : "true")
+            << ", \"nthread\": " << nthread << ", \"ntree\": " << ntree <<
+            ", \"max_depth\": " << max_depth << ", \"resident_budget\": " <<
+            budget << ", \"storage\": \"" << storage_name <<
+            "\", \"build_sec\": " << build_sec <<
+            ", \"build_bytes\": " << build_bytes << ", \"qps\": " << qps <<
+            ", \"p50_ms\": " << (latency.empty() ? 0 :
+                    percentile(latency, .5)) <<
+            ", \"p99_ms\": " << (latency.empty() ? 0 :
+                    percentile(latency, .99)) <<
+            ", \"recall\": " << recall << ", \"query_stats\": " <<
+            query_stats.str() << "}" << std::endl;
+
+        engine.reset(); // Releases the data
+        for (auto tree : forest)
+            delete tree;
+    }
+
+    return EXIT_SUCCESS;
+}
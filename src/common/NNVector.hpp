@@ -25,29 +25,31 @@
 
 namespace monya {
 
-class NNVector {
+// The k nearest samples seen so far, ordered by distance of type `T`
+template <typename T>
+class BasicNNVector {
     private:
 
         class Node {
             public:
                 Node* prev;
                 Node* next;
-                IndexVal<data_t> data;
+                IndexVal<T> data;
 
                 Node() : prev(NULL), next(NULL) { }
-                Node(IndexVal<data_t>& data) : Node() {
+                Node(IndexVal<T>& data) : Node() {
                     this->data = data;
                 }
 
                 void print() {
-                    if (data.get_val() == std::numeric_limits<data_t>::max())
+                    if (data.get_val() == std::numeric_limits<T>::max())
                         std::cout << "sentinel\n";
                     else
                         data.print();
                 }
 
                 std::string to_string() {
-                    if (data.get_val() == std::numeric_limits<data_t>::max())
+                    if (data.get_val() == std::numeric_limits<T>::max())
                         return "sentinel";
                     else
                         return data.to_string();
@@ -90,12 +92,12 @@ class NNVector {
         }
 
     public:
-        NNVector(sample_id_t k) {
+        BasicNNVector(sample_id_t k) {
             this->k = k;
             sentinel = new Node();
             sentinel->next = sentinel->prev = sentinel;
-            sentinel->data = IndexVal<data_t>(
-                    0, std::numeric_limits<data_t>::max());
+            sentinel->data = IndexVal<T>(
+                    0, std::numeric_limits<T>::max());
             _size = 0;
         }
 
@@ -119,8 +121,8 @@ class NNVector {
             invalidate_cache();
         }
 
-        void eval(const sample_id_t id, data_t dist) {
-            eval(IndexVal<data_t> (id, dist));
+        void eval(const sample_id_t id, T dist) {
+            eval(IndexVal<T> (id, dist));
         }
 
         /**
@@ -128,7 +130,7 @@ class NNVector {
           *     If so add in the correct position, else ignore
           */
         // TODO: Copies :(
-        void eval(IndexVal<data_t> iv) {
+        void eval(IndexVal<T> iv) {
             if (!size()) {
 #if 0
                 printf("Adding to empty list: "); iv.print();
@@ -140,7 +142,7 @@ class NNVector {
                 new_node->next = sentinel;
                 _size++;
             } else {
-                data_t val = iv.get_val();
+                T val = iv.get_val();
                 Node* curr = sentinel->next;
                 bool insert_flag = false;
 
@@ -183,7 +185,7 @@ class NNVector {
             invalidate_cache();
         }
 
-        bool operator==(IndexVector& iv) {
+        bool operator==(BasicIndexVector<T>& iv) {
             if (iv.size() != size())
                 return false;
 
@@ -196,7 +198,7 @@ class NNVector {
         }
 
         // TODO: Could be faster
-        bool operator==(NNVector* other) {
+        bool operator==(BasicNNVector* other) {
             if (other->size() != size())
                 return false;
 
@@ -209,7 +211,7 @@ class NNVector {
         }
 
         // TODO: Could be faster
-        bool operator==(NNVector& other) {
+        bool operator==(BasicNNVector& other) {
             if (other.size() != size())
                 return false;
 
@@ -221,7 +223,7 @@ class NNVector {
             return true;
         }
 
-        IndexVal<data_t>& operator[](const size_t index) {
+        IndexVal<T>& operator[](const size_t index) {
             if ((index + 1) > _size)
                 throw std::runtime_error(std::string("Out of bounds index: ")
                         + std::to_string(index));
@@ -271,15 +273,15 @@ class NNVector {
             return curr->data;
         }
 
-        IndexVector to_IndexVector() {
-            IndexVector ret;
+        BasicIndexVector<T> to_IndexVector() {
+            BasicIndexVector<T> ret;
             Node* curr = sentinel->next;
             while(curr != sentinel)
                 ret.append(curr->data);
             return ret;
         }
 
-        bool find(const IndexVal<data_t>& iv) {
+        bool find(const IndexVal<T>& iv) {
             Node* curr = sentinel->next;
             while (curr != sentinel) {
                 if (curr->data == iv) {
@@ -309,7 +311,7 @@ class NNVector {
             return _size == 0;
         }
 
-        ~NNVector() {
+        ~BasicNNVector() {
 #if 0
             printf("Destructing NNVector\n");
 #endif
@@ -332,5 +334,7 @@ class NNVector {
         }
 };
 
+typedef BasicNNVector<data_t> NNVector;
+
 } // End namespace monya:
 #endif
@@ -21,20 +21,193 @@
 #define MONYA_DISTANCE_HPP__
 
 #include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <cblas.h>
 #include "types.hpp"
+#include "quantize.hpp"
 
 namespace monya {
 
+    /**
+      \brief Distances between samples of element type `T`. Each kernel is
+        instantiated per type; elem_traits<T> picks the accumulator
+      */
     class distance {
+        private:
+            // BLAS by precision for the GEMM form of euclidean()
+            static float dot(const size_t n, const float* x, const float* y) {
+                return cblas_sdot(n, x, 1, y, 1);
+            }
+
+            static double dot(const size_t n, const double* x,
+                    const double* y) {
+                return cblas_ddot(n, x, 1, y, 1);
+            }
+
+            static void gemm_nt(const size_t m, const size_t n, const size_t k,
+                    const float* a, const float* b, float* c) {
+                cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, m, n, k,
+                        -2, a, k, b, k, 0, c, n);
+            }
+
+            static void gemm_nt(const size_t m, const size_t n, const size_t k,
+                    const double* a, const double* b, double* c) {
+                cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, m, n, k,
+                        -2, a, k, b, k, 0, c, n);
+            }
+
         public:
-            static data_t euclidean(data_t* arr,
-                data_t* other, const size_t nelem) {
-            data_t res = 0;
+            template <typename T>
+            static typename elem_traits<T>::dist_t euclidean(const T* arr,
+                    const T* other, const size_t nelem) {
+            typename elem_traits<T>::accum_t res = 0;
             for (size_t i = 0; i < nelem; i++) {
                 auto tmp = arr[i] - other[i];
                 res += (tmp*tmp);
             }
-            return sqrt(res);
+            return std::sqrt(res);
+        }
+
+            // `sample` to a row stored as `codes` (see quantize.hpp). The
+            //  codes are widened as they are read & summed in double
+            template <typename code_t>
+            static data_t euclidean(const data_t* sample, const code_t* codes,
+                    const data_t* scale, const data_t* offset,
+                    const size_t nelem) {
+            double res = 0;
+            for (size_t i = 0; i < nelem; i++) {
+                double tmp = sample[i] -
+                    quantize::decode(codes[i], scale[i], offset[i]);
+                res += tmp*tmp;
+            }
+            return std::sqrt(res);
+        }
+
+            // Sparse rows given as ascending dimensions & their values. Only
+            //  the nonzeros of either are visited
+            template <typename T>
+            static typename elem_traits<T>::dist_t sparse_euclidean(
+                    const feature_id_t* aidx, const T* arr, const size_t annz,
+                    const feature_id_t* oidx, const T* other,
+                    const size_t onnz) {
+            typename elem_traits<T>::accum_t res = 0;
+            size_t i = 0, j = 0;
+            while (i < annz || j < onnz) {
+                typename elem_traits<T>::accum_t tmp;
+                if (j == onnz || (i < annz && aidx[i] < oidx[j]))
+                    tmp = arr[i++];
+                else if (i == annz || oidx[j] < aidx[i])
+                    tmp = -other[j++];
+                else
+                    tmp = arr[i++] - other[j++];
+                res += tmp*tmp;
+            }
+            return std::sqrt(res);
+        }
+
+            // A dense `nelem` long `arr` to a sparse row
+            template <typename T>
+            static typename elem_traits<T>::dist_t sparse_euclidean(
+                    const T* arr, const feature_id_t* oidx, const T* other,
+                    const size_t onnz, const size_t nelem) {
+            typename elem_traits<T>::accum_t res = 0;
+            size_t j = 0;
+            for (size_t i = 0; i < nelem; i++) {
+                typename elem_traits<T>::accum_t tmp = arr[i];
+                if (j < onnz && oidx[j] == i)
+                    tmp -= other[j++];
+                res += tmp*tmp;
+            }
+            return std::sqrt(res);
+        }
+
+            template <typename T>
+            static typename elem_traits<T>::dist_t manhattan(const T* arr,
+                    const T* other, const size_t nelem) {
+            typename elem_traits<T>::accum_t res = 0;
+            for (size_t i = 0; i < nelem; i++) {
+                auto tmp = arr[i] - other[i];
+                res += tmp < 0 ? -tmp : tmp;
+            }
+            return res;
+        }
+
+            // The angle between the vectors normalized to [0, 1]. Unlike
+            //  1 - cos it obeys the triangle inequality so trees can prune
+            template <typename T>
+            static typename elem_traits<T>::dist_t cosine(const T* arr,
+                    const T* other, const size_t nelem) {
+            double dot = 0, norm = 0, other_norm = 0;
+            for (size_t i = 0; i < nelem; i++) {
+                dot += (double)arr[i]*other[i];
+                norm += (double)arr[i]*arr[i];
+                other_norm += (double)other[i]*other[i];
+            }
+
+            if (norm == 0 || other_norm == 0)
+                return norm == other_norm ? 0 : .5; // Orthogonal to all
+
+            double sim = dot / std::sqrt(norm*other_norm);
+            sim = std::max(-1.0, std::min(1.0, sim));
+            return std::acos(sim) / M_PI;
+        }
+
+            /**
+              \brief Euclidean distance of every row of `arr` (narr x nelem,
+                row major) to every row of `other` (nother x nelem) written
+                to `out` (narr x nother) as ||x||^2 + ||y||^2 - 2xy with one
+                GEMM. Rounding differs slightly from euclidean(). float or
+                double
+              */
+            template <typename T>
+            static void euclidean(const T* arr, const size_t narr,
+                    const T* other, const size_t nother,
+                    const size_t nelem, T* out) {
+            std::vector<T> norms(narr + nother, 0);
+            for (size_t i = 0; i < narr; i++)
+                norms[i] = dot(nelem, &arr[i*nelem], &arr[i*nelem]);
+            for (size_t i = 0; i < nother; i++)
+                norms[narr+i] = dot(nelem, &other[i*nelem], &other[i*nelem]);
+
+            gemm_nt(narr, nother, nelem, arr, other, out);
+
+            for (size_t i = 0; i < narr; i++)
+                for (size_t j = 0; j < nother; j++) {
+                    T sq = out[i*nother+j] + norms[i] + norms[narr+j];
+                    out[i*nother+j] = sq > 0 ? std::sqrt(sq) : 0;
+                }
+        }
+
+            /**
+              \brief Bound on the gap between a squared distance from the
+                GEMM form of euclidean() & the square of the direct one, for
+                rows of squared norms `norm2` & `other_norm2`. Each is a sum
+                of nelem products off by at most (nelem+2)*eps of
+                ||x||^2 + ||y||^2 (Higham's gamma_n). 4x covers the cross
+                term, the direct distance's own error & centering
+              */
+            template <typename T>
+            static T gemm_slack(const size_t nelem, const T norm2,
+                    const T other_norm2) {
+                return 4*(nelem + 2)*std::numeric_limits<T>::epsilon()*
+                    (norm2 + other_norm2);
+            }
+
+            template <typename T>
+            static typename elem_traits<T>::dist_t eval(const metric_t metric,
+                    const T* arr, const T* other, const size_t nelem) {
+            switch (metric) {
+                case EUCLIDEAN:
+                    return euclidean(arr, other, nelem);
+                case MANHATTAN:
+                    return manhattan(arr, other, nelem);
+                case COSINE:
+                    return cosine(arr, other, nelem);
+                default:
+                    throw parameter_exception("Unknown metric");
+            }
         }
     };
 
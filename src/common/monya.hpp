@@ -21,6 +21,7 @@
 #define MONYA_MONYA_HPP__
 
 #include "../BinaryTreeProgram.hpp"
+#include "../NAryTreeProgram.hpp"
 #include "../ComputeEngine.hpp"
 #include "../structures/RBNode.hpp"
 #include "../structures/Query.hpp"
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_QUANTIZE_HPP__
+#define MONYA_QUANTIZE_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "types.hpp"
+
+namespace monya { namespace quantize {
+
+// IEEE binary16 <-> binary32 without F16C. Rounds to nearest even
+inline uint16_t float2half(const float val) {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const uint32_t abs = bits & 0x7fffffff;
+
+    if (abs >= 0x7f800000) // Inf or NaN
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    if (abs >= 0x477ff000) // Rounds past the largest half (65504)
+        return sign | 0x7c00;
+
+    if (abs < 0x38800000) { // Subnormal half or zero
+        if (abs < 0x33000000) // Below half the smallest subnormal
+            return sign;
+        const unsigned shift = 126 - (abs >> 23);
+        const uint32_t mant = (abs & 0x7fffff) | 0x800000;
+        uint32_t half = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t tie = 1u << (shift - 1);
+        if (rem > tie || (rem == tie && (half & 1)))
+            half++;
+        return sign | half;
+    }
+
+    // Rebias the exponent & round off the 13 low mantissa bits
+    uint32_t half = (abs - 0x38000000) >> 13;
+    const uint32_t rem = abs & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+        half++;
+    return sign | half;
+}
+
+inline float half2float(const uint16_t half) {
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exp = (half >> 10) & 0x1f;
+    uint32_t mant = half & 0x3ff;
+    uint32_t bits;
+
+    if (exp == 0x1f) { // Inf or NaN
+        bits = sign | 0x7f800000 | (mant << 13);
+    } else if (exp) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (!mant) {
+        bits = sign;
+    } else { // Subnormal: normalize the mantissa
+        exp = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+
+    float val;
+    std::memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+// An IEEE half as an element type. Arithmetic happens in float
+struct half_t {
+    uint16_t bits;
+
+    half_t() : bits(0) { }
+    half_t(const float val) : bits(float2half(val)) { }
+    operator float() const { return half2float(bits); }
+};
+
+// A stored value is offset + scale*code
+inline data_t decode(const uint8_t code, const data_t scale,
+        const data_t offset) {
+    return offset + scale*code;
+}
+
+inline data_t decode(const uint16_t code, const data_t scale,
+        const data_t offset) {
+    return offset + scale*half2float(code);
+}
+
+inline void encode(const data_t val, const data_t scale, const data_t offset,
+        uint8_t& code) {
+    const long q = std::lround((val - offset) / scale);
+    code = static_cast<uint8_t>(std::max(0L, std::min(255L, q)));
+}
+
+inline void encode(const data_t val, const data_t scale, const data_t offset,
+        uint16_t& code) {
+    code = float2half((val - offset) / scale);
+}
+
+/**
+  \brief Per dimension scale & offset for `code_t` from the range of each
+    dimension of `data` (nrow x ncol, in `orient`). int8 spreads the range
+    over the 256 codes. fp16 centers it & only scales ranges a half can't
+    hold
+  */
+template <typename code_t>
+void fit(const data_t* data, const size_t nrow, const size_t ncol,
+        const mat_orient_t orient, std::vector<data_t>& scale,
+        std::vector<data_t>& offset) {
+    std::vector<data_t> lo(ncol, std::numeric_limits<data_t>::max());
+    std::vector<data_t> hi(ncol, std::numeric_limits<data_t>::lowest());
+    for (size_t row = 0; row < nrow; row++)
+        for (size_t col = 0; col < ncol; col++) {
+            const data_t val = orient == ROW ? data[row*ncol+col] :
+                data[col*nrow+row];
+            lo[col] = std::min(lo[col], val);
+            hi[col] = std::max(hi[col], val);
+        }
+
+    scale.resize(ncol);
+    offset.resize(ncol);
+    for (size_t col = 0; col < ncol; col++) {
+        const data_t range = nrow ? hi[col] - lo[col] : 0;
+        if (sizeof(code_t) == 1) {
+            offset[col] = nrow ? lo[col] : 0;
+            scale[col] = range > 0 ? range / 255 : 1;
+        } else {
+            offset[col] = nrow ? lo[col] + range/2 : 0;
+            scale[col] = std::max<data_t>(1, range / 60000);
+        }
+    }
+}
+
+} // End namespace monya::quantize
+
+template <>
+struct elem_traits<quantize::half_t> {
+    typedef data_t dist_t;
+    typedef float accum_t;
+};
+} // End namespace monya
+#endif
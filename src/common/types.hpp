@@ -23,6 +23,7 @@
 // Represent a binary node
 
 #include <iostream>
+#include <cstdint>
 #include <map>
 #include <utility>
 #include <vector>
@@ -41,6 +42,7 @@ namespace monya {
     typedef size_t offset_t; // The offset position of a file
     typedef unsigned tree_t; // The number of trees in the forest
     typedef size_t depth_t; // The depth of trees in the forest
+    typedef unsigned feature_id_t; // A dimension (column) of the data
     typedef float data_t; // The type of the data
 
     // Constants
@@ -69,6 +71,22 @@ namespace monya {
         LEVELORDER
     };
 
+    // Distance used to compare samples
+    enum metric_t {
+        EUCLIDEAN,
+        MANHATTAN, // L1
+        COSINE // Angular distance, a metric ordered as cosine similarity
+    };
+
+    // How an in memory dataset is stored. Reduced precision fits 2-4x more
+    //  samples per cache line; distances are still accumulated in double
+    enum storage_t {
+        F32, // data_t as is
+        F16, // IEEE half per element
+        INT8, // One byte per element with per dimension scale & offset
+        SPARSE // Only the nonzeros, as both CSR & CSC
+    };
+
     enum bchild_t {
         LEFT,
         RIGHT
@@ -109,12 +127,17 @@ namespace monya {
             unsigned fanout; // The number of children a node a can have
             depth_t max_depth; // Maximum depth the tree can reach
             file_t filetype; // file format
+            size_t resident_budget; // Bytes of leaf index in memory. 0: all
+            metric_t metric;
+            storage_t storage; // Only for io_t::MEM
 
         Params(size_t nsamples=0, size_t nfeatures=0, std::string fn="",
                 io_t iotype=io_t::MEM, tree_t ntree=1, unsigned nthread=1,
                 mat_orient_t orientation=mat_orient_t::COL, unsigned fanout=2,
                 depth_t max_depth=std::numeric_limits<depth_t>::max(),
-                file_t filetype=file_t::BIN) {
+                file_t filetype=file_t::BIN, size_t resident_budget=0,
+                metric_t metric=metric_t::EUCLIDEAN,
+                storage_t storage=storage_t::F32) {
 
             this->nsamples = nsamples;
             this->nfeatures = nfeatures;
@@ -126,7 +149,13 @@ namespace monya {
             this->fanout = fanout;
             this->max_depth = max_depth;
             this->filetype = filetype;
+            this->resident_budget = resident_budget;
+            this->metric = metric;
+            this->storage = storage;
 
+            if (iotype != io_t::MEM && storage != storage_t::F32)
+                throw parameter_exception("Reduced precision storage is only"
+                        " supported in memory\n");
             if (iotype != io_t::MEM && nthread > 1)
                 throw parameter_exception("Multithreading only support for in"
                         " memory mode currently!\n");
@@ -150,7 +179,16 @@ namespace monya {
                 "filetype:" << (filetype == BIN ? "Binary" :
                         filetype == FVECS ? "fvecs" :
                         filetype == IVECS ? "ivecs" :
-                        filetype == BVECS ? "bvecs": "hdf5") << std::endl;
+                        filetype == BVECS ? "bvecs": "hdf5") << std::endl <<
+                "resident budget: " << (resident_budget ?
+                        std::to_string(resident_budget) + " bytes" :
+                        std::string("unlimited")) << std::endl <<
+                "metric: " << (metric == EUCLIDEAN ? "Euclidean" :
+                        metric == MANHATTAN ? "Manhattan" : "Cosine") <<
+                std::endl <<
+                "storage: " << (storage == F32 ? "float32" :
+                        storage == F16 ? "float16" : storage == INT8 ?
+                        "int8" : "sparse") << std::endl;
         }
     };
 
@@ -159,6 +197,23 @@ namespace monya {
 
     };
 
+    /**
+      \brief How samples of element type `T` are compared: the type their
+        distance is returned in & the type its terms are summed in. Byte
+        data sums exactly
+      */
+    template <typename T>
+    struct elem_traits {
+        typedef T dist_t;
+        typedef T accum_t;
+    };
+
+    template <>
+    struct elem_traits<uint8_t> {
+        typedef data_t dist_t;
+        typedef int64_t accum_t;
+    };
+
     template <typename T>
     class IndexVal {
         private:
@@ -226,30 +281,34 @@ namespace monya {
             return stream;
         }
 
-    class IndexVector {
+    // Sample ids paired with a value of type `T`, e.g. a distance
+    template <typename T>
+    class BasicIndexVector {
         private:
-            std::vector<IndexVal<data_t> >_;
+            std::vector<IndexVal<T> >_;
             bool sorted;
 
         public:
-            typedef typename std::vector<IndexVal<data_t> >::iterator iterator;
-            IndexVector() : sorted(false) { } // Default ctor
+            typedef typename std::vector<IndexVal<T> >::iterator iterator;
+            BasicIndexVector() : sorted(false) { } // Default ctor
 
-            IndexVector(const size_t nelem) : IndexVector() {
+            BasicIndexVector(const size_t nelem) : BasicIndexVector() {
                 resize(nelem);
             }
 
-            IndexVector(const std::vector<data_t>& vals) : IndexVector() {
+            BasicIndexVector(const std::vector<T>& vals) :
+                BasicIndexVector() {
                 for (size_t i = 0; i < vals.size(); i++)
-                    _.push_back(IndexVal<data_t>(i, vals[i]));
+                    _.push_back(IndexVal<T>(i, vals[i]));
             }
 
-            IndexVector(const std::vector<sample_id_t>& v) : IndexVector() {
+            BasicIndexVector(const std::vector<sample_id_t>& v) :
+                BasicIndexVector() {
                 for (auto idx : v)
-                    _.push_back(IndexVal<data_t>(idx, 0)); // 0 is a place holder
+                    _.push_back(IndexVal<T>(idx, 0)); // 0 is a place holder
             }
 
-            IndexVal<data_t>& operator[](const int index) {
+            IndexVal<T>& operator[](const int index) {
                 return this->_[index];
             }
 
@@ -271,16 +330,16 @@ namespace monya {
                     _.clear();
 
                 for (size_t i = 0; i < nelem; i++)
-                    _.push_back(IndexVal<data_t>(idxs[i], 0));
+                    _.push_back(IndexVal<T>(idxs[i], 0));
             }
 
             // Insert values with contiguous indexes
-            void set_indexes(const data_t* vals, const size_t nelem) {
+            void set_indexes(const T* vals, const size_t nelem) {
                 if (_.size())
                     _.clear();
 
                 for (size_t i = 0; i < nelem; i++)
-                    _.push_back(IndexVal<data_t>(i, vals[i]));
+                    _.push_back(IndexVal<T>(i, vals[i]));
             }
 
             void get_indexes(std::vector<sample_id_t>& v) {
@@ -291,11 +350,11 @@ namespace monya {
                 }
             }
 
-            void append(const sample_id_t id, const data_t val) {
-                _.push_back(IndexVal<data_t>(id, val));
+            void append(const sample_id_t id, const T val) {
+                _.push_back(IndexVal<T>(id, val));
             }
 
-            void append(IndexVal<data_t>& iv) {
+            void append(IndexVal<T>& iv) {
                 _.push_back(iv);
             }
 
@@ -307,11 +366,11 @@ namespace monya {
                 assert(nelem >= size());
 
                 for (size_t i = 0; i < nelem-size(); i++) {
-                    _.push_back(IndexVal<data_t>(0, 0));
+                    _.push_back(IndexVal<T>(0, 0));
                 }
             }
 
-            void insert(IndexVal<data_t> item, const size_t offset) {
+            void insert(IndexVal<T> item, const size_t offset) {
                 _.insert(begin()+offset, item);
             }
 
@@ -319,11 +378,25 @@ namespace monya {
                 _.resize(nelem);
             }
 
+            void reserve(const size_t nelem) {
+                _.reserve(nelem);
+            }
+
+            void shrink_to_fit() {
+                _.shrink_to_fit();
+            }
+
+            // O(1) exchange of contents. Used to publish a rewritten index
+            void swap(BasicIndexVector& other) {
+                _.swap(other._);
+                std::swap(sorted, other.sorted);
+            }
+
             bool empty() const { return _.empty(); }
             iterator begin() { return _.begin(); }
             iterator end() { return _.end(); }
 
-            bool find(IndexVal<data_t>& iv) {
+            bool find(IndexVal<T>& iv) {
                 if (!is_sorted())
                     sort();
                 return std::binary_search(begin(), end(), iv);
@@ -343,6 +416,7 @@ namespace monya {
             }
     };
 
+    typedef BasicIndexVector<data_t> IndexVector;
 
     // circular integer
     class cunsigned {
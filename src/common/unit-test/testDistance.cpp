@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+
+#include "../distance.hpp"
+
+using namespace monya;
+
+namespace {
+bool close(const data_t a, const data_t b) {
+    return std::fabs(a - b) < 1e-5;
+}
+}
+
+int main(int argc, char** argv) {
+    data_t a[] = { 1, 0, 0 };
+    data_t b[] = { 0, 2, 0 };
+    data_t c[] = { -3, 0, 0 };
+    data_t zero[] = { 0, 0, 0 };
+
+    assert(close(distance::euclidean(a, b, 3), std::sqrt(5)));
+    assert(close(distance::manhattan(a, b, 3), 3));
+    assert(close(distance::cosine(a, b, 3), .5)); // Orthogonal
+    assert(close(distance::cosine(a, c, 3), 1)); // Opposite
+    assert(close(distance::cosine(a, a, 3), 0));
+    assert(close(distance::cosine(a, zero, 3), .5));
+    assert(close(distance::eval(MANHATTAN, a, c, 3), 4));
+
+    // Every metric obeys the triangle inequality
+    std::default_random_engine generator;
+    std::normal_distribution<data_t> distribution;
+    constexpr size_t NFEATURES = 8;
+    for (size_t i = 0; i < 1000; i++) {
+        data_t x[NFEATURES], y[NFEATURES], z[NFEATURES];
+        for (size_t j = 0; j < NFEATURES; j++) {
+            x[j] = distribution(generator);
+            y[j] = distribution(generator);
+            z[j] = distribution(generator);
+        }
+
+        for (metric_t metric : { EUCLIDEAN, MANHATTAN, COSINE })
+            assert(distance::eval(metric, x, z, NFEATURES) <=
+                    distance::eval(metric, x, y, NFEATURES) +
+                    distance::eval(metric, y, z, NFEATURES) + 1e-5);
+    }
+
+    // The GEMM form agrees with the direct one
+    constexpr size_t NARR = 5, NOTHER = 7;
+    std::vector<data_t> arr(NARR*NFEATURES), other(NOTHER*NFEATURES);
+    for (auto& v : arr) v = distribution(generator);
+    for (auto& v : other) v = distribution(generator);
+    std::copy(&arr[0], &arr[NFEATURES], &other[2*NFEATURES]); // Self match
+
+    std::vector<data_t> dists(NARR*NOTHER);
+    distance::euclidean(&arr[0], NARR, &other[0], NOTHER, NFEATURES,
+            &dists[0]);
+    for (size_t i = 0; i < NARR; i++)
+        for (size_t j = 0; j < NOTHER; j++)
+            assert(std::fabs(dists[i*NOTHER+j] - distance::euclidean(
+                        &arr[i*NFEATURES], &other[j*NFEATURES], NFEATURES))
+                    < 1e-3);
+    assert(dists[2] < 1e-2);
+
+    printf("Distance test successful!\n");
+    return EXIT_SUCCESS;
+}
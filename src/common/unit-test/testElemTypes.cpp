@@ -0,0 +1,162 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+
+#include "../distance.hpp"
+#include "../NNVector.hpp"
+#include "../../structures/SampleVector.hpp"
+#include "../../io/IO.hpp"
+
+using namespace monya;
+using quantize::half_t;
+
+// Every supported element type compiles in full
+namespace monya {
+template class BasicIndexVector<float>;
+template class BasicIndexVector<double>;
+template class BasicNNVector<float>;
+template class BasicNNVector<double>;
+
+namespace container {
+template class BasicDenseVector<float>;
+template class BasicDenseVector<double>;
+template class BasicDenseVector<uint8_t>;
+template class BasicDenseVector<half_t>;
+}
+
+namespace io {
+template class BasicMemoryIO<float>;
+template class BasicMemoryIO<double>;
+template class BasicMemoryIO<uint8_t>;
+template class BasicMemoryIO<half_t>;
+template class BasicSyncIO<float>;
+template class BasicSyncIO<double>;
+template class BasicSyncIO<uint8_t>;
+template class BasicSyncIO<half_t>;
+}
+}
+
+namespace {
+constexpr size_t NFEATURES = 16;
+
+void test_kernels() {
+    // Byte distances are summed exactly
+    uint8_t a[] = { 0, 255, 3 }, b[] = { 255, 0, 3 };
+    assert(distance::euclidean(a, b, 3) == (data_t)std::sqrt(2*255.*255));
+    assert(distance::manhattan(a, b, 3) == 510);
+
+    std::default_random_engine generator(7);
+    std::normal_distribution<double> distribution;
+    std::vector<double> x(NFEATURES), y(NFEATURES);
+    std::vector<float> xf(NFEATURES), yf(NFEATURES);
+    std::vector<half_t> xh(NFEATURES), yh(NFEATURES);
+    for (size_t i = 0; i < NFEATURES; i++) {
+        xf[i] = x[i] = distribution(generator);
+        yf[i] = y[i] = distribution(generator);
+        xh[i] = xf[i];
+        yh[i] = yf[i];
+    }
+
+    const double exact = distance::euclidean(&x[0], &y[0], NFEATURES);
+    assert(std::fabs(distance::euclidean(&xf[0], &yf[0], NFEATURES) - exact)
+            < 1e-5);
+    assert(std::fabs(distance::euclidean(&xh[0], &yh[0], NFEATURES) - exact)
+            < 1e-2);
+    for (metric_t metric : { EUCLIDEAN, MANHATTAN, COSINE })
+        assert(std::fabs(distance::eval(metric, &xf[0], &yf[0], NFEATURES) -
+                    distance::eval(metric, &x[0], &y[0], NFEATURES)) < 1e-4);
+
+    // Double precision GEMM
+    std::vector<double> dists(1);
+    distance::euclidean(&x[0], 1, &y[0], 1, NFEATURES, &dists[0]);
+    assert(std::fabs(dists[0] - exact) < 1e-9);
+    printf("Element type kernel test successful!\n");
+}
+
+void test_containers() {
+    BasicNNVector<double> nnv(2);
+    nnv.eval(3, 1e-12);
+    nnv.eval(1, 2e-12);
+    nnv.eval(2, 0); // Indistinguishable from 1e-12 in float
+    assert(nnv.size() == 2 && nnv[0].get_index() == 2 &&
+            nnv[1].get_index() == 3);
+
+    BasicIndexVector<double> iv;
+    iv.append(5, .5);
+    iv.append(4, .25);
+    iv.sort();
+    assert(iv[0].get_index() == 4);
+
+    uint8_t bytes[] = { 1, 2, 3 };
+    container::BasicDenseVector<uint8_t> sample(bytes, 3);
+    assert(sample.size() == 3 && sample[2] == 3);
+    printf("Element type container test successful!\n");
+}
+
+// The same bvecs file held as bytes & as doubles at once
+void test_io() {
+    constexpr size_t NROW = 10;
+    const std::string fn = "test_elem.bvecs";
+    std::ofstream fs(fn, std::ios::binary);
+    for (size_t row = 0; row < NROW; row++) {
+        int32_t dim = NFEATURES;
+        fs.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+        for (size_t col = 0; col < NFEATURES; col++) {
+            uint8_t val = 16*row + col;
+            fs.write(reinterpret_cast<const char*>(&val), sizeof(val));
+        }
+    }
+    fs.close();
+
+    io::BasicMemoryIO<uint8_t>* bytes = io::BasicMemoryIO<uint8_t>::create();
+    io::BasicMemoryIO<double>* doubles = io::BasicMemoryIO<double>::create();
+    assert((void*)bytes != (void*)doubles);
+    bytes->set_fn(fn);
+    bytes->set_orientation(ROW);
+    bytes->shape(dimpair(NROW, NFEATURES));
+    bytes->from_file();
+    doubles->set_fn(fn);
+    doubles->set_orientation(ROW);
+    doubles->shape(dimpair(NROW, NFEATURES));
+    doubles->from_file();
+
+    for (size_t row = 0; row < NROW; row++)
+        for (size_t col = 0; col < NFEATURES; col++) {
+            assert(bytes->get_row(row)[col] == 16*row + col);
+            assert(doubles->get_row(row)[col] == 16*row + col);
+        }
+    // Rows 16 apart in every dimension
+    assert(bytes->euclidean(bytes->get_row(0), 1) == 64);
+    assert(doubles->euclidean(doubles->get_row(0), 1) == 64);
+
+    bytes->destroy();
+    doubles->destroy();
+    assert(!std::remove(fn.c_str()));
+    printf("Element type IO test successful!\n");
+}
+}
+
+int main(int argc, char** argv) {
+    test_kernels();
+    test_containers();
+    test_io();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <unordered_set>
+
+#include "../common/monya.hpp"
+#include "../utils/time.hpp"
+#include "../io/IO.hpp"
+#include "../structures/SampleVector.hpp"
+#include "../common/cxxopts/cxxopts.hpp"
+#include "balltree.hpp"
+
+using namespace monya;
+
+int main(int argc, char* argv[]) {
+    // Positional args
+    std::string datafn;
+    size_t nsamples;
+    size_t nfeatures;
+
+    // Optional args
+    tree_t ntree;
+    unsigned nthread;
+    depth_t max_depth;
+    mat_orient_t mo = mat_orient_t::COL;
+    constexpr unsigned FANOUT = 2;
+    metric_t metric = metric_t::EUCLIDEAN;
+    size_t nquery;
+    short k;
+    data_t radius;
+
+    try {
+        cxxopts::Options options(argv[0],
+                "balltree data-file nsamples nfeatures [alg-options]\n");
+        options.positional_help("[optional args]");
+
+        options.add_options()
+            ("f,datafn", "Path to data-file on disk",
+             cxxopts::value<std::string>(datafn), "FILE")
+            ("n,nsamples", "Number of samples in the dataset (rows)",
+             cxxopts::value<std::string>())
+            ("m,nfeatures", "Number of features in the dataset (columns)",
+             cxxopts::value<std::string>())
+            ("t,ntree", "Number of trees in the forest",
+             cxxopts::value<tree_t>(ntree)->default_value("1"))
+            ("T,num_thread", "The number of threads to run",
+             cxxopts::value<unsigned>(nthread)->default_value("1"))
+            ("d,depth", "Max tree depth",
+             cxxopts::value<depth_t>(max_depth)->default_value("10"))
+            ("o,orientation", "data orientataion `row` or `col`)",
+             cxxopts::value<std::string>()->default_value("col"))
+            ("M,metric", "`euclidean`, `manhattan` or `cosine`",
+             cxxopts::value<std::string>()->default_value("euclidean"))
+            ("q,nquery", "Validate this many samples as queries",
+             cxxopts::value<size_t>(nquery)->default_value("0"))
+            ("k,nneighbors", "Number of neighbors per query",
+             cxxopts::value<short>(k)->default_value("10"))
+            ("e,radius", "Also validate range queries of this radius",
+             cxxopts::value<std::string>()->default_value("0"))
+            ("h,help", "Print help");
+
+        options.parse_positional({"datafn", "nsamples", "nfeatures"});
+        int nargs = argc;
+        options.parse(argc, argv);
+
+        if (options.count("help") || (nargs == 1)) {
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        if (nargs < 4) {
+            std::cout << "[ERROR]: Not enough default arguments\n";
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        nsamples = atol(options["nsamples"].as<std::string>().c_str());
+        nfeatures = atol(options["nfeatures"].as<std::string>().c_str());
+        mo = options["orientation"].as<std::string>() == "col" ? COL : ROW;
+        radius = atof(options["radius"].as<std::string>().c_str());
+
+        std::string metric_name = options["metric"].as<std::string>();
+        if (metric_name == "manhattan")
+            metric = metric_t::MANHATTAN;
+        else if (metric_name == "cosine")
+            metric = metric_t::COSINE;
+        else if (metric_name != "euclidean")
+            throw parameter_exception("Unknown metric " + metric_name);
+
+    } catch (const cxxopts::OptionException& e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    Params params(nsamples, nfeatures, datafn,
+            io_t::MEM, ntree, nthread, mo, FANOUT, max_depth, file_t::BIN,
+            0, metric);
+    params.print();
+
+    ComputeEngine<BallTreeProgram>::ptr engine =
+        ComputeEngine<BallTreeProgram>::create(params);
+
+    for (auto tree : engine->get_forest()) {
+        container::BinaryNode* root = new ballnode;
+        tree->set_root(root);
+    }
+
+    utils::time timer;
+    timer.tic();
+    engine->train();
+    std::cout << "Algorithmic time " << params.nthread << " threads: "
+        <<  timer.toc() << " sec\n";
+
+    if (!nquery)
+        return EXIT_SUCCESS;
+    nquery = std::min(nquery, nsamples);
+
+    // Compare against a linear scan under the same metric
+    io::IO* ioer = engine->get_tree(0)->get_ioer();
+    std::vector<data_t> data(nsamples*nfeatures);
+    for (size_t i = 0; i < nsamples; i++) {
+        data_t* row = ioer->get_row(i);
+        std::copy(row, row+nfeatures, &data[i*nfeatures]);
+        if (ioer->get_orientation() != ROW)
+            delete [] row;
+    }
+
+    size_t nexact = 0;
+    timer.tic();
+    for (size_t qid = 0; qid < nquery; qid++) {
+        container::DenseVector qsample(&data[qid*nfeatures], nfeatures);
+        container::ProximityQuery query(&qsample, k, ntree);
+        engine->query(&query);
+
+        std::vector<data_t> dists;
+        for (size_t i = 0; i < nsamples; i++)
+            dists.push_back(distance::eval(metric, &data[qid*nfeatures],
+                        &data[i*nfeatures], nfeatures));
+        std::sort(dists.begin(), dists.end());
+
+        bool exact = true;
+        for (auto nnv : query.getNN())
+            for (size_t i = 0; i < nnv->size(); i++)
+                exact &= (*nnv)[i].get_val() == dists[i];
+        nexact += exact;
+    }
+
+    size_t ndist = 0;
+    for (auto tree : engine->get_forest())
+        ndist += tree->get_ndist();
+
+    std::cout << nexact << "/" << nquery << " queries exact in " <<
+        timer.toc() << " sec. Distances per query per tree: " <<
+        (double)ndist / (nquery*ntree) << " of " << nsamples << std::endl;
+
+    // Materialized & count only range queries must both match a linear scan
+    size_t nrange = 0;
+    if (radius > 0) {
+        timer.tic();
+        for (size_t qid = 0; qid < nquery; qid++) {
+            container::DenseVector qsample(&data[qid*nfeatures], nfeatures);
+            container::RangeQuery query(&qsample, radius, ntree);
+            container::RangeQuery counter(&qsample, radius, ntree, true);
+            engine->query(&query);
+            engine->query(&counter);
+
+            size_t expected = 0;
+            for (size_t i = 0; i < nsamples; i++)
+                expected += distance::eval(metric, &data[qid*nfeatures],
+                        &data[i*nfeatures], nfeatures) <= radius;
+
+            bool exact = true;
+            for (tree_t tid = 0; tid < ntree; tid++)
+                exact &= query.get_result(tid).size() == expected &&
+                    counter.get_count(tid) == expected;
+            nrange += exact;
+        }
+        std::cout << nrange << "/" << nquery << " range queries exact in " <<
+            timer.toc() << " sec\n";
+    }
+
+    return nexact == nquery && (radius <= 0 || nrange == nquery) ?
+        EXIT_SUCCESS : EXIT_FAILURE;
+}
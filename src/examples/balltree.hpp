@@ -0,0 +1,346 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_BALLTREE_HPP__
+#define MONYA_BALLTREE_HPP__
+
+#include <atomic>
+
+#include "../common/monya.hpp"
+#include "../io/IO.hpp"
+#include "../structures/SampleVector.hpp"
+
+namespace monya {
+/**
+  * A ball: Every member is within `radius` of `center` under `metric`. The
+  *  members are split between the two points farthest apart (approximately)
+  *  so the children's balls overlap as little as possible.
+  */
+class ballnode: public container::BinaryNode {
+    private:
+        metric_t metric;
+        std::vector<data_t> center;
+        data_t radius;
+
+        // Caller frees if the orientation is not ROW
+        data_t* get_member(const sample_id_t idx) {
+            data_t* member = ioer->get_row(idx);
+            assert(NULL != member);
+            return member;
+        }
+
+        void put_member(data_t* member) {
+            if (ioer->get_orientation() != ROW)
+                delete [] member;
+        }
+
+        // For members held across other reads
+        void copy_member(const sample_id_t idx, std::vector<data_t>& to) {
+            data_t* member = get_member(idx);
+            to.assign(member, member + center.size());
+            put_member(member);
+        }
+
+        // The member farthest from `from`
+        sample_id_t farthest(data_t* from) {
+            sample_id_t far = data_index[0].get_index();
+            data_t far_dist = -1;
+
+            for (auto iv : data_index) {
+                data_t* member = get_member(iv.get_index());
+                data_t dist = distance::eval(metric, from, member,
+                        center.size());
+                put_member(member);
+
+                if (dist > far_dist) {
+                    far_dist = dist;
+                    far = iv.get_index();
+                }
+            }
+            return far;
+        }
+
+    public:
+        using container::BinaryNode::BinaryNode;
+
+        ballnode() : metric(EUCLIDEAN), radius(0) {
+            parent = left = right = NULL;
+        }
+
+        static ballnode* cast2(container::BinaryNode* node) {
+            return static_cast<ballnode*>(node);
+        }
+
+        void set_metric(const metric_t metric) {
+            this->metric = metric;
+        }
+
+        const data_t* get_center() const { return &center[0]; }
+        const data_t get_radius() const { return radius; }
+
+        data_t distance(data_t* sample, const sample_id_t idx) override {
+            data_t* member = get_member(idx);
+            data_t dist = distance::eval(metric, sample, member,
+                    ioer->shape().second);
+            put_member(member);
+            return dist;
+        }
+
+        data_t distance(container::SampleVector* s1,
+                const sample_id_t idx) override {
+            return distance(s1->dense(), idx);
+        }
+
+        // Lower bound on the distance from `sample` to any member
+        data_t min_dist(data_t* sample) {
+            data_t dist = distance::eval(metric, sample, &center[0],
+                    center.size());
+            return std::max<data_t>(0, dist - radius);
+        }
+
+        // Upper bound on the distance from `sample` to any member
+        data_t max_dist(data_t* sample) {
+            return distance::eval(metric, sample, &center[0], center.size()) +
+                radius;
+        }
+
+        // The root starts with every sample
+        void prep() override {
+            if (data_index.empty()) {
+                data_index.reserve(ioer->shape().first);
+                for (sample_id_t idx = 0; idx < ioer->shape().first; idx++)
+                    data_index.append(idx, 0);
+            }
+        }
+
+        // Centroid & radius in a parallel pass over the members. Workers
+        //  already run nodes concurrently so only the top levels fan out
+        void run() override {
+            const size_t nfeatures = ioer->shape().second;
+            const size_t nmembers = data_index.size();
+            center.assign(nfeatures, 0);
+            if (!nmembers)
+                return;
+
+            std::vector<double> sum(nfeatures, 0);
+            double* psum = &sum[0];
+#pragma omp parallel for if (depth < 3) reduction(+:psum[:nfeatures])
+            for (size_t i = 0; i < nmembers; i++) {
+                data_t* member = get_member(data_index[i].get_index());
+                for (size_t j = 0; j < nfeatures; j++)
+                    psum[j] += member[j];
+                put_member(member);
+            }
+
+            for (size_t j = 0; j < nfeatures; j++)
+                center[j] = sum[j] / nmembers;
+
+            data_t max_dist = 0;
+#pragma omp parallel for if (depth < 3) reduction(max:max_dist)
+            for (size_t i = 0; i < nmembers; i++) {
+                data_t* member = get_member(data_index[i].get_index());
+                data_t dist = distance::eval(metric, &center[0], member,
+                        nfeatures);
+                put_member(member);
+                if (dist > max_dist)
+                    max_dist = dist;
+            }
+            radius = max_dist;
+        }
+
+        // Pivot on the members farthest apart & order by which is nearer
+        void spawn() override {
+            left = new ballnode;
+            right = new ballnode;
+
+            bestow(left);
+            bestow(right);
+            cast2(left)->set_metric(metric);
+            cast2(right)->set_metric(metric);
+
+            // The pivots are copied out: rows decoded on demand live in a
+            //  ring that the member reads below would overwrite
+            std::vector<data_t> lpivot, rpivot;
+            copy_member(farthest(&center[0]), lpivot);
+            copy_member(farthest(&lpivot[0]), rpivot);
+
+            for (auto it = data_index.begin(); it != data_index.end(); ++it) {
+                data_t* member = get_member(it->get_index());
+                it->set_val(distance::eval(metric, &lpivot[0], member,
+                            center.size()) - distance::eval(metric,
+                                &rpivot[0], member, center.size()));
+                put_member(member);
+            }
+            sort_data_index(depth < 3);
+
+            std::vector<sample_id_t> idxs;
+            data_index.get_indexes(idxs);
+
+            const size_t nleft = (idxs.size() + 1) / 2;
+            left->set_ph_data_index(&idxs[0], nleft);
+            right->set_ph_data_index(&idxs[nleft], idxs.size()-nleft);
+        }
+
+        void print() override {
+            printf("Radius: %.2f, Depth: %lu\n", radius, (size_t)get_depth());
+            printf("Membership: %s\n",  data_index.to_string().c_str());
+        }
+};
+
+// Exact kNN under any metric_t with triangle inequality pruning
+class BallTreeProgram: public BinaryTreeProgram {
+    private:
+        metric_t metric;
+        std::atomic<size_t> ndist; // Member distances computed by queries
+
+    public:
+        BallTreeProgram(Params& params, const tree_t tree_id,
+                const int numa_id=0) :
+            BinaryTreeProgram(params, tree_id, numa_id),
+            metric(params.metric), ndist(0) {
+        }
+
+        void set_root(container::BinaryNode*& node) {
+            ballnode::cast2(node)->set_metric(metric);
+            BinaryTreeProgram::set_root(node);
+        }
+
+        const size_t get_ndist() const { return ndist; }
+
+        const bool axis_aligned() const override {
+            return false;
+        }
+
+        // Ball splits aren't axis aligned so FlatBinaryTree can't describe them
+        void freeze() override {
+        }
+
+        void find_neighbors(container::Query* q) override {
+            container::ProximityQuery* query =
+                container::ProximityQuery::raw_cast(q);
+            data_t* sample = query->get_qsample()->dense();
+            NNVector* nnv = query->getNN()[tree_id];
+            const size_t k = query->get_k();
+            container::QueryStats& stats = query->get_stats();
+
+            container::ReadGuard guard(scheduler);
+
+            // Each entry holds a lower bound on the distance to its members
+            container::Stack<std::pair<ballnode*, data_t> > visited;
+            ballnode* root = ballnode::cast2(get_root());
+            visited.push(std::make_pair(root, root->min_dist(sample)));
+
+            while (!visited.empty()) {
+                std::pair<ballnode*, data_t> top = visited.pop();
+                ballnode* node = top.first;
+
+                // Triangle inequality: No member can beat the k-th neighbor
+                if (nnv->size() == k && top.second >= (*nnv)[k-1].get_val()) {
+                    stats[container::QueryStats::PRUNED]++;
+                    continue;
+                }
+
+                if (node->has_child()) {
+                    stats[container::QueryStats::NODES]++;
+                    std::pair<ballnode*, data_t> near, far;
+                    near = std::make_pair(ballnode::cast2(node->left),
+                            ballnode::cast2(node->left)->min_dist(sample));
+                    far = std::make_pair(ballnode::cast2(node->right),
+                            ballnode::cast2(node->right)->min_dist(sample));
+                    if (far.second < near.second)
+                        std::swap(near, far);
+
+                    visited.push(far);
+                    visited.push(near);
+                    continue;
+                }
+
+                stats[container::QueryStats::LEAVES]++;
+                if (pager) // Fault the leaf in
+                    stats[container::QueryStats::IO_BYTES] +=
+                        node->cache(pager);
+                for (IndexVal<data_t> iv : node->get_data_index()) {
+                    if (is_deleted(iv.get_index()))
+                        continue;
+                    query->eval(iv.get_index(),
+                            node->distance(sample, iv.get_index()), tree_id);
+                    ndist++;
+                    stats[container::QueryStats::DISTANCES]++;
+                    stats[container::QueryStats::IO_BYTES] +=
+                        nfeatures*sizeof(data_t);
+                }
+                if (pager) node->uncache(pager);
+            }
+        }
+
+        // Balls beyond the radius are skipped. Count only queries take balls
+        //  wholly inside it without computing member distances
+        void find_in_range(container::RangeQuery* query) override {
+            data_t* sample = query->get_qsample()->dense();
+            const data_t radius = query->get_radius();
+            // Balls are only taken whole when rounding can't matter
+            const data_t inside = radius*(1 - 1e-5);
+
+            container::ReadGuard guard(scheduler);
+
+            // Each entry is flagged once its ball is known to be inside
+            container::Stack<std::pair<ballnode*, bool> > visited;
+            visited.push(std::make_pair(ballnode::cast2(get_root()), false));
+
+            while (!visited.empty()) {
+                std::pair<ballnode*, bool> top = visited.pop();
+                ballnode* node = top.first;
+                bool whole = top.second;
+                if (!whole) {
+                    if (node->min_dist(sample) > radius)
+                        continue;
+                    whole = query->is_count_only() &&
+                        node->max_dist(sample) <= inside;
+                }
+
+                if (node->has_child()) {
+                    visited.push(std::make_pair(ballnode::cast2(node->right),
+                                whole));
+                    visited.push(std::make_pair(ballnode::cast2(node->left),
+                                whole));
+                    continue;
+                }
+
+                if (pager) node->cache(pager); // Fault the leaf in
+                if (whole) {
+                    size_t nlive = 0;
+                    for (IndexVal<data_t> iv : node->get_data_index())
+                        nlive += !is_deleted(iv.get_index());
+                    query->count(nlive, tree_id);
+                } else {
+                    for (IndexVal<data_t> iv : node->get_data_index()) {
+                        if (is_deleted(iv.get_index()))
+                            continue;
+                        query->eval(iv.get_index(),
+                                node->distance(sample, iv.get_index()),
+                                tree_id);
+                        ndist++;
+                    }
+                }
+                if (pager) node->uncache(pager);
+            }
+        }
+};
+} // End monya
+#endif
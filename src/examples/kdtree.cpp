@@ -28,220 +28,10 @@
 #include "../structures/SampleVector.hpp"
 #include "../validate/BruteForcekNN.hpp"
 #include "../common/cxxopts/cxxopts.hpp"
+#include "kdtree.hpp"
 
 using namespace monya;
 
-class kdnode: public container::BinaryNode {
-    private:
-        size_t split_dim;
-#ifdef PRUNE
-        std::vector<data_t> upper_bounds, lower_bounds;
-#endif
-        bool complete;
-
-    public:
-        // Inherit constructors
-        using container::BinaryNode::BinaryNode;
-
-        kdnode() {
-            parent = left = right = NULL;
-        }
-
-        static kdnode* cast2(container::BinaryNode* node) {
-            return static_cast<kdnode*>(node);
-        }
-
-        data_t distance(container::SampleVector* s1,
-                const sample_id_t idx) override {
-            data_t* member = ioer->get_row(idx);
-            assert(NULL != member);
-            data_t dist = distance::euclidean(s1->raw_data(),
-                    member, s1->size());
-
-            if (ioer->get_orientation() != ROW)
-                delete [] member;
-            return dist;
-        }
-
-        void spawn() override {
-
-            // TODO: Boilerplate
-            left = new kdnode;
-            right = new kdnode;
-
-            bestow(left);
-            bestow(right);
-            // End TODO: Boilerplate
-
-            auto next_split = split_dim+1 == ioer->shape().second ?
-                    0 : split_dim+1;
-            cast2(left)->set_split_dim(next_split);
-            cast2(left)->set_index(next_split);
-            cast2(right)->set_split_dim(next_split);
-            cast2(right)->set_index(next_split);
-
-
-            std::vector<sample_id_t> idxs;
-            data_index.get_indexes(idxs);
-
-            std::vector<offset_t> offsets = { 0, data_index.size() / 2 };
-            assert(idxs.size() == data_index.size());
-
-            // NOTE: Always <= go left and > right
-            // TODO: Better way to set split value
-            assert(offsets.size() == 2);
-
-            left->set_ph_data_index(&idxs[offsets[0]], offsets[1]-offsets[0]);
-            right->set_ph_data_index(&idxs[offsets[1]],
-                    idxs.size()-offsets[1]);
-        }
-
-        void set_split_dim(size_t split_dim) {
-            this->split_dim = split_dim;
-        }
-
-        const size_t get_split_dim() const {
-            return split_dim;
-        }
-
-        // TODO: ||ize
-#ifdef PRUNE
-        void compute_bounds() {
-            // Upper and lower bounds at this node
-            lower_bounds.assign(ioer->shape().second,
-                    std::numeric_limits<data_t>::max());
-            upper_bounds.assign(ioer->shape().second,
-                    std::numeric_limits<data_t>::min());
-
-            for (auto iv : data_index) {
-                data_t* sample = ioer->get_row(iv.get_index());
-
-                for (size_t feat_id = 0; feat_id < ioer->shape().second;
-                        feat_id++) {
-                    if (sample[feat_id] < lower_bounds[feat_id])
-                        lower_bounds[feat_id] = sample[feat_id];
-                    if (sample[feat_id] > upper_bounds[feat_id])
-                        upper_bounds[feat_id] = sample[feat_id];
-                }
-
-                if (ioer->get_orientation() != ROW)
-                    delete [] sample; // TODO: Coz wrong access pattern
-            }
-        }
-#endif
-
-        // This is run next
-        void run() override {
-            if (depth < 3) {
-                sort_data_index(true); // Paralleize the sort
-            } else {
-                sort_data_index(false);
-            }
-
-            this->set_comparator(data_index[data_index.size() / 2 ].get_val());
-#if 0
-            printf("Printing data from node at depth: %lu with comparator "
-                    ":%.2f\n", depth, get_comparator());
-#endif
-#ifdef PRUNE
-            // What makes pruning possible
-            compute_bounds();
-#endif
-        }
-
-        void print() override {
-            printf("Comparator: %.2f, Split dim: %lu\n %s\n", get_comparator(),
-            get_split_dim(), data_index.to_string().c_str());
-            printf("Membership: %s\n",  data_index.to_string().c_str());
-#if 0
-            std::cout << "Upper bounds:\n";
-            io::print_arr<data_t>(&upper_bounds[0], upper_bounds.size());
-            std::cout << "Lower bounds:\n";
-            io::print_arr<data_t>(&lower_bounds[0], lower_bounds.size());
-#endif
-            std::cout << "\n";
-        }
-};
-
-
-// How the program runs
-class kdTreeProgram: public BinaryTreeProgram {
-    private:
-        // All the trees in the forest (including this one!)
-        std::vector<kdTreeProgram*> copse;
-        std::unordered_set<container::BinaryNode*> completed;
-
-    public:
-        // Can be used if we need no more constructors
-        using BinaryTreeProgram::BinaryTreeProgram;
-
-        void find_neighbors(container::Query* q) override {
-            kdnode* node = kdnode::cast2(get_root());
-            container::ProximityQuery* query =
-                container::ProximityQuery::raw_cast(q);
-            completed.clear();
-
-            // Keep track of visited nodes
-            container::Stack<kdnode*> visited;
-
-            do {
-                visited.push(node);
-                // compare
-                auto split_dim = node->get_split_dim();
-                if ((*query)[split_dim] > node->get_comparator()) {
-                    node = kdnode::cast2(node->right);
-                } else {
-                    node = kdnode::cast2(node->left);
-                }
-            } while (node);
-#if 1
-            // TEST: Print the path the sample took
-            printf("Printing the nodes in the path:\n");
-            for (kdnode* node : visited) {
-                node->print();
-            }
-#endif
-            // Found query's closest node in tree, now compute dist from samples
-            while (!visited.empty()) {
-                kdnode* node = visited.pop(); // Now complete
-                std::cout << "Popping node with comparator: "
-                    << node->get_comparator() << "\n";
-                // TODO: Prune step
-
-                // Compute distance from a sample to the nodes stored here
-                //  if it's a leaf
-
-                if (!node->has_child()) {
-                    for (IndexVal<data_t> iv : node->get_data_index()) {
-                        auto dist = node->distance(&(query->get_qsample()[0]),
-                                iv.get_index());
-                        std::cout << "\n\nDist to: " << iv.get_index() <<
-                            " = " << dist << std::endl;
-
-                        query->eval(iv.get_index(), dist, tree_id);
-                    }
-                } else {
-                    auto l = completed.find(node->left);
-                    if (l == completed.end()) { // lhs hasn't been processed
-                        std::cout << "Node c: " << node->get_comparator() <<
-                            " pushing Node c: " <<
-                            node->left->get_comparator() << "\n";
-                        visited.push(kdnode::cast2(node->left));
-                    }
-
-                    auto r = completed.find(node->right);
-                    if (r == completed.end()) { // rhs hasn't been processed
-                        std::cout << "Node c: " << node->get_comparator() <<
-                            " pushing Node c: " << node->right->get_comparator()
-                            << " ";
-                        visited.push(kdnode::cast2(node->right));
-                    }
-                }
-                completed.insert(node);
-            }
-        }
-};
-
 class RandomSplit {
     private:
         std::default_random_engine generator;
@@ -270,6 +60,19 @@ int main(int argc, char* argv[]) {
     mat_orient_t mo = mat_orient_t::COL;
     constexpr unsigned FANOUT = 2;
     bool approx = false;
+    std::string savefn;
+    size_t resident_budget;
+    size_t nquery;
+    size_t qblock;
+    std::string graphfn;
+    unsigned graph_k;
+    unsigned nrefine;
+    data_t radius;
+    std::string tracefn;
+    bool chrome = false;
+    storage_t storage = storage_t::F32;
+    file_t filetype = file_t::BIN;
+    io_t iotype = io_t::MEM;
 
     try {
         cxxopts::Options options(argv[0],
@@ -293,6 +96,31 @@ int main(int argc, char* argv[]) {
              cxxopts::value<std::string>()->default_value("col"))
             ("A,approx", "Do approx rather than exact kNN",
              cxxopts::value<bool>(approx))
+            ("s,save", "Persist the trained forest to this file",
+             cxxopts::value<std::string>(savefn), "FILE")
+            ("r,resident", "Bytes of leaf index kept in memory (0: all)",
+             cxxopts::value<size_t>(resident_budget)->default_value("0"))
+            ("q,nquery", "Validate this many samples as one batch query",
+             cxxopts::value<size_t>(nquery)->default_value("0"))
+            ("b,qblock", "Queries carried down a tree together",
+             cxxopts::value<size_t>(qblock)->default_value("64"))
+            ("G,graph", "Write the kNN graph to FILE.ivecs & FILE.fvecs",
+             cxxopts::value<std::string>(graphfn), "FILE")
+            ("k,nneighbors", "Neighbors per sample in the kNN graph",
+             cxxopts::value<unsigned>(graph_k)->default_value("10"))
+            ("R,nrefine", "Neighbor-of-neighbor rounds for the kNN graph",
+             cxxopts::value<unsigned>(nrefine)->default_value("2"))
+            ("e,radius", "Also validate range queries of this radius",
+             cxxopts::value<std::string>()->default_value("0"))
+            ("x,trace", "Write build timings to this file (INSTRUMENT=1)",
+             cxxopts::value<std::string>(tracefn))
+            ("C,chrome", "Write the build trace in Chrome trace format",
+             cxxopts::value<bool>(chrome))
+            ("Q,storage", "In memory storage: f32, f16, int8 or sparse (COO "
+             "data-file)",
+             cxxopts::value<std::string>()->default_value("f32"))
+            ("H,hdf5", "data-file is HDF5, FILE or FILE:/dataset (USE_HDF5=1)")
+            ("O,outofcore", "Read columns from data-file as nodes need them")
             ("h,help", "Print help");
 
         options.parse_positional({"datafn", "nsamples", "nfeatures"});
@@ -313,6 +141,14 @@ int main(int argc, char* argv[]) {
         nsamples = atol(options["nsamples"].as<std::string>().c_str());
         nfeatures = atol(options["nfeatures"].as<std::string>().c_str());
         mo = options["orientation"].as<std::string>() == "col" ? COL : ROW;
+        radius = atof(options["radius"].as<std::string>().c_str());
+        std::string st = options["storage"].as<std::string>();
+        storage = st == "f16" ? F16 : st == "int8" ? INT8 :
+            st == "sparse" ? SPARSE : F32;
+        if (options.count("hdf5"))
+            filetype = file_t::HDF5;
+        if (options.count("outofcore"))
+            iotype = io_t::SYNC;
 
     } catch (const cxxopts::OptionException& e) {
         std::cout << "error parsing options: " << e.what() << std::endl;
@@ -320,7 +156,8 @@ int main(int argc, char* argv[]) {
     }
 
     Params params(nsamples, nfeatures, datafn,
-            io_t::MEM, ntree, nthread, mo, FANOUT, max_depth);
+            iotype, ntree, nthread, mo, FANOUT, max_depth, filetype,
+            resident_budget, metric_t::EUCLIDEAN, storage);
     assert(ntree < params.nfeatures);
     params.print();
 
@@ -359,6 +196,149 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Algorithmic time " << params.nthread << " threads: "
         <<  timer.toc() << " sec\n";
+    if (engine->get_colcache())
+        std::cout << "Columns read: " << engine->get_colcache()->get_nfetched()
+            << ", shared: " << engine->get_colcache()->get_nshared() << "\n";
+
+    if (!tracefn.empty()) {
+        std::ofstream trace(tracefn);
+        engine->write_build_trace(trace, chrome);
+        std::cout << "Build trace written to '" << tracefn << "'\n";
+    }
+
+    if (!savefn.empty()) {
+        timer.tic();
+        engine->save(savefn);
+        std::cout << "Forest persisted to '" << savefn << "' in " <<
+            timer.toc() << " sec\n";
+
+        timer.tic();
+        container::EMForest::ptr mapped = container::EMForest::create(savefn);
+        std::cout << "Mapped " << mapped->ntree() << " tree(s) back in " <<
+            timer.toc() << " sec\n";
+    }
+
+    // Row major copy for validation
+    std::vector<data_t> data;
+    if (nquery || !graphfn.empty()) {
+        io::IO* ioer = engine->get_tree(0)->get_ioer();
+        data.resize(nsamples*nfeatures);
+        for (size_t i = 0; i < nsamples; i++) {
+            data_t* row = ioer->get_row(i);
+            std::copy(row, row+nfeatures, &data[i*nfeatures]);
+            if (ioer->get_orientation() != ROW)
+                delete [] row;
+        }
+    }
+
+    if (nquery) {
+        nquery = std::min(nquery, nsamples);
+        constexpr short k = 5;
+
+        std::vector<container::DenseVector> qsamples;
+        std::vector<container::ProximityQuery*> queries;
+        qsamples.reserve(nquery);
+        for (size_t qid = 0; qid < nquery; qid++) {
+            qsamples.emplace_back(&data[qid*nfeatures], nfeatures);
+            queries.push_back(new container::ProximityQuery(&qsamples.back(),
+                        k, ntree));
+        }
+
+        container::BatchProximityQuery batch(queries, !approx, qblock);
+        timer.tic();
+        engine->query(&batch);
+        std::cout << "Batch of " << nquery << " queries in " << timer.toc()
+            << " sec\n";
+        engine->get_query_stats().print(std::cout);
+
+        std::vector<IndexVector> truths;
+        validate::BruteForcekNN bf(&data[0], nsamples, nfeatures, nthread);
+        bf.getNN(&data[0], nquery, k, truths);
+        size_t nexact = 0;
+        for (size_t qid = 0; qid < nquery; qid++) {
+            IndexVector& iv = truths[qid];
+            bool exact = true;
+            for (auto nnv : queries[qid]->getNN())
+                for (size_t i = 0; i < iv.size(); i++)
+                    exact &= i < nnv->size() &&
+                        (*nnv)[i].get_val() == iv[i].get_val();
+            nexact += exact;
+            delete queries[qid];
+        }
+        std::cout << nexact << "/" << nquery <<
+            " queries match a linear scan\n";
+    }
+
+    if (nquery && radius > 0) {
+        // One buffer reused across the queries
+        container::RangeQuery query(NULL, radius, ntree, false, 1024);
+        container::RangeQuery counter(NULL, radius, ntree, true);
+        size_t nexact = 0, nfound = 0;
+        timer.tic();
+        for (size_t qid = 0; qid < nquery; qid++) {
+            container::DenseVector qsample(&data[qid*nfeatures], nfeatures);
+            query.clear();
+            counter.clear();
+            query.set_qsample(&qsample);
+            counter.set_qsample(&qsample);
+            engine->query(&query);
+            engine->query(&counter);
+
+            size_t expected = 0;
+            for (size_t i = 0; i < nsamples; i++)
+                expected += distance::euclidean(&data[qid*nfeatures],
+                        &data[i*nfeatures], nfeatures) <= radius;
+
+            bool exact = true;
+            for (tree_t tid = 0; tid < ntree; tid++)
+                exact &= query.get_result(tid).size() == expected &&
+                    counter.get_count(tid) == expected;
+            nexact += exact;
+            nfound += expected;
+        }
+        std::cout << nexact << "/" << nquery << " range queries (" <<
+            (double)nfound / nquery << " matches each) exact in " <<
+            timer.toc() << " sec\n";
+    }
+
+    if (!graphfn.empty()) {
+        timer.tic();
+        container::KNNGraph::ptr graph = engine->knn_graph(graph_k, nrefine);
+        std::cout << graph_k << "NN graph built in " << timer.toc() <<
+            " sec\n";
+
+        timer.tic();
+        graph->write(graphfn + ".ivecs", graphfn + ".fvecs");
+        std::cout << "Graph written to '" << graphfn << ".{i,f}vecs' in " <<
+            timer.toc() << " sec\n";
+
+        // Recall of a sample of the rows
+        std::vector<sample_id_t> rows;
+        std::vector<data_t> sampled;
+        for (sample_id_t row = 0; row < nsamples; row += 1 + nsamples/256) {
+            rows.push_back(row);
+            sampled.insert(sampled.end(), &data[row*nfeatures],
+                    &data[(row+1)*nfeatures]);
+        }
+
+        // The sample itself is its own nearest neighbor
+        std::vector<IndexVector> truths;
+        validate::BruteForcekNN bf(&data[0], nsamples, nfeatures, nthread);
+        bf.getNN(&sampled[0], rows.size(), graph_k+1, truths);
+
+        size_t nfound = 0, nexpected = 0;
+        for (size_t r = 0; r < rows.size(); r++) {
+            const sample_id_t row = rows[r];
+            IndexVector& iv = truths[r];
+            for (size_t i = 1; i < iv.size(); i++) {
+                const sample_id_t* ids = graph->get_ids(row);
+                nfound += std::find(ids, ids+graph->get_size(row),
+                        iv[i].get_index()) != ids+graph->get_size(row);
+                nexpected++;
+            }
+        }
+        std::cout << "Graph recall: " << (double)nfound / nexpected << "\n";
+    }
 
 #if 0
     std::cout << "Echoing the tree contents:\n";
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_KDTREE_HPP__
+#define MONYA_KDTREE_HPP__
+
+#include <limits>
+
+#include "../common/monya.hpp"
+#include "../structures/SampleVector.hpp"
+
+namespace monya {
+// Median splits on one feature at a time, cycling through the features
+class kdnode: public container::BinaryNode {
+    private:
+        size_t split_dim;
+#ifdef PRUNE
+        std::vector<data_t> bounds; // Lower bounds then upper bounds
+#endif
+
+    public:
+        // Inherit constructors
+        using container::BinaryNode::BinaryNode;
+
+        kdnode() {
+            parent = left = right = NULL;
+        }
+
+        static kdnode* cast2(container::BinaryNode* node) {
+            return static_cast<kdnode*>(node);
+        }
+
+        data_t distance(container::SampleVector* s1,
+                const sample_id_t idx) override {
+            return ioer->euclidean(s1->dense(), idx);
+        }
+
+        void spawn() override {
+
+            // TODO: Boilerplate
+            left = new kdnode;
+            right = new kdnode;
+
+            bestow(left);
+            bestow(right);
+            // End TODO: Boilerplate
+
+            auto next_split = split_dim+1 == ioer->shape().second ?
+                    0 : split_dim+1;
+            cast2(left)->set_split_dim(next_split);
+            cast2(left)->set_index(next_split);
+            cast2(right)->set_split_dim(next_split);
+            cast2(right)->set_index(next_split);
+
+
+            std::vector<sample_id_t> idxs;
+            data_index.get_indexes(idxs);
+
+            std::vector<offset_t> offsets = { 0, data_index.size() / 2 };
+            assert(idxs.size() == data_index.size());
+
+            // NOTE: Always <= go left and > right
+            // TODO: Better way to set split value
+            assert(offsets.size() == 2);
+
+            left->set_ph_data_index(&idxs[offsets[0]], offsets[1]-offsets[0]);
+            right->set_ph_data_index(&idxs[offsets[1]],
+                    idxs.size()-offsets[1]);
+        }
+
+        void set_split_dim(size_t split_dim) {
+            this->split_dim = split_dim;
+        }
+
+        void to_em(container::EMNode& em) override {
+            container::BinaryNode::to_em(em);
+            em.split_dim = split_dim;
+        }
+
+#ifdef PRUNE
+        const data_t* get_lower_bounds() override {
+            return bounds.empty() ? NULL : &bounds[0];
+        }
+
+        const data_t* get_upper_bounds() override {
+            return bounds.empty() ? NULL : &bounds[bounds.size()/2];
+        }
+#endif
+
+        const size_t get_split_dim() const {
+            return split_dim;
+        }
+
+        // TODO: ||ize
+#ifdef PRUNE
+        void compute_bounds() {
+            // Upper and lower bounds at this node
+            const size_t nfeatures = ioer->shape().second;
+            bounds.assign(nfeatures, std::numeric_limits<data_t>::max());
+            bounds.resize(2*nfeatures, std::numeric_limits<data_t>::min());
+            data_t* lower_bounds = &bounds[0];
+            data_t* upper_bounds = &bounds[nfeatures];
+
+            for (auto iv : data_index) {
+                data_t* sample = ioer->get_row(iv.get_index());
+
+                for (size_t feat_id = 0; feat_id < nfeatures; feat_id++) {
+                    if (sample[feat_id] < lower_bounds[feat_id])
+                        lower_bounds[feat_id] = sample[feat_id];
+                    if (sample[feat_id] > upper_bounds[feat_id])
+                        upper_bounds[feat_id] = sample[feat_id];
+                }
+
+                if (ioer->get_orientation() != ROW)
+                    delete [] sample; // TODO: Coz wrong access pattern
+            }
+        }
+#endif
+
+        // This is run next
+        void run() override {
+            if (depth < 3) {
+                sort_data_index(true); // Paralleize the sort
+            } else {
+                sort_data_index(false);
+            }
+
+            this->set_comparator(data_index[data_index.size() / 2 ].get_val());
+#if 0
+            printf("Printing data from node at depth: %lu with comparator "
+                    ":%.2f\n", depth, get_comparator());
+#endif
+#ifdef PRUNE
+            // What makes pruning possible
+            compute_bounds();
+#endif
+        }
+
+        void print() override {
+            printf("Comparator: %.2f, Split dim: %lu\n %s\n", get_comparator(),
+            get_split_dim(), data_index.to_string().c_str());
+            printf("Membership: %s\n",  data_index.to_string().c_str());
+#if 0
+            std::cout << "Upper bounds:\n";
+            io::print_arr<data_t>(get_upper_bounds(), bounds.size()/2);
+            std::cout << "Lower bounds:\n";
+            io::print_arr<data_t>(get_lower_bounds(), bounds.size()/2);
+#endif
+            std::cout << "\n";
+        }
+};
+
+
+// How the program runs
+class kdTreeProgram: public BinaryTreeProgram {
+    private:
+        // All the trees in the forest (including this one!)
+        std::vector<kdTreeProgram*> copse;
+
+    public:
+        // Can be used if we need no more constructors
+        using BinaryTreeProgram::BinaryTreeProgram;
+
+        void find_neighbors(container::Query* q) override {
+            assert(NULL != frozen); // ComputeEngine::train freezes the tree
+            container::ProximityQuery* query =
+                container::ProximityQuery::raw_cast(q);
+            const data_t* sample = query->get_qsample()->dense();
+            container::QueryStats& stats = query->get_stats();
+            container::ReadGuard guard(scheduler);
+
+            // Nodes the sample falls into are visited before their siblings
+            container::Stack<node_id_t> visited;
+            visited.push(0);
+
+            while (!visited.empty()) {
+                const container::FlatNode& node =
+                    frozen->get_node(visited.pop());
+                // TODO: Prune step
+
+                if (!node.is_leaf()) {
+                    stats[container::QueryStats::NODES]++;
+                    const node_id_t near = frozen->get_child(node, sample);
+                    visited.push(near == node.child ? near+1 : node.child);
+                    visited.push(near);
+                    continue;
+                }
+
+                // Compute distance from a sample to the samples stored here
+                container::BinaryNode* leaf = frozen->get_leaf(node);
+                if (NULL == leaf)
+                    continue;
+
+                stats[container::QueryStats::LEAVES]++;
+                if (pager) // Fault the leaf in
+                    stats[container::QueryStats::IO_BYTES] +=
+                        leaf->cache(pager);
+                for (IndexVal<data_t> iv : leaf->get_data_index()) {
+                    if (is_deleted(iv.get_index()))
+                        continue;
+
+                    query->eval(iv.get_index(), leaf->distance(
+                                query->get_qsample(), iv.get_index()),
+                            tree_id);
+                    stats[container::QueryStats::DISTANCES]++;
+                    stats[container::QueryStats::IO_BYTES] +=
+                        nfeatures*sizeof(data_t);
+                }
+                if (pager) leaf->uncache(pager);
+            }
+        }
+
+        // Queries in a batch share the descent & the leaf scans
+        void find_neighbors_batch(
+                container::BatchProximityQuery* batch) override {
+            find_neighbors_blocked(batch);
+        }
+
+        void find_in_range(container::RangeQuery* query) override {
+            find_in_range_axis(query);
+        }
+};
+} // End monya
+#endif
@@ -0,0 +1,474 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <atomic>
+#include <unordered_set>
+
+#include "../common/monya.hpp"
+#include "../utils/time.hpp"
+#include "../io/IO.hpp"
+#include "../structures/SampleVector.hpp"
+#include "../common/cxxopts/cxxopts.hpp"
+
+using namespace monya;
+
+/**
+  * A k-means tree node: Members are clustered into (up to) `fanout` children
+  *  with Lloyd's algorithm. Each node keeps the center & radius of its
+  *  members so queries can bound the distance to everything below it.
+  */
+class kmnode: public container::NAryNode {
+    private:
+        unsigned fanout;
+        std::vector<data_t> center;
+        data_t radius;
+
+        // Caller frees if the orientation is not ROW
+        data_t* get_member(const sample_id_t idx) {
+            data_t* member = ioer->get_row(idx);
+            assert(NULL != member);
+            return member;
+        }
+
+        void put_member(data_t* member) {
+            if (ioer->get_orientation() != ROW)
+                delete [] member;
+        }
+
+    public:
+        static constexpr unsigned MAX_ITERS = 10;
+
+        kmnode(const unsigned fanout=2) : fanout(fanout), radius(0) {
+            parent = NULL;
+        }
+
+        static kmnode* cast2(container::NodeView* node) {
+            return static_cast<kmnode*>(node);
+        }
+
+        kmnode* get_child(const child_t i) {
+            return cast2(container::NAryNode::get_child(i));
+        }
+
+        const data_t* get_center() const { return &center[0]; }
+        const data_t get_radius() const { return radius; }
+
+        data_t distance(data_t* sample, const sample_id_t idx) override {
+            data_t* member = get_member(idx);
+            data_t dist = distance::euclidean(sample, member,
+                    ioer->shape().second);
+            put_member(member);
+            return dist;
+        }
+
+        data_t distance(container::SampleVector* s1,
+                const sample_id_t idx) override {
+            return distance(s1->dense(), idx);
+        }
+
+        data_t center_dist(data_t* sample) {
+            return distance::euclidean(sample, &center[0], center.size());
+        }
+
+        // Lower bound on the distance from `sample` to any member
+        data_t min_dist(data_t* sample) {
+            return std::max<data_t>(0, center_dist(sample) - radius);
+        }
+
+        // The root starts with every sample
+        void prep() override {
+            if (data_index.empty()) {
+                data_index.reserve(ioer->shape().first);
+                for (sample_id_t idx = 0; idx < ioer->shape().first; idx++)
+                    data_index.append(idx, 0);
+            }
+        }
+
+        // Centroid & radius of the members
+        void run() override {
+            const size_t nfeatures = ioer->shape().second;
+            const size_t nmembers = data_index.size();
+            center.assign(nfeatures, 0);
+            if (!nmembers)
+                return;
+
+            std::vector<double> sum(nfeatures, 0);
+            double* psum = &sum[0];
+#pragma omp parallel for if (depth < 2) reduction(+:psum[:nfeatures])
+            for (size_t i = 0; i < nmembers; i++) {
+                data_t* member = get_member(data_index[i].get_index());
+                for (size_t j = 0; j < nfeatures; j++)
+                    psum[j] += member[j];
+                put_member(member);
+            }
+
+            for (size_t j = 0; j < nfeatures; j++)
+                center[j] = sum[j] / nmembers;
+
+            data_t max_dist = 0;
+#pragma omp parallel for if (depth < 2) reduction(max:max_dist)
+            for (size_t i = 0; i < nmembers; i++) {
+                data_t* member = get_member(data_index[i].get_index());
+                data_t dist = distance::euclidean(&center[0], member,
+                        nfeatures);
+                put_member(member);
+                if (dist > max_dist)
+                    max_dist = dist;
+            }
+            radius = max_dist;
+        }
+
+        // Lloyd's with k = fanout seeded by evenly spaced members. Empty
+        //  clusters are dropped so a node may end up with fewer children.
+        void spawn() override {
+            const size_t nfeatures = ioer->shape().second;
+            const size_t nmembers = data_index.size();
+            assert(nmembers > fanout);
+
+            // Members are read once & reused across iterations
+            std::vector<data_t> members(nmembers*nfeatures);
+            for (size_t i = 0; i < nmembers; i++) {
+                data_t* member = get_member(data_index[i].get_index());
+                std::copy(member, member+nfeatures, &members[i*nfeatures]);
+                put_member(member);
+            }
+
+            std::vector<data_t> centers(fanout*nfeatures);
+            for (unsigned c = 0; c < fanout; c++) {
+                size_t seed = c*nmembers / fanout;
+                std::copy(&members[seed*nfeatures],
+                        &members[(seed+1)*nfeatures], &centers[c*nfeatures]);
+            }
+
+            std::vector<unsigned> assignment(nmembers, fanout);
+            std::vector<size_t> counts(fanout);
+            for (unsigned iter = 0; iter < MAX_ITERS; iter++) {
+                bool changed = false;
+#pragma omp parallel for if (depth < 2) reduction(||:changed)
+                for (size_t i = 0; i < nmembers; i++) {
+                    unsigned best = 0;
+                    data_t best_dist = std::numeric_limits<data_t>::max();
+                    for (unsigned c = 0; c < fanout; c++) {
+                        data_t dist = distance::euclidean(
+                                &members[i*nfeatures], &centers[c*nfeatures],
+                                nfeatures);
+                        if (dist < best_dist) {
+                            best_dist = dist;
+                            best = c;
+                        }
+                    }
+                    if (best != assignment[i]) {
+                        assignment[i] = best;
+                        changed = true;
+                    }
+                }
+
+                if (!changed)
+                    break;
+
+                // Empty clusters keep their old center
+                std::fill(counts.begin(), counts.end(), 0);
+                std::vector<double> sums(fanout*nfeatures, 0);
+                for (size_t i = 0; i < nmembers; i++) {
+                    counts[assignment[i]]++;
+                    for (size_t j = 0; j < nfeatures; j++)
+                        sums[assignment[i]*nfeatures+j] +=
+                            members[i*nfeatures+j];
+                }
+
+                for (unsigned c = 0; c < fanout; c++)
+                    if (counts[c])
+                        for (size_t j = 0; j < nfeatures; j++)
+                            centers[c*nfeatures+j] =
+                                sums[c*nfeatures+j] / counts[c];
+            }
+
+            std::vector<std::vector<sample_id_t> > clusters(fanout);
+            for (size_t i = 0; i < nmembers; i++)
+                clusters[assignment[i]].push_back(data_index[i].get_index());
+
+            unsigned nclusters = 0;
+            for (auto& cluster : clusters)
+                nclusters += !cluster.empty();
+
+            // Duplicates can't be separated. Stay a leaf
+            if (nclusters < 2)
+                return;
+
+            for (auto& cluster : clusters) {
+                if (cluster.empty())
+                    continue;
+                kmnode* child = new kmnode(fanout);
+                add_child(child);
+                child->set_ph_data_index(&cluster[0], cluster.size());
+            }
+        }
+
+        void print() override {
+            printf("Radius: %.2f, Depth: %lu, Children: %u\n", radius,
+                    (size_t)get_depth(), get_nchild());
+            printf("Membership: %s\n",  data_index.to_string().c_str());
+        }
+};
+
+// kNN over a k-means tree. Exact with triangle inequality pruning or
+//  approximate by scanning only the leaf with the nearest centers
+class KMeansTreeProgram: public NAryTreeProgram {
+    private:
+        bool approx;
+        std::atomic<size_t> ndist; // Member distances computed by queries
+
+        void scan_leaf(kmnode* node, data_t* sample,
+                container::ProximityQuery* query) {
+            container::QueryStats& stats = query->get_stats();
+            stats[container::QueryStats::LEAVES]++;
+            if (pager) // Fault the leaf in
+                stats[container::QueryStats::IO_BYTES] += pager->pin(node);
+            for (IndexVal<data_t> iv : node->get_data_index()) {
+                if (is_deleted(iv.get_index()))
+                    continue;
+                query->eval(iv.get_index(),
+                        node->distance(sample, iv.get_index()), tree_id);
+                ndist++;
+                stats[container::QueryStats::DISTANCES]++;
+                stats[container::QueryStats::IO_BYTES] +=
+                    nfeatures*sizeof(data_t);
+            }
+            if (pager) pager->unpin(node);
+        }
+
+    public:
+        KMeansTreeProgram(Params& params, const tree_t tree_id,
+                const int numa_id=0) :
+            NAryTreeProgram(params, tree_id, numa_id), approx(false),
+            ndist(0) {
+        }
+
+        void set_approx(const bool approx) {
+            this->approx = approx;
+        }
+
+        const size_t get_ndist() const { return ndist; }
+
+        void find_neighbors(container::Query* q) override {
+            container::ProximityQuery* query =
+                container::ProximityQuery::raw_cast(q);
+            data_t* sample = query->get_qsample()->dense();
+            NNVector* nnv = query->getNN()[tree_id];
+            const size_t k = query->get_k();
+            container::QueryStats& stats = query->get_stats();
+
+            container::ReadGuard guard(scheduler);
+
+            kmnode* node = kmnode::cast2(get_root());
+            if (approx) {
+                while (node->has_child()) {
+                    stats[container::QueryStats::NODES]++;
+                    stats[container::QueryStats::PRUNED] +=
+                        node->get_nchild() - 1;
+                    kmnode* nearest = node->get_child(0);
+                    data_t nearest_dist = nearest->center_dist(sample);
+                    for (child_t i = 1; i < node->get_nchild(); i++) {
+                        data_t dist = node->get_child(i)->center_dist(sample);
+                        if (dist < nearest_dist) {
+                            nearest_dist = dist;
+                            nearest = node->get_child(i);
+                        }
+                    }
+                    node = nearest;
+                }
+                scan_leaf(node, sample, query);
+                return;
+            }
+
+            // Each entry holds a lower bound on the distance to its members
+            container::Stack<std::pair<kmnode*, data_t> > visited;
+            visited.push(std::make_pair(node, node->min_dist(sample)));
+
+            std::vector<std::pair<kmnode*, data_t> > children;
+            while (!visited.empty()) {
+                std::pair<kmnode*, data_t> top = visited.pop();
+                node = top.first;
+
+                // Triangle inequality: No member can beat the k-th neighbor
+                if (nnv->size() == k && top.second >= (*nnv)[k-1].get_val()) {
+                    stats[container::QueryStats::PRUNED]++;
+                    continue;
+                }
+
+                if (!node->has_child()) {
+                    scan_leaf(node, sample, query);
+                    continue;
+                }
+                stats[container::QueryStats::NODES]++;
+
+                // Nearest child is visited first
+                children.clear();
+                for (child_t i = 0; i < node->get_nchild(); i++)
+                    children.push_back(std::make_pair(node->get_child(i),
+                                node->get_child(i)->min_dist(sample)));
+                std::sort(children.begin(), children.end(),
+                        [] (const std::pair<kmnode*, data_t>& a,
+                            const std::pair<kmnode*, data_t>& b) {
+                        return a.second > b.second; });
+                for (auto& child : children)
+                    visited.push(child);
+            }
+        }
+};
+
+int main(int argc, char* argv[]) {
+    // Positional args
+    std::string datafn;
+    size_t nsamples;
+    size_t nfeatures;
+
+    // Optional args
+    tree_t ntree;
+    unsigned nthread;
+    depth_t max_depth;
+    mat_orient_t mo = mat_orient_t::COL;
+    unsigned fanout;
+    size_t nquery;
+    short k;
+    bool approx = false;
+
+    try {
+        cxxopts::Options options(argv[0],
+                "kmeanstree data-file nsamples nfeatures [alg-options]\n");
+        options.positional_help("[optional args]");
+
+        options.add_options()
+            ("f,datafn", "Path to data-file on disk",
+             cxxopts::value<std::string>(datafn), "FILE")
+            ("n,nsamples", "Number of samples in the dataset (rows)",
+             cxxopts::value<std::string>())
+            ("m,nfeatures", "Number of features in the dataset (columns)",
+             cxxopts::value<std::string>())
+            ("t,ntree", "Number of trees in the forest",
+             cxxopts::value<tree_t>(ntree)->default_value("1"))
+            ("T,num_thread", "The number of threads to run",
+             cxxopts::value<unsigned>(nthread)->default_value("1"))
+            ("d,depth", "Max tree depth",
+             cxxopts::value<depth_t>(max_depth)->default_value("5"))
+            ("F,fanout", "Number of clusters per node",
+             cxxopts::value<unsigned>(fanout)->default_value("4"))
+            ("o,orientation", "data orientataion `row` or `col`)",
+             cxxopts::value<std::string>()->default_value("col"))
+            ("A,approx", "Only scan the leaf with the nearest centers",
+             cxxopts::value<bool>(approx))
+            ("q,nquery", "Validate this many samples as queries",
+             cxxopts::value<size_t>(nquery)->default_value("0"))
+            ("k,nneighbors", "Number of neighbors per query",
+             cxxopts::value<short>(k)->default_value("10"))
+            ("h,help", "Print help");
+
+        options.parse_positional({"datafn", "nsamples", "nfeatures"});
+        int nargs = argc;
+        options.parse(argc, argv);
+
+        if (options.count("help") || (nargs == 1)) {
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        if (nargs < 4) {
+            std::cout << "[ERROR]: Not enough default arguments\n";
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        nsamples = atol(options["nsamples"].as<std::string>().c_str());
+        nfeatures = atol(options["nfeatures"].as<std::string>().c_str());
+        mo = options["orientation"].as<std::string>() == "col" ? COL : ROW;
+
+        if (fanout < 2)
+            throw parameter_exception("fanout must be at least 2");
+
+    } catch (const cxxopts::OptionException& e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    Params params(nsamples, nfeatures, datafn,
+            io_t::MEM, ntree, nthread, mo, fanout, max_depth, file_t::BIN);
+    params.print();
+
+    ComputeEngine<KMeansTreeProgram>::ptr engine =
+        ComputeEngine<KMeansTreeProgram>::create(params);
+
+    for (auto tree : engine->get_forest()) {
+        tree->set_root(new kmnode(fanout));
+        tree->set_approx(approx);
+    }
+
+    utils::time timer;
+    timer.tic();
+    engine->train();
+    std::cout << "Algorithmic time " << params.nthread << " threads: "
+        <<  timer.toc() << " sec\n";
+
+    if (!nquery)
+        return EXIT_SUCCESS;
+    nquery = std::min(nquery, nsamples);
+
+    // Compare against a linear scan
+    io::IO* ioer = engine->get_tree(0)->get_ioer();
+    std::vector<data_t> data(nsamples*nfeatures);
+    for (size_t i = 0; i < nsamples; i++) {
+        data_t* row = ioer->get_row(i);
+        std::copy(row, row+nfeatures, &data[i*nfeatures]);
+        if (ioer->get_orientation() != ROW)
+            delete [] row;
+    }
+
+    size_t nfound = 0, nexpected = 0;
+    timer.tic();
+    for (size_t qid = 0; qid < nquery; qid++) {
+        container::DenseVector qsample(&data[qid*nfeatures], nfeatures);
+        container::ProximityQuery query(&qsample, k, ntree);
+        engine->query(&query);
+
+        std::vector<data_t> dists;
+        for (size_t i = 0; i < nsamples; i++)
+            dists.push_back(distance::euclidean(&data[qid*nfeatures],
+                        &data[i*nfeatures], nfeatures));
+        std::sort(dists.begin(), dists.end());
+
+        // Recall by distance so ties don't count against the tree
+        for (auto nnv : query.getNN()) {
+            size_t kk = std::min<size_t>(k, nsamples);
+            for (size_t i = 0; i < nnv->size(); i++)
+                nfound += (*nnv)[i].get_val() <= dists[kk-1];
+            nexpected += kk;
+        }
+    }
+
+    size_t ndist = 0;
+    for (auto tree : engine->get_forest())
+        ndist += tree->get_ndist();
+
+    std::cout << "Recall " << (double)nfound / nexpected << " over " <<
+        nquery << " queries in " << timer.toc() <<
+        " sec. Distances per query per tree: " <<
+        (double)ndist / (nquery*ntree) << " of " << nsamples << std::endl;
+
+    return approx || nfound == nexpected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
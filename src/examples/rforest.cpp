@@ -0,0 +1,204 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+
+#include "../common/monya.hpp"
+#include "../utils/time.hpp"
+#include "../io/IO.hpp"
+#include "../common/cxxopts/cxxopts.hpp"
+#include "rforest.hpp"
+
+using namespace monya;
+
+int main(int argc, char* argv[]) {
+    // Positional args
+    std::string datafn;
+    size_t nsamples;
+    size_t nfeatures;
+
+    // Optional args
+    tree_t ntree;
+    unsigned nthread;
+    depth_t max_depth;
+    mat_orient_t mo = mat_orient_t::COL;
+    constexpr unsigned FANOUT = 2;
+    std::string labelfn;
+    size_t nholdout;
+    unsigned nbins;
+    dtcontext ctx;
+
+    try {
+        cxxopts::Options options(argv[0],
+                "rforest data-file nsamples nfeatures -l label-file "
+                "[alg-options]\n");
+        options.positional_help("[optional args]");
+
+        options.add_options()
+            ("f,datafn", "Path to data-file on disk",
+             cxxopts::value<std::string>(datafn), "FILE")
+            ("n,nsamples", "Number of samples in the dataset (rows)",
+             cxxopts::value<std::string>())
+            ("m,nfeatures", "Number of features in the dataset (columns)",
+             cxxopts::value<std::string>())
+            ("l,labelfn", "Binary file with one data_t label per sample",
+             cxxopts::value<std::string>(labelfn), "FILE")
+            ("c,nclass", "Number of classes. 0 for regression",
+             cxxopts::value<unsigned>(ctx.nclass)->default_value("2"))
+            ("C,criterion", "`gini` or `entropy`. Regression uses variance",
+             cxxopts::value<std::string>()->default_value("gini"))
+            ("t,ntree", "Number of trees in the forest",
+             cxxopts::value<tree_t>(ntree)->default_value("1"))
+            ("T,num_thread", "The number of threads to run",
+             cxxopts::value<unsigned>(nthread)->default_value("1"))
+            ("d,depth", "Max tree depth",
+             cxxopts::value<depth_t>(max_depth)->default_value("10"))
+            ("o,orientation", "data orientataion `row` or `col`)",
+             cxxopts::value<std::string>()->default_value("col"))
+            ("F,mtry", "Features tried per node. Defaults to sqrt(m) "
+             "(m/3 for regression)",
+             cxxopts::value<unsigned>(ctx.mtry)->default_value("0"))
+            ("B,nbins", "Histogram bins per feature. At most 256",
+             cxxopts::value<unsigned>(nbins)->default_value("64"))
+            ("b,nobootstrap", "Train every tree on all training samples",
+             cxxopts::value<bool>())
+            ("H,nholdout", "Hold out the last H samples for evaluation",
+             cxxopts::value<size_t>(nholdout)->default_value("0"))
+            ("h,help", "Print help");
+
+        options.parse_positional({"datafn", "nsamples", "nfeatures"});
+        int nargs = argc;
+        options.parse(argc, argv);
+
+        if (options.count("help") || (nargs == 1)) {
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        if (nargs < 4 || labelfn.empty()) {
+            std::cout << "[ERROR]: Not enough default arguments\n";
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        nsamples = atol(options["nsamples"].as<std::string>().c_str());
+        nfeatures = atol(options["nfeatures"].as<std::string>().c_str());
+        mo = options["orientation"].as<std::string>() == "col" ? COL : ROW;
+        ctx.bootstrap = !options.count("nobootstrap");
+
+        std::string criterion = options["criterion"].as<std::string>();
+        if (!ctx.nclass)
+            ctx.criterion = criterion_t::VARIANCE;
+        else if (criterion == "gini")
+            ctx.criterion = criterion_t::GINI;
+        else if (criterion == "entropy")
+            ctx.criterion = criterion_t::ENTROPY;
+        else
+            throw parameter_exception("Unknown criterion " + criterion);
+
+        if (nholdout >= nsamples)
+            throw parameter_exception("Nothing left to train on");
+
+    } catch (const cxxopts::OptionException& e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    ctx.ntrain = nsamples - nholdout;
+    if (!ctx.mtry)
+        ctx.mtry = ctx.nclass ? std::sqrt(nfeatures) : nfeatures / 3;
+    ctx.mtry = std::max(1U, std::min<unsigned>(ctx.mtry, nfeatures));
+
+    ctx.labels.resize(nsamples);
+    std::ifstream labelf(labelfn, std::ios::binary);
+    if (!labelf.read(reinterpret_cast<char*>(&ctx.labels[0]),
+                nsamples*sizeof(data_t)))
+        throw io_exception("Cannot read " + std::to_string(nsamples) +
+                " labels from " + labelfn);
+
+    for (auto label : ctx.labels)
+        if (ctx.nclass && (label < 0 || label >= ctx.nclass ||
+                    label != std::floor(label)))
+            throw parameter_exception("Label " + std::to_string(label) +
+                    " is not a class id");
+
+    Params params(nsamples, nfeatures, datafn,
+            io_t::MEM, ntree, nthread, mo, FANOUT, max_depth, file_t::BIN);
+    params.print();
+
+    ComputeEngine<DecisionTreeProgram>::ptr engine =
+        ComputeEngine<DecisionTreeProgram>::create(params);
+
+    utils::time timer;
+    timer.tic();
+    ctx.bins = io::BinnedMatrix::create(engine->get_tree(0)->get_ioer(),
+            nbins, ctx.ntrain);
+    std::cout << "Binned " << ctx.bins->nbytes() << " bytes in " <<
+        timer.toc() << " sec\n";
+
+    for (auto tree : engine->get_forest()) {
+        container::BinaryNode* root = new dtnode;
+        tree->set_root(root, &ctx);
+    }
+
+    timer.tic();
+    engine->train();
+    std::cout << "Algorithmic time " << params.nthread << " threads: "
+        <<  timer.toc() << " sec\n";
+
+    // Batched inference on the training & held out samples
+    io::IO* ioer = engine->get_tree(0)->get_ioer();
+    std::vector<data_t> data(nsamples*nfeatures);
+    for (size_t i = 0; i < nsamples; i++) {
+        data_t* row = ioer->get_row(i);
+        std::copy(row, row+nfeatures, &data[i*nfeatures]);
+        if (ioer->get_orientation() != ROW)
+            delete [] row;
+    }
+
+    std::vector<data_t> out;
+    timer.tic();
+    engine->predict(&data[0], nsamples, out);
+    std::cout << "Predicted " << nsamples << " samples in " << timer.toc()
+        << " sec\n";
+
+    double train_err = 0, holdout_err = 0;
+    const size_t noutput = engine->get_tree(0)->get_noutput();
+    for (size_t i = 0; i < nsamples; i++) {
+        double err;
+        if (ctx.nclass) {
+            data_t* probs = &out[i*noutput];
+            err = std::max_element(probs, probs+noutput) - probs !=
+                ctx.labels[i];
+        } else {
+            err = (out[i] - ctx.labels[i])*(out[i] - ctx.labels[i]);
+        }
+        (i < ctx.ntrain ? train_err : holdout_err) += err;
+    }
+
+    std::string measure = ctx.nclass ? "Error rate" : "MSE";
+    std::cout << measure << " train: " << train_err / ctx.ntrain;
+    if (nholdout)
+        std::cout << ", holdout: " << holdout_err / nholdout;
+    std::cout << std::endl;
+
+    return EXIT_SUCCESS;
+}
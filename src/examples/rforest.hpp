@@ -0,0 +1,321 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_RFOREST_HPP__
+#define MONYA_RFOREST_HPP__
+
+#include <cmath>
+#include <random>
+
+#include "../common/monya.hpp"
+#include "../io/IO.hpp"
+#include "../io/BinnedMatrix.hpp"
+
+namespace monya {
+enum criterion_t {
+    GINI,
+    ENTROPY,
+    VARIANCE // Regression
+};
+
+// Training state shared by every node of every tree in the forest
+class dtcontext {
+    public:
+        std::vector<data_t> labels; // Class id or target value per sample
+        size_t ntrain; // Samples [0, ntrain) are used for training
+        unsigned nclass; // 0 for regression
+        criterion_t criterion;
+        unsigned mtry; // # of features tried per node
+        bool bootstrap;
+        io::BinnedMatrix::ptr bins; // Quantile bins of the training rows
+
+        // Width of the per bin statistics: class counts or count, sum, sumsq
+        const unsigned width() const {
+            return nclass ? nclass : 3;
+        }
+
+        // Every feature gets the same stride in a node's histogram
+        const size_t hist_size() const {
+            return bins->get_nfeatures()*bins->get_nbins()*width();
+        }
+
+        const double count(const double* stats) const {
+            if (!nclass)
+                return stats[0];
+
+            double n = 0;
+            for (unsigned c = 0; c < nclass; c++)
+                n += stats[c];
+            return n;
+        }
+
+        const double impurity(const double* stats, const double n) const {
+            if (!n)
+                return 0;
+
+            double imp = 0;
+            switch (criterion) {
+                case GINI:
+                    imp = 1;
+                    for (unsigned c = 0; c < nclass; c++)
+                        imp -= (stats[c]/n)*(stats[c]/n);
+                    break;
+                case ENTROPY:
+                    for (unsigned c = 0; c < nclass; c++)
+                        if (stats[c])
+                            imp -= (stats[c]/n)*std::log2(stats[c]/n);
+                    break;
+                case VARIANCE:
+                    imp = stats[2]/n - (stats[1]/n)*(stats[1]/n);
+                    break;
+            }
+            return imp;
+        }
+};
+
+/**
+  * A classification or regression tree node over pre-binned features. Each
+  *  node holds per bin label statistics for every feature. Only the root
+  *  and the smaller child of each split count them from the bin codes, the
+  *  larger child gets its parent's minus its sibling's. run() picks the bin
+  *  edge with the largest impurity decrease among `mtry` random features
+  *  & spawn() splits the members on it. Every node keeps its output so
+  *  leaves can predict.
+  */
+class dtnode: public container::BinaryNode {
+    private:
+        dtcontext* ctx;
+        unsigned seed;
+        unsigned split_dim;
+        io::bin_t split_bin; // Members in bins <= split_bin go left
+        std::vector<data_t> output; // Class probabilities or mean target
+
+        // Build time only
+        std::vector<double> hist; // features x bins x width
+
+        void accumulate(double* stats, const data_t label) {
+            if (ctx->nclass) {
+                stats[static_cast<unsigned>(label)]++;
+            } else {
+                stats[0]++;
+                stats[1] += label;
+                stats[2] += label*label;
+            }
+        }
+
+        // One linear pass over the codes of each feature
+        void count() {
+            const unsigned width = ctx->width();
+            const size_t stride = ctx->bins->get_nbins()*width;
+            hist.assign(ctx->hist_size(), 0);
+
+#pragma omp parallel for if (depth < 3)
+            for (size_t f = 0; f < ctx->bins->get_nfeatures(); f++) {
+                const io::bin_t* codes = ctx->bins->get_col(f);
+                double* fhist = &hist[f*stride];
+                for (auto iv : data_index)
+                    accumulate(&fhist[codes[iv.get_index()]*width],
+                            ctx->labels[iv.get_index()]);
+            }
+        }
+
+    public:
+        dtnode() : ctx(NULL), seed(0), split_dim(0), split_bin(0) {
+            parent = left = right = NULL;
+        }
+
+        static dtnode* cast2(container::BinaryNode* node) {
+            return static_cast<dtnode*>(node);
+        }
+
+        void set_context(dtcontext* ctx, const unsigned seed) {
+            this->ctx = ctx;
+            this->seed = seed;
+        }
+
+        const std::vector<data_t>& get_output() const { return output; }
+
+        void to_em(container::EMNode& em) override {
+            em.comparator = comparator;
+            em.split_dim = split_dim;
+        }
+
+        // The root draws its (bootstrap) sample & counts. Other nodes
+        //  receive their histogram from the parent's spawn()
+        void prep() override {
+            if (!data_index.empty())
+                return;
+
+            std::mt19937 rng(seed);
+            data_index.reserve(ctx->ntrain);
+            std::uniform_int_distribution<sample_id_t>
+                draw(0, ctx->ntrain-1);
+            for (sample_id_t i = 0; i < ctx->ntrain; i++)
+                data_index.append(ctx->bootstrap ? draw(rng) : i, 0);
+            count();
+        }
+
+        // Output & the best split. split_dim is FLAT_LEAF if no split
+        //  decreases the impurity
+        void run() override {
+            const unsigned width = ctx->width();
+            const unsigned nbins = ctx->bins->get_nbins();
+            const size_t nfeatures = ctx->bins->get_nfeatures();
+
+            // Any feature's bins sum to the node's totals
+            std::vector<double> totals(width, 0);
+            for (unsigned b = 0; b < nbins; b++)
+                for (unsigned s = 0; s < width; s++)
+                    totals[s] += hist[b*width+s];
+            const double n = ctx->count(&totals[0]);
+
+            if (ctx->nclass) {
+                output.resize(ctx->nclass);
+                for (unsigned c = 0; c < ctx->nclass; c++)
+                    output[c] = n ? totals[c] / n : 0;
+            } else {
+                output.assign(1, n ? totals[1] / n : 0);
+            }
+
+            // Partial Fisher-Yates for `mtry` distinct features
+            std::mt19937 rng(seed);
+            std::vector<unsigned> features(nfeatures);
+            std::iota(features.begin(), features.end(), 0);
+            for (unsigned i = 0; i < ctx->mtry; i++)
+                std::swap(features[i], features[
+                        std::uniform_int_distribution<unsigned>(
+                            i, nfeatures-1)(rng)]);
+            features.resize(ctx->mtry);
+
+            split_dim = container::FLAT_LEAF;
+            const double parent_imp = ctx->impurity(&totals[0], n);
+            double best_gain = 1e-7*parent_imp; // Ignore rounding noise
+            std::vector<double> lstats(width), rstats(width);
+
+            for (auto f : features) {
+                const double* fhist = &hist[f*nbins*width];
+                std::fill(lstats.begin(), lstats.end(), 0);
+                for (unsigned b = 0; b+1 < ctx->bins->get_nbins(f); b++) {
+                    for (unsigned s = 0; s < width; s++) {
+                        lstats[s] += fhist[b*width+s];
+                        rstats[s] = totals[s] - lstats[s];
+                    }
+
+                    const double nl = ctx->count(&lstats[0]);
+                    const double nr = n - nl;
+                    if (!nl || !nr)
+                        continue;
+
+                    const double gain = parent_imp -
+                        (nl*ctx->impurity(&lstats[0], nl) +
+                         nr*ctx->impurity(&rstats[0], nr)) / n;
+                    if (gain > best_gain) {
+                        best_gain = gain;
+                        split_dim = f;
+                        split_bin = b;
+                    }
+                }
+            }
+
+            if (split_dim != container::FLAT_LEAF)
+                comparator = ctx->bins->get_threshold(split_dim, split_bin);
+        }
+
+        void spawn() override {
+            if (split_dim == container::FLAT_LEAF)
+                return; // Pure or no useful split
+
+            std::vector<sample_id_t> lidxs, ridxs;
+            const io::bin_t* codes = ctx->bins->get_col(split_dim);
+            for (auto iv : data_index) {
+                if (codes[iv.get_index()] <= split_bin)
+                    lidxs.push_back(iv.get_index());
+                else
+                    ridxs.push_back(iv.get_index());
+            }
+
+            left = new dtnode;
+            right = new dtnode;
+            bestow(left);
+            bestow(right);
+            cast2(left)->set_context(ctx, 2*seed+1);
+            cast2(right)->set_context(ctx, 2*seed+2);
+            left->set_ph_data_index(lidxs);
+            right->set_ph_data_index(ridxs);
+
+            // Count the smaller child. The larger one is what's left over
+            dtnode* small = cast2(lidxs.size() < ridxs.size() ? left : right);
+            dtnode* large = cast2(small == left ? right : left);
+            small->count();
+            large->hist.swap(hist);
+            for (size_t i = 0; i < large->hist.size(); i++)
+                large->hist[i] -= small->hist[i];
+        }
+
+        void release() override {
+            container::BinaryNode::release();
+            std::vector<double>().swap(hist);
+        }
+
+        void print() override {
+            printf("Split dim: %u, comparator: %.2f, Depth: %lu\n",
+                    split_dim, comparator, (size_t)get_depth());
+            printf("Membership: %s\n",  data_index.to_string().c_str());
+        }
+};
+
+class DecisionTreeProgram: public BinaryTreeProgram {
+    private:
+        dtcontext* ctx;
+
+    public:
+        DecisionTreeProgram(Params& params, const tree_t tree_id,
+                const int numa_id=0) :
+            BinaryTreeProgram(params, tree_id, numa_id), ctx(NULL) {
+        }
+
+        void set_root(container::BinaryNode*& node, dtcontext* ctx) {
+            this->ctx = ctx;
+            // Distinct seeds so every tree gets its own bootstrap & features
+            dtnode::cast2(node)->set_context(ctx, (tree_id+1)*2654435761u);
+            BinaryTreeProgram::set_root(node);
+        }
+
+        const size_t get_noutput() const override {
+            return ctx->nclass ? ctx->nclass : 1;
+        }
+
+        // Descend the frozen layout for every sample of the batch
+        void predict(data_t* samples, const size_t nsamples,
+                data_t* out) override {
+            assert(frozen);
+            const size_t noutput = get_noutput();
+
+#pragma omp parallel for num_threads (get_nthread())
+            for (size_t i = 0; i < nsamples; i++) {
+                const container::FlatNode& leaf = frozen->get_node(
+                        frozen->descend(&samples[i*nfeatures]));
+                const std::vector<data_t>& output =
+                    dtnode::cast2(frozen->get_leaf(leaf))->get_output();
+                std::copy(output.begin(), output.end(), &out[i*noutput]);
+            }
+        }
+};
+} // End monya
+#endif
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <unordered_set>
+
+#include "../common/monya.hpp"
+#include "../utils/time.hpp"
+#include "../io/IO.hpp"
+#include "../structures/SampleVector.hpp"
+#include "../validate/BruteForcekNN.hpp"
+#include "../common/cxxopts/cxxopts.hpp"
+#include "rptree.hpp"
+
+using namespace monya;
+
+int main(int argc, char* argv[]) {
+    // Positional args
+    std::string datafn;
+    size_t nsamples;
+    size_t nfeatures;
+
+    // Optional args
+    tree_t ntree;
+    unsigned nthread;
+    depth_t max_depth;
+    mat_orient_t mo = mat_orient_t::COL;
+    constexpr unsigned FANOUT = 2;
+    bool approx = false;
+    size_t nquery;
+    short k;
+    bool sparse = false;
+
+    try {
+        cxxopts::Options options(argv[0],
+                "rptree data-file nsamples nfeatures [alg-options]\n");
+        options.positional_help("[optional args]");
+
+        options.add_options()
+            ("f,datafn", "Path to data-file on disk",
+             cxxopts::value<std::string>(datafn), "FILE")
+            ("n,nsamples", "Number of samples in the dataset (rows)",
+             cxxopts::value<std::string>())
+            ("m,nfeatures", "Number of features in the dataset (columns)",
+             cxxopts::value<std::string>())
+            ("t,ntree", "Number of trees in the forest",
+             cxxopts::value<tree_t>(ntree)->default_value("1"))
+            ("T,num_thread", "The number of threads to run",
+             cxxopts::value<unsigned>(nthread)->default_value("1"))
+            ("d,depth", "Max tree depth",
+             cxxopts::value<depth_t>(max_depth)->default_value("10"))
+            ("o,orientation", "data orientataion `row` or `col`)",
+             cxxopts::value<std::string>()->default_value("col"))
+            ("A,approx", "Only search the leaf each query falls into",
+             cxxopts::value<bool>(approx))
+            ("q,nquery", "Measure recall on this many samples as queries",
+             cxxopts::value<size_t>(nquery)->default_value("0"))
+            ("k,nneighbors", "Number of neighbors per query",
+             cxxopts::value<short>(k)->default_value("10"))
+            ("s,sparse", "data-file is COO as written by gensparse.py",
+             cxxopts::value<bool>(sparse))
+            ("h,help", "Print help");
+
+        options.parse_positional({"datafn", "nsamples", "nfeatures"});
+        int nargs = argc;
+        options.parse(argc, argv);
+
+        if (options.count("help") || (nargs == 1)) {
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        if (nargs < 4) {
+            std::cout << "[ERROR]: Not enough default arguments\n";
+            std::cout << options.help() << std::endl;
+            exit(EXIT_SUCCESS);
+        }
+
+        nsamples = atol(options["nsamples"].as<std::string>().c_str());
+        nfeatures = atol(options["nfeatures"].as<std::string>().c_str());
+        mo = options["orientation"].as<std::string>() == "col" ? COL : ROW;
+
+    } catch (const cxxopts::OptionException& e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    Params params(nsamples, nfeatures, datafn,
+            io_t::MEM, ntree, nthread, mo, FANOUT, max_depth, file_t::BIN, 0,
+            metric_t::EUCLIDEAN, sparse ? storage_t::SPARSE : storage_t::F32);
+    params.print();
+
+    ComputeEngine<RPTreeProgram>::ptr engine =
+        ComputeEngine<RPTreeProgram>::create(params);
+
+    for (auto tree : engine->get_forest()) {
+        container::BinaryNode* root = new rpnode;
+        tree->set_root(root);
+        tree->set_approx(approx);
+    }
+
+    utils::time timer;
+    timer.tic();
+    engine->train();
+    std::cout << "Algorithmic time " << params.nthread << " threads: "
+        <<  timer.toc() << " sec\n";
+
+    if (!nquery)
+        return EXIT_SUCCESS;
+
+    // Recall of the forest's k nearest against brute force
+    io::IO* ioer = engine->get_tree(0)->get_ioer();
+    std::vector<data_t> data(nsamples*nfeatures);
+    for (size_t i = 0; i < nsamples; i++) {
+        data_t* row = ioer->get_row(i);
+        std::copy(row, row+nfeatures, &data[i*nfeatures]);
+        if (ioer->get_orientation() != ROW)
+            delete [] row;
+    }
+    nquery = std::min(nquery, nsamples);
+    std::vector<IndexVector> truths;
+    validate::BruteForcekNN bf(&data[0], nsamples, nfeatures, nthread);
+    bf.getNN(&data[0], nquery, k, truths);
+
+    double recall = 0;
+    timer.tic();
+    for (size_t qid = 0; qid < nquery; qid++) {
+        container::DenseVector qsample(&data[qid*nfeatures], nfeatures);
+        container::ProximityQuery query(&qsample, k, ntree);
+        engine->query(&query);
+
+        // Merge the per tree results
+        std::vector<std::pair<data_t, sample_id_t> > found;
+        std::unordered_set<sample_id_t> seen;
+        for (auto nnv : query.getNN())
+            for (size_t i = 0; i < nnv->size(); i++)
+                if (seen.insert((*nnv)[i].get_index()).second)
+                    found.push_back(std::make_pair((*nnv)[i].get_val(),
+                                (*nnv)[i].get_index()));
+        std::sort(found.begin(), found.end());
+
+        IndexVector& truth = truths[qid];
+        std::unordered_set<sample_id_t> truth_ids;
+        for (auto iv : truth)
+            truth_ids.insert(iv.get_index());
+
+        size_t nhit = 0;
+        for (size_t i = 0; i < std::min(found.size(), (size_t)k); i++)
+            nhit += truth_ids.count(found[i].second);
+        recall += (double)nhit / truth.size();
+    }
+    std::cout << "Recall@" << k << " over " << nquery << " queries: " <<
+        recall / nquery << " in " << timer.toc() << " sec\n";
+
+    return EXIT_SUCCESS;
+}
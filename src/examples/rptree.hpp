@@ -0,0 +1,266 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_RPTREE_HPP__
+#define MONYA_RPTREE_HPP__
+
+#include <random>
+
+#include <cblas.h>
+
+#include "../common/monya.hpp"
+#include "../io/IO.hpp"
+#include "../io/SparseIO.hpp"
+#include "../structures/SampleVector.hpp"
+
+namespace monya {
+// # of rows projected per matrix-vector product
+constexpr size_t RP_BLOCK = 4096;
+
+// Splits on the projection of its members onto the direction of its level
+class rpnode: public container::BinaryNode {
+    private:
+        // Projection of every sample for the level being built. Owned by
+        //  the RPTreeProgram
+        const std::vector<data_t>* projections;
+
+    public:
+        using container::BinaryNode::BinaryNode;
+
+        rpnode() : projections(NULL) {
+            parent = left = right = NULL;
+        }
+
+        static rpnode* cast2(container::BinaryNode* node) {
+            return static_cast<rpnode*>(node);
+        }
+
+        void set_projections(const std::vector<data_t>* projections) {
+            this->projections = projections;
+        }
+
+        data_t distance(container::SampleVector* s1,
+                const sample_id_t idx) override {
+            return ioer->euclidean(s1->dense(), idx);
+        }
+
+        // The level's projections were computed by RPTreeProgram::prep_level
+        void prep() override {
+            assert(NULL != projections);
+            const data_t* proj = &(*projections)[0];
+
+            if (data_index.empty()) {
+                data_index.set_indexes(proj, projections->size());
+            } else {
+                for (auto it = data_index.begin(); it != data_index.end(); ++it)
+                    it->set_val(proj[it->get_index()]);
+            }
+        }
+
+        void run() override {
+            if (data_index.empty())
+                return;
+
+            sort_data_index(depth < 3); // Paralleize the sort near the root
+
+            // NOTE: Always <= go left and > right
+            set_comparator(data_index[(data_index.size()-1) / 2].get_val());
+        }
+
+        void spawn() override {
+            left = new rpnode;
+            right = new rpnode;
+
+            bestow(left);
+            bestow(right);
+            cast2(left)->set_projections(projections);
+            cast2(right)->set_projections(projections);
+
+            std::vector<sample_id_t> idxs;
+            data_index.get_indexes(idxs);
+
+            // The left child holds the comparator
+            const size_t nleft = (idxs.size() + 1) / 2;
+            left->set_ph_data_index(&idxs[0], nleft);
+            right->set_ph_data_index(&idxs[nleft], idxs.size()-nleft);
+        }
+
+        void print() override {
+            printf("Comparator: %.2f, Depth: %lu\n", get_comparator(),
+                    (size_t)get_depth());
+            printf("Membership: %s\n",  data_index.to_string().c_str());
+        }
+};
+
+/**
+  * A random projection tree. All nodes at a level split on the same random
+  *  unit direction so the projections of every sample for a level are a
+  *  single (blocked) matrix-vector product over the data.
+  */
+class RPTreeProgram: public BinaryTreeProgram {
+    private:
+        std::default_random_engine generator;
+        std::vector<data_t> directions; // One row of nfeatures per level
+        std::vector<data_t> projections; // Of every sample for a level
+        bool approx; // Only search the leaf the query falls into
+
+        // projections = data * dir
+        void project(const data_t* dir) {
+            projections.assign(nsamples, 0);
+            io::MemoryIO* memio = dynamic_cast<io::MemoryIO*>(ioer);
+            io::SparseIO* spio = dynamic_cast<io::SparseIO*>(ioer);
+
+            if (NULL != spio) { // Only the nonzeros of each row
+#pragma omp parallel for num_threads(get_nthread())
+                for (size_t row = 0; row < nsamples; row++) {
+                    io::sparse_slice<data_t> nz = spio->get_sparse_row(row);
+                    data_t proj = 0;
+                    for (size_t i = 0; i < nz.nnz; i++)
+                        proj += nz.vals[i]*dir[nz.indexes[i]];
+                    projections[row] = proj;
+                }
+                return;
+            }
+
+            if (NULL == memio) { // Stream the columns
+                for (size_t col = 0; col < nfeatures; col++) {
+                    data_t* colv = ioer->get_col(col);
+                    cblas_saxpy(nsamples, dir[col], colv, 1,
+                            &projections[0], 1);
+                    if (ioer->get_orientation() == mat_orient_t::ROW)
+                        delete [] colv;
+                }
+                return;
+            }
+
+            const data_t* data = memio->get_data();
+            const bool row_major = ioer->get_orientation() == mat_orient_t::ROW;
+            const size_t nblocks = (nsamples + RP_BLOCK - 1) / RP_BLOCK;
+
+#pragma omp parallel for num_threads(get_nthread())
+            for (size_t block = 0; block < nblocks; block++) {
+                const size_t start = block*RP_BLOCK;
+                const size_t nrows = std::min(RP_BLOCK, nsamples-start);
+
+                if (row_major)
+                    cblas_sgemv(CblasRowMajor, CblasNoTrans, nrows, nfeatures,
+                            1, &data[start*nfeatures], nfeatures, dir, 1,
+                            0, &projections[start], 1);
+                else
+                    cblas_sgemv(CblasColMajor, CblasNoTrans, nrows, nfeatures,
+                            1, &data[start], nsamples, dir, 1,
+                            0, &projections[start], 1);
+            }
+        }
+
+    public:
+        RPTreeProgram(Params& params, const tree_t tree_id,
+                const int numa_id=0) :
+            BinaryTreeProgram(params, tree_id, numa_id),
+            generator(tree_id), approx(false) {
+        }
+
+        void set_approx(const bool approx) {
+            this->approx = approx;
+        }
+
+        void set_root(container::BinaryNode*& node) {
+            rpnode::cast2(node)->set_projections(&projections);
+            BinaryTreeProgram::set_root(node);
+        }
+
+        // A random unit direction for the level & the projections onto it
+        void prep_level(const depth_t level) override {
+            assert(directions.size() == level*nfeatures);
+
+            std::normal_distribution<data_t> normal;
+            directions.resize((level+1)*nfeatures);
+            data_t* dir = &directions[level*nfeatures];
+            for (size_t i = 0; i < nfeatures; i++)
+                dir[i] = normal(generator);
+            cblas_sscal(nfeatures, 1/cblas_snrm2(nfeatures, dir, 1), dir, 1);
+
+            project(dir);
+        }
+
+        const bool axis_aligned() const override {
+            return false;
+        }
+
+        // Splits aren't axis aligned so FlatBinaryTree can't describe them
+        void freeze() override {
+            std::vector<data_t>().swap(projections); // Build is done
+        }
+
+        void find_neighbors(container::Query* q) override {
+            container::ProximityQuery* query =
+                container::ProximityQuery::raw_cast(q);
+            const data_t* sample = query->get_qsample()->dense();
+
+            // Project the query once per level
+            const size_t nlevels = directions.size() / nfeatures;
+            std::vector<data_t> qproj(nlevels);
+            for (size_t level = 0; level < nlevels; level++)
+                qproj[level] = cblas_sdot(nfeatures, sample, 1,
+                        &directions[level*nfeatures], 1);
+
+            container::QueryStats& stats = query->get_stats();
+            container::ReadGuard guard(scheduler);
+            container::Stack<container::BinaryNode*> visited;
+            visited.push(get_root());
+
+            while (!visited.empty()) {
+                container::BinaryNode* node = visited.pop();
+
+                if (node->has_child()) {
+                    stats[container::QueryStats::NODES]++;
+                    container::BinaryNode* near = node->left;
+                    container::BinaryNode* far = node->right;
+                    if (qproj[node->get_depth()] > node->get_comparator())
+                        std::swap(near, far);
+
+                    if (far && approx) // Only the sample's own leaf is read
+                        stats[container::QueryStats::PRUNED]++;
+                    if (far && !approx) visited.push(far);
+                    if (near) visited.push(near);
+                    continue;
+                }
+
+                stats[container::QueryStats::LEAVES]++;
+                if (pager) // Fault the leaf in
+                    stats[container::QueryStats::IO_BYTES] +=
+                        node->cache(pager);
+                for (IndexVal<data_t> iv : node->get_data_index()) {
+                    if (is_deleted(iv.get_index()))
+                        continue;
+                    query->eval(iv.get_index(), node->distance(
+                                query->get_qsample(), iv.get_index()), tree_id);
+                    stats[container::QueryStats::DISTANCES]++;
+                    stats[container::QueryStats::IO_BYTES] +=
+                        nfeatures*sizeof(data_t);
+                }
+                if (pager) node->uncache(pager);
+
+                if (approx)
+                    break;
+            }
+        }
+};
+} // End monya
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+#include <algorithm>
+
+#include "balltree.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 600;
+constexpr size_t NFEATURES = 6;
+constexpr depth_t DEPTH = 5;
+
+void write_data(const std::string fn, const std::vector<data_t>& data) {
+    FILE* f = fopen(fn.c_str(), "wb");
+    assert(fwrite(&data[0], sizeof(data_t), data.size(), f) == data.size());
+    fclose(f);
+}
+
+ComputeEngine<BallTreeProgram>::ptr build(const std::string fn,
+        const storage_t storage) {
+    Params params(NSAMPLES, NFEATURES, fn, io_t::MEM, 1, 1, ROW, 2, DEPTH,
+            file_t::BIN, 0, metric_t::EUCLIDEAN, storage);
+    ComputeEngine<BallTreeProgram>::ptr engine =
+        ComputeEngine<BallTreeProgram>::create(params);
+    container::BinaryNode* root = new ballnode;
+    engine->get_tree(0)->set_root(root);
+    engine->train();
+    return engine;
+}
+
+// Each leaf's members, sorted, in traversal order
+std::vector<std::vector<sample_id_t> > leaves(BallTreeProgram* tree) {
+    std::vector<container::NodeView*> nodes;
+    tree->get_leaves(nodes);
+    std::vector<std::vector<sample_id_t> > members;
+    for (auto node : nodes) {
+        members.push_back(std::vector<sample_id_t>());
+        node->get_data_index().get_indexes(members.back());
+        std::sort(members.back().begin(), members.back().end());
+    }
+    return members;
+}
+}
+
+// Half precision rows decode into a ring of scratch buffers, which must not
+//  disturb the pivots a split holds while it reads every member
+int main(int argc, char* argv[]) {
+    omp_set_num_threads(1); // Reductions in the same order for both builds
+
+    std::default_random_engine generator(42);
+    std::normal_distribution<data_t> distribution(0, 10);
+    std::vector<data_t> data(NSAMPLES*NFEATURES);
+    for (auto& v : data)
+        v = distribution(generator);
+    write_data("balltree_f16.bin", data);
+
+    ComputeEngine<BallTreeProgram>::ptr half =
+        build("balltree_f16.bin", storage_t::F16);
+    io::IO* ioer = half->get_tree(0)->get_ioer();
+
+    // The same tree as a float32 build over the decoded values
+    std::vector<data_t> decoded(NSAMPLES*NFEATURES);
+    for (sample_id_t i = 0; i < NSAMPLES; i++) {
+        data_t* row = ioer->get_row(i);
+        std::copy(row, row+NFEATURES, &decoded[i*NFEATURES]);
+    }
+    write_data("balltree_f32.bin", decoded);
+    ComputeEngine<BallTreeProgram>::ptr full =
+        build("balltree_f32.bin", storage_t::F32);
+
+    std::vector<std::vector<sample_id_t> > half_leaves =
+        leaves(half->get_tree(0));
+    assert(half_leaves.size() == (1U << DEPTH));
+    assert(half_leaves == leaves(full->get_tree(0)));
+
+    // Exact kNN over the decoded values
+    constexpr short k = 5;
+    for (sample_id_t qid = 0; qid < NSAMPLES; qid += 7) {
+        container::DenseVector qsample(&decoded[qid*NFEATURES], NFEATURES);
+        container::ProximityQuery query(&qsample, k, 1);
+        half->query(&query);
+
+        std::vector<data_t> dists;
+        for (sample_id_t i = 0; i < NSAMPLES; i++)
+            dists.push_back(distance::euclidean(&decoded[qid*NFEATURES],
+                        &decoded[i*NFEATURES], NFEATURES));
+        std::sort(dists.begin(), dists.end());
+
+        NNVector* nnv = query.getNN()[0];
+        assert(nnv->size() == (size_t)k);
+        for (short i = 0; i < k; i++)
+            assert((*nnv)[i].get_val() == dists[i]);
+    }
+
+    // Ball splits can't be persisted as a feature & a comparator
+    bool thrown = false;
+    try {
+        half->save("balltree.forest");
+    } catch (not_implemented_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    remove("balltree_f16.bin");
+    remove("balltree_f32.bin");
+    printf("Ball tree F16 test successful!\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+#include <algorithm>
+
+#include "kdtree.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 4000;
+constexpr size_t NFEATURES = 8;
+constexpr short K = 5;
+constexpr char FN[] = "compaction.bin";
+}
+
+// Deleted samples never come back from queries, before, during or after a
+//  background compaction, which leaves none of them in the leaves
+int main(int argc, char* argv[]) {
+    std::default_random_engine generator(3);
+    std::normal_distribution<data_t> distribution(0, 1);
+    std::vector<data_t> data(NSAMPLES*NFEATURES);
+    for (auto& v : data)
+        v = distribution(generator);
+
+    FILE* f = fopen(FN, "wb");
+    assert(fwrite(&data[0], sizeof(data_t), data.size(), f) == data.size());
+    fclose(f);
+
+    Params params(NSAMPLES, NFEATURES, FN, io_t::MEM, 2, 4, ROW, 2, 6);
+    ComputeEngine<kdTreeProgram>::ptr engine =
+        ComputeEngine<kdTreeProgram>::create(params);
+    for (tree_t tid = 0; tid < params.ntree; tid++) {
+        container::BinaryNode* root = new kdnode;
+        kdnode::cast2(root)->set_split_dim(tid);
+        kdnode::cast2(root)->set_index(tid);
+        engine->get_tree(tid)->set_root(root);
+    }
+    engine->train();
+
+    std::vector<bool> deleted(NSAMPLES, false);
+    for (sample_id_t id = 0; id < NSAMPLES; id += 3) {
+        engine->remove(id);
+        deleted[id] = true;
+    }
+
+    // Exact over the live samples in every tree
+    auto check = [&] (const sample_id_t qid) {
+        container::DenseVector qsample(&data[qid*NFEATURES], NFEATURES);
+        container::ProximityQuery query(&qsample, K, params.ntree);
+        engine->query(&query);
+
+        std::vector<data_t> dists;
+        for (sample_id_t i = 0; i < NSAMPLES; i++)
+            if (!deleted[i])
+                dists.push_back(distance::euclidean(&data[qid*NFEATURES],
+                            &data[i*NFEATURES], NFEATURES));
+        std::sort(dists.begin(), dists.end());
+
+        for (auto nnv : query.getNN()) {
+            if (nnv->size() != (size_t)K)
+                return false;
+            for (short i = 0; i < K; i++)
+                if (deleted[(*nnv)[i].get_index()] ||
+                        (*nnv)[i].get_val() != dists[i])
+                    return false;
+        }
+        return true;
+    };
+
+    std::shared_future<void> compaction = engine->compact_async();
+    size_t nquery = 0;
+    for (sample_id_t qid = 0; compaction.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready || nquery < 100; qid = (qid + 7) %
+            NSAMPLES, nquery++)
+        assert(check(qid));
+    compaction.get();
+
+    std::vector<container::NodeView*> leaves;
+    for (auto tree : engine->get_forest()) {
+        leaves.clear();
+        tree->get_leaves(leaves);
+        size_t nmembers = 0;
+        for (auto leaf : leaves)
+            for (IndexVal<data_t> iv : leaf->get_data_index()) {
+                assert(!deleted[iv.get_index()]);
+                nmembers++;
+            }
+        assert(nmembers == NSAMPLES - engine->nremoved());
+    }
+
+    for (sample_id_t qid = 1; qid < NSAMPLES; qid += 97)
+        assert(check(qid));
+
+    // The kNN graph reads the leaves under the same lock as queries
+    for (sample_id_t id = 1; id < NSAMPLES; id += 5) {
+        engine->remove(id);
+        deleted[id] = true;
+    }
+    compaction = engine->compact_async();
+    container::KNNGraph::ptr graph = engine->knn_graph(K);
+    compaction.get();
+    for (sample_id_t id = 0; id < NSAMPLES; id++)
+        for (unsigned i = 0; i < graph->get_size(id); i++)
+            assert(!deleted[graph->get_ids(id)[i]]);
+
+    remove(FN);
+    printf("Background compaction test successful!\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+#include <algorithm>
+
+#include "rforest.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 600;
+constexpr size_t NFEATURES = 6;
+constexpr unsigned NCLASS = 3;
+constexpr char FN[] = "rforest.bin";
+}
+
+// A forest fits well separated classes: every training sample is predicted
+//  as its own class
+int main(int argc, char* argv[]) {
+    std::default_random_engine generator(5);
+    std::normal_distribution<data_t> distribution(0, 1);
+
+    // Class c is centered at 10*c on every feature
+    dtcontext ctx;
+    ctx.labels.resize(NSAMPLES);
+    std::vector<data_t> data(NSAMPLES*NFEATURES); // Row major
+    for (size_t i = 0; i < NSAMPLES; i++) {
+        ctx.labels[i] = i % NCLASS;
+        for (size_t j = 0; j < NFEATURES; j++)
+            data[i*NFEATURES+j] = 10*ctx.labels[i] + distribution(generator);
+    }
+
+    FILE* f = fopen(FN, "wb");
+    const size_t nwritten = fwrite(&data[0], sizeof(data_t), data.size(), f);
+    fclose(f);
+    assert(nwritten == data.size());
+
+    ctx.ntrain = NSAMPLES;
+    ctx.nclass = NCLASS;
+    ctx.criterion = criterion_t::GINI;
+    ctx.mtry = std::sqrt(NFEATURES);
+    ctx.bootstrap = true;
+
+    Params params(NSAMPLES, NFEATURES, FN, io_t::MEM, 3, 2, ROW, 2, 6);
+    ComputeEngine<DecisionTreeProgram>::ptr engine =
+        ComputeEngine<DecisionTreeProgram>::create(params);
+    ctx.bins = io::BinnedMatrix::create(engine->get_tree(0)->get_ioer(),
+            32, ctx.ntrain);
+    for (auto tree : engine->get_forest()) {
+        container::BinaryNode* root = new dtnode;
+        tree->set_root(root, &ctx);
+    }
+    engine->train();
+
+    std::vector<data_t> out;
+    engine->predict(&data[0], NSAMPLES, out);
+    assert(out.size() == NSAMPLES*NCLASS);
+
+    for (size_t i = 0; i < NSAMPLES; i++) {
+        data_t* probs = &out[i*NCLASS];
+        // The class probabilities of a sample sum to one
+        data_t total = 0;
+        for (unsigned c = 0; c < NCLASS; c++)
+            total += probs[c];
+        assert(std::abs(total - 1) < 1e-5);
+        assert(std::max_element(probs, probs+NCLASS) - probs ==
+                ctx.labels[i]);
+    }
+
+    remove(FN);
+    printf("Random forest predict test successful!\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+#include <algorithm>
+
+#include "rptree.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 1000;
+constexpr size_t NFEATURES = 12;
+constexpr depth_t DEPTH = 5;
+constexpr short K = 6;
+constexpr char FN[] = "rptree.bin";
+}
+
+// Exact search over random projection splits matches a linear scan & the
+//  approximate search reads one leaf per tree
+int main(int argc, char* argv[]) {
+    std::default_random_engine generator(11);
+    std::normal_distribution<data_t> distribution(0, 3);
+    std::vector<data_t> data(NSAMPLES*NFEATURES); // Row major
+    for (auto& v : data)
+        v = distribution(generator);
+
+    // Stored column major so the projections take the blocked sgemv path
+    std::vector<data_t> cols(data.size());
+    for (size_t row = 0; row < NSAMPLES; row++)
+        for (size_t col = 0; col < NFEATURES; col++)
+            cols[col*NSAMPLES+row] = data[row*NFEATURES+col];
+    FILE* f = fopen(FN, "wb");
+    const size_t nwritten = fwrite(&cols[0], sizeof(data_t), cols.size(), f);
+    fclose(f);
+    assert(nwritten == cols.size());
+
+    Params params(NSAMPLES, NFEATURES, FN, io_t::MEM, 2, 2, COL, 2, DEPTH);
+    ComputeEngine<RPTreeProgram>::ptr engine =
+        ComputeEngine<RPTreeProgram>::create(params);
+    for (auto tree : engine->get_forest()) {
+        container::BinaryNode* root = new rpnode;
+        tree->set_root(root);
+    }
+    engine->train();
+
+    // Every sample lands in exactly one leaf of each tree
+    for (auto tree : engine->get_forest()) {
+        std::vector<container::NodeView*> leaves;
+        tree->get_leaves(leaves);
+        assert(leaves.size() == (1U << DEPTH));
+        std::vector<unsigned> seen(NSAMPLES, 0);
+        for (auto leaf : leaves)
+            for (IndexVal<data_t> iv : leaf->get_data_index())
+                seen[iv.get_index()]++;
+        assert(std::count(seen.begin(), seen.end(), 1) == (long)NSAMPLES);
+    }
+
+    for (sample_id_t qid = 0; qid < NSAMPLES; qid += 13) {
+        std::vector<data_t> dists;
+        for (sample_id_t i = 0; i < NSAMPLES; i++)
+            dists.push_back(distance::euclidean(&data[qid*NFEATURES],
+                        &data[i*NFEATURES], NFEATURES));
+        std::sort(dists.begin(), dists.end());
+
+        container::DenseVector qsample(&data[qid*NFEATURES], NFEATURES);
+        container::ProximityQuery query(&qsample, K, params.ntree);
+        engine->query(&query);
+        for (auto nnv : query.getNN()) {
+            assert(nnv->size() == (size_t)K);
+            for (short i = 0; i < K; i++)
+                assert((*nnv)[i].get_val() == dists[i]);
+        }
+    }
+
+    // One leaf per tree, so never closer than the exact answer
+    for (auto tree : engine->get_forest())
+        tree->set_approx(true);
+    for (sample_id_t qid = 0; qid < NSAMPLES; qid += 13) {
+        std::vector<data_t> dists;
+        for (sample_id_t i = 0; i < NSAMPLES; i++)
+            dists.push_back(distance::euclidean(&data[qid*NFEATURES],
+                        &data[i*NFEATURES], NFEATURES));
+        std::sort(dists.begin(), dists.end());
+
+        container::DenseVector qsample(&data[qid*NFEATURES], NFEATURES);
+        container::ProximityQuery query(&qsample, K, params.ntree);
+        engine->query(&query);
+        assert(query.get_stats()[container::QueryStats::LEAVES] ==
+                params.ntree);
+        for (auto nnv : query.getNN()) {
+            assert(nnv->size() == (size_t)K);
+            for (short i = 0; i < K; i++)
+                assert((*nnv)[i].get_val() >= dists[i]);
+        }
+    }
+
+    remove(FN);
+    printf("RP tree test successful!\n");
+    return EXIT_SUCCESS;
+}
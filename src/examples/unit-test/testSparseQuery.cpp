@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+#include <algorithm>
+
+#include "kdtree.hpp"
+#include "balltree.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 500;
+constexpr size_t NFEATURES = 20;
+constexpr short K = 4;
+constexpr char FN[] = "sparse_query.bin";
+
+// The K nearest distances to `qid` by a linear scan
+std::vector<data_t> brute(const std::vector<data_t>& data,
+        const sample_id_t qid) {
+    std::vector<data_t> dists;
+    for (sample_id_t i = 0; i < NSAMPLES; i++)
+        dists.push_back(distance::euclidean(&data[qid*NFEATURES],
+                    &data[i*NFEATURES], NFEATURES));
+    std::sort(dists.begin(), dists.end());
+    dists.resize(K);
+    return dists;
+}
+
+bool matches(container::ProximityQuery& query, std::vector<data_t> expected) {
+    NNVector* nnv = query.getNN()[0];
+    if (nnv->size() != expected.size())
+        return false;
+    for (size_t i = 0; i < expected.size(); i++)
+        if ((*nnv)[i].get_val() != expected[i])
+            return false;
+    return true;
+}
+}
+
+// Queries given as SparseVectors answer like their dense equivalents on
+//  every query path: single, batched & range on a kd tree & a ball tree
+int main(int argc, char* argv[]) {
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<data_t> distribution(-5, 5);
+    std::bernoulli_distribution nonzero(.2);
+    std::vector<data_t> data(NSAMPLES*NFEATURES);
+    for (auto& v : data)
+        v = nonzero(generator) ? distribution(generator) : 0;
+
+    FILE* f = fopen(FN, "wb");
+    assert(fwrite(&data[0], sizeof(data_t), data.size(), f) == data.size());
+    fclose(f);
+
+    container::SparseVector probe(&data[0], NFEATURES);
+    assert(probe.nnz() < NFEATURES);
+    assert(std::equal(data.begin(), data.begin()+NFEATURES, probe.dense()));
+    probe.append(NFEATURES-1, 3); // A change is seen by the next `dense`
+    probe.resize(NFEATURES+1);
+    assert(probe.dense()[NFEATURES-1] == 3 && probe.dense()[NFEATURES] == 0);
+
+    Params params(NSAMPLES, NFEATURES, FN, io_t::MEM, 1, 1, ROW, 2, 4);
+    ComputeEngine<kdTreeProgram>::ptr kd =
+        ComputeEngine<kdTreeProgram>::create(params);
+    container::BinaryNode* kdroot = new kdnode;
+    kdnode::cast2(kdroot)->set_split_dim(0);
+    kdnode::cast2(kdroot)->set_index(0);
+    kd->get_tree(0)->set_root(kdroot);
+    kd->train();
+
+    ComputeEngine<BallTreeProgram>::ptr ball =
+        ComputeEngine<BallTreeProgram>::create(params);
+    container::BinaryNode* ballroot = new ballnode;
+    ball->get_tree(0)->set_root(ballroot);
+    ball->train();
+
+    std::vector<container::SparseVector> qsamples;
+    std::vector<container::ProximityQuery*> batch;
+    for (sample_id_t qid = 0; qid < NSAMPLES; qid += 5)
+        qsamples.emplace_back(&data[qid*NFEATURES], NFEATURES);
+
+    const data_t radius = 4;
+    for (size_t i = 0; i < qsamples.size(); i++) {
+        const sample_id_t qid = i*5;
+        std::vector<data_t> expected = brute(data, qid);
+
+        container::ProximityQuery kdquery(&qsamples[i], K, 1);
+        kd->query(&kdquery);
+        assert(matches(kdquery, expected));
+
+        container::ProximityQuery ballquery(&qsamples[i], K, 1);
+        ball->query(&ballquery);
+        assert(matches(ballquery, expected));
+
+        size_t nrange = 0;
+        for (sample_id_t j = 0; j < NSAMPLES; j++)
+            nrange += distance::euclidean(&data[qid*NFEATURES],
+                    &data[j*NFEATURES], NFEATURES) <= radius;
+        container::RangeQuery kdrange(&qsamples[i], radius, 1);
+        kd->query(&kdrange);
+        assert(kdrange.get_result(0).size() == nrange);
+        container::RangeQuery ballrange(&qsamples[i], radius, 1);
+        ball->query(&ballrange);
+        assert(ballrange.get_result(0).size() == nrange);
+
+        batch.push_back(new container::ProximityQuery(&qsamples[i], K, 1));
+    }
+
+    container::BatchProximityQuery kdbatch(batch);
+    kd->query(&kdbatch);
+    for (size_t i = 0; i < batch.size(); i++) {
+        assert(matches(*batch[i], brute(data, i*5)));
+        // The GEMM screen counts each member once; recomputes are apart
+        container::QueryStats& stats = batch[i]->get_stats();
+        assert(stats[container::QueryStats::DISTANCES] <= NSAMPLES);
+        assert(stats[container::QueryStats::RESCORED] <=
+                stats[container::QueryStats::DISTANCES]);
+        delete batch[i];
+    }
+
+    remove(FN);
+    printf("Sparse query test successful!\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_BAND_IO_HPP__
+#define MONYA_BAND_IO_HPP__
+
+#include <vector>
+#include <algorithm>
+
+#include "IO.hpp"
+
+namespace monya { namespace io {
+
+/**
+  \brief An m x n matrix whose nonzeros lie within `kl` subdiagonals & `ku`
+    superdiagonals, held in LAPACK style band storage of m*(kl+ku+1) (ROW
+    layout) or n*(kl+ku+1) (COL layout) elements. ROW keeps each row's band
+    contiguous: A(i, j) is band[i*bw + kl+j-i]. COL is the BLAS gbmv layout:
+    A(i, j) is band[j*bw + ku+i-j]. The orientation is BAND so, as with any
+    non ROW IO, callers free `get_row` but not `get_col`, which fills a
+    `scratch_row`. See prototype/python/BandMatrix.py
+  */
+template <typename T>
+class BasicBandIO: public BasicIO<T> {
+    private:
+        typedef BasicIO<T> IO;
+        size_t kl, ku;
+        mat_orient_t layout; // ROW or COL band storage
+        std::vector<T> band;
+
+        const size_t bw() const { return kl + ku + 1; }
+
+        // Column range [first, last) of row `i`'s band
+        const size_t row_first(const size_t i) const {
+            return i > kl ? i - kl : 0;
+        }
+        const size_t row_last(const size_t i) const {
+            return std::min(dim.second, i + ku + 1);
+        }
+
+        // Row range [first, last) of column `j`'s band
+        const size_t col_first(const size_t j) const {
+            return j > ku ? j - ku : 0;
+        }
+        const size_t col_last(const size_t j) const {
+            return std::min(dim.first, j + kl + 1);
+        }
+
+        const size_t pos(const size_t i, const size_t j) const {
+            return layout == mat_orient_t::ROW ? i*bw() + kl + j - i :
+                j*bw() + ku + i - j;
+        }
+
+    protected:
+        using IO::fn;
+        using IO::dim;
+
+    public:
+        BasicBandIO(const dimpair dim, const size_t kl, const size_t ku,
+                const mat_orient_t layout=mat_orient_t::ROW) :
+            IO(dim, mat_orient_t::BAND), kl(kl), ku(ku), layout(layout) {
+            if (layout != mat_orient_t::ROW && layout != mat_orient_t::COL)
+                throw parameter_exception("Band layout must be ROW or COL");
+            band.assign((layout == mat_orient_t::ROW ? dim.first :
+                        dim.second)*bw(), 0);
+        }
+
+        // Band of a dense matrix stored in `orient`. Nonzeros outside the
+        //  band are an error
+        BasicBandIO(const T* dense, const dimpair dim,
+                const mat_orient_t orient, const size_t kl, const size_t ku,
+                const mat_orient_t layout=mat_orient_t::ROW) :
+            BasicBandIO(dim, kl, ku, layout) {
+            for (size_t i = 0; i < dim.first; i++)
+                for (size_t j = 0; j < dim.second; j++)
+                    set(i, j, orient == mat_orient_t::ROW ?
+                            dense[i*dim.second+j] : dense[j*dim.first+i]);
+        }
+
+        static BasicBandIO* cast2(typename IO::raw_ptr iop) {
+            return static_cast<BasicBandIO*>(iop);
+        }
+
+        // Band storage is fixed at construction
+        void set_orientation(const mat_orient_t orient) override {
+        }
+
+        const bool in_band(const size_t i, const size_t j) const {
+            return i < dim.first && j < dim.second && j + kl >= i &&
+                i + ku >= j;
+        }
+
+        const T get(const size_t i, const size_t j) const {
+            return in_band(i, j) ? band[pos(i, j)] : 0;
+        }
+
+        void set(const size_t i, const size_t j, const T val) {
+            if (in_band(i, j))
+                band[pos(i, j)] = val;
+            else if (val != 0)
+                throw parameter_exception("Nonzero at (" + std::to_string(i) +
+                        ", " + std::to_string(j) + ") outside the band");
+        }
+
+        const size_t get_kl() const { return kl; }
+        const size_t get_ku() const { return ku; }
+        const mat_orient_t get_layout() const { return layout; }
+        T* get_band() { return &band[0]; }
+
+        // Caller frees
+        T* get_row(const offset_t offset) override {
+            utils::add_io_bytes((row_last(offset) - row_first(offset))*
+                    sizeof(T));
+            T* row = new T[dim.second]();
+            for (size_t j = row_first(offset); j < row_last(offset); j++)
+                row[j] = band[pos(offset, j)];
+            return row;
+        }
+
+        T* get_col(const offset_t offset) override {
+            utils::add_io_bytes((col_last(offset) - col_first(offset))*
+                    sizeof(T));
+            T* col = scratch_row<T>(dim.first);
+            std::fill(col, col + dim.first, 0);
+            for (size_t i = col_first(offset); i < col_last(offset); i++)
+                col[i] = band[pos(i, offset)];
+            return col;
+        }
+
+        // Outside the band only the sample contributes
+        typename IO::dist_t euclidean(const T* sample,
+                const offset_t offset) override {
+            typename elem_traits<T>::accum_t res = 0;
+            for (size_t j = 0; j < dim.second; j++) {
+                typename elem_traits<T>::accum_t tmp = sample[j];
+                if (in_band(offset, j))
+                    tmp -= band[pos(offset, j)];
+                res += tmp*tmp;
+            }
+            return std::sqrt(res);
+        }
+
+        /**
+          \brief y = A*x, or y = A'*x when `trans`, in O(n*bandwidth). The
+            product along the stored layout gathers in parallel; across it
+            each stored band scatters into y
+          */
+        void gbmv(const T* x, T* y, const bool trans=false) const {
+            const size_t nout = trans ? dim.second : dim.first;
+            const bool gather = (layout == mat_orient_t::ROW) != trans;
+
+            if (gather) {
+#pragma omp parallel for
+                for (size_t out = 0; out < nout; out++) {
+                    typename elem_traits<T>::accum_t sum = 0;
+                    // A row of A for ROW, a column of A (row of A') for COL
+                    const size_t first = trans ? col_first(out) :
+                        row_first(out);
+                    const size_t last = trans ? col_last(out) : row_last(out);
+                    for (size_t in = first; in < last; in++)
+                        sum += band[trans ? pos(in, out) : pos(out, in)]*
+                            x[in];
+                    y[out] = sum;
+                }
+            } else {
+                std::fill(y, y + nout, 0);
+                const size_t nin = trans ? dim.first : dim.second;
+                for (size_t in = 0; in < nin; in++) {
+                    const size_t first = trans ? row_first(in) :
+                        col_first(in);
+                    const size_t last = trans ? row_last(in) : col_last(in);
+                    for (size_t out = first; out < last; out++)
+                        y[out] += band[trans ? pos(in, out) : pos(out, in)]*
+                            x[in];
+                }
+            }
+        }
+
+        // The band storage as is
+        void from_file() override {
+            std::ifstream fs(fn, std::ios::binary);
+            if (!fs.read(reinterpret_cast<char*>(&band[0]),
+                        band.size()*sizeof(T)))
+                throw io_exception(std::string("Failure to read band from: '")
+                        + fn + std::string("'\n"));
+        }
+
+        void write() override {
+            std::ofstream fs(fn, std::ios::binary);
+            if (!fs.write(reinterpret_cast<const char*>(&band[0]),
+                        band.size()*sizeof(T)))
+                throw io_exception(std::string("Failure to write band to: '")
+                        + fn + std::string("'\n"));
+        }
+
+        // Bytes held by the band
+        const size_t nbytes() const {
+            return band.size()*sizeof(T);
+        }
+
+        void destroy() override {
+            std::vector<T>().swap(band);
+        }
+};
+
+typedef BasicBandIO<data_t> BandIO;
+
+} } // End namespace monya::io
+#endif
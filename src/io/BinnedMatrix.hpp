@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_BINNED_MATRIX_HPP__
+#define MONYA_BINNED_MATRIX_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "IO.hpp"
+
+namespace monya { namespace io {
+
+typedef uint8_t bin_t;
+constexpr unsigned MAX_BINS = std::numeric_limits<bin_t>::max() + 1;
+
+/**
+  * Features quantized to at most MAX_BINS quantile bins, one byte per value
+  *  stored column major. Tree learners count per bin statistics in one
+  *  linear pass instead of sorting (index, value) pairs, at a quarter of the
+  *  memory of the data_t columns. A value v falls in the first bin b with
+  *  v <= get_edges(f)[b] or in the last bin if it exceeds every edge.
+  */
+class BinnedMatrix {
+    private:
+        size_t nsamples;
+        size_t nfeatures;
+        unsigned nbins; // Upper bound on the bins of any feature
+        std::vector<bin_t> codes; // nsamples x nfeatures column major
+        std::vector<std::vector<data_t> > edges; // Per feature bin edges
+
+        // `nfit` leading samples choose the edges. All samples are coded
+        BinnedMatrix(IO* ioer, const unsigned nbins, size_t nfit) :
+            nsamples(ioer->shape().first), nfeatures(ioer->shape().second),
+            nbins(nbins) {
+            if (nbins < 2 || nbins > MAX_BINS)
+                throw parameter_exception("BinnedMatrix: nbins must be in "
+                        "[2, " + std::to_string(MAX_BINS) + "]");
+            if (!nfit || nfit > nsamples)
+                nfit = nsamples;
+
+            codes.resize(nsamples*nfeatures);
+            edges.resize(nfeatures);
+
+#pragma omp parallel for
+            for (size_t f = 0; f < nfeatures; f++) {
+                data_t* col = ioer->get_col(f);
+
+                std::vector<data_t> sorted(col, col+nfit);
+                std::sort(sorted.begin(), sorted.end());
+                for (unsigned b = 1; b < nbins; b++) {
+                    data_t edge = sorted[b*(nfit-1) / nbins];
+                    if (edge >= sorted.back())
+                        break; // The last bin is open ended
+                    if (edges[f].empty() || edge > edges[f].back())
+                        edges[f].push_back(edge);
+                }
+
+                bin_t* code = &codes[f*nsamples];
+                for (size_t i = 0; i < nsamples; i++)
+                    code[i] = bin(f, col[i]);
+
+                if (ioer->get_orientation() == mat_orient_t::ROW)
+                    delete [] col;
+            }
+        }
+
+    public:
+        typedef std::shared_ptr<BinnedMatrix> ptr;
+
+        static ptr create(IO* ioer, const unsigned nbins=MAX_BINS,
+                const size_t nfit=0) {
+            return ptr(new BinnedMatrix(ioer, nbins, nfit));
+        }
+
+        const size_t get_nsamples() const { return nsamples; }
+        const size_t get_nfeatures() const { return nfeatures; }
+        const unsigned get_nbins() const { return nbins; }
+
+        // # of bins feature `f` actually uses. Fewer for repeated values
+        const unsigned get_nbins(const size_t f) const {
+            return edges[f].size() + 1;
+        }
+
+        const std::vector<data_t>& get_edges(const size_t f) const {
+            return edges[f];
+        }
+
+        // Samples in bins <= b are exactly those with value <= this
+        const data_t get_threshold(const size_t f, const bin_t b) const {
+            assert(b < edges[f].size());
+            return edges[f][b];
+        }
+
+        const bin_t bin(const size_t f, const data_t val) const {
+            return std::lower_bound(edges[f].begin(), edges[f].end(), val) -
+                edges[f].begin();
+        }
+
+        // No copying
+        const bin_t* get_col(const size_t f) const {
+            return &codes[f*nsamples];
+        }
+
+        const size_t nbytes() const {
+            return codes.size()*sizeof(bin_t);
+        }
+};
+
+} } // End namespace monya::io
+#endif
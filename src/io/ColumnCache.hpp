@@ -0,0 +1,97 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_COLUMN_CACHE_HPP__
+#define MONYA_COLUMN_CACHE_HPP__
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+
+#include "IO.hpp"
+
+namespace monya { namespace io {
+
+/**
+  \brief Columns fetched through `IO::get_col` shared by every node & tree of
+    a forest. A column is fetched once & kept while any holder has it. Nodes
+    hold theirs from `prep` until `release` so it lives at least as long as
+    the level that split on it. Concurrent misses on a column wait on the
+    one fetch
+  */
+class ColumnCache {
+    public:
+        typedef std::shared_ptr<const std::vector<data_t> > column_ptr;
+
+    private:
+        struct Column {
+            std::vector<data_t> vals;
+            std::once_flag fetched;
+        };
+
+        std::unordered_map<offset_t, std::weak_ptr<Column> > cols;
+        std::mutex lock;
+        std::atomic<size_t> nfetched, nshared;
+
+    public:
+        ColumnCache() : nfetched(0), nshared(0) {
+        }
+
+        // Column `offset` of `ioer`, read only if no one holds it
+        column_ptr get(IO* ioer, const offset_t offset) {
+            std::shared_ptr<Column> col;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                std::weak_ptr<Column>& entry = cols[offset];
+                col = entry.lock();
+                if (!col) {
+                    col = std::make_shared<Column>();
+                    entry = col;
+                }
+            }
+
+            bool fetcher = false;
+            std::call_once(col->fetched, [&] {
+                    data_t* ret = ioer->get_col(offset);
+                    col->vals.assign(ret, ret + ioer->shape().first);
+                    if (ioer->get_orientation() == mat_orient_t::ROW)
+                        delete [] ret;
+                    fetcher = true;
+                    });
+            fetcher ? nfetched++ : nshared++;
+
+            // Owned by `col` but only the values are visible
+            return column_ptr(col, &col->vals);
+        }
+
+        // Columns read through an IO
+        const size_t get_nfetched() const {
+            return nfetched.load();
+        }
+
+        // Requests served by a column someone else read
+        const size_t get_nshared() const {
+            return nshared.load();
+        }
+};
+
+} } // End namespace monya::io
+#endif
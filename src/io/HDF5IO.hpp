@@ -0,0 +1,319 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_HDF5_IO_HPP__
+#define MONYA_HDF5_IO_HPP__
+
+// Built with USE_HDF5=1 (see Makefile.common)
+#ifdef USE_HDF5
+
+#include <hdf5.h>
+#include <mutex>
+#include <future>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "IO.hpp"
+
+namespace monya { namespace io {
+
+// In memory HDF5 types of the element types. The library converts from
+//  whatever type the dataset is stored as
+inline hid_t h5_type(const float*) { return H5T_NATIVE_FLOAT; }
+inline hid_t h5_type(const double*) { return H5T_NATIVE_DOUBLE; }
+inline hid_t h5_type(const uint8_t*) { return H5T_NATIVE_UINT8; }
+inline hid_t h5_type(const int32_t*) { return H5T_NATIVE_INT32; }
+
+/**
+  \brief A 2D (nsamples x nfeatures) HDF5 dataset, e.g. an ann-benchmarks
+    file. `set_fn` takes FILE or FILE:/dataset (default /train).
+    `from_file` reads it chunk by chunk into memory in the requested
+    orientation, after which this is a MemoryIO. Without it rows & columns
+    are hyperslabs read on demand: the out of core path for
+    `NodeView::prep`. Those fill a `scratch_row` in the orientation's
+    direction & are new memory in the other, so the IO ownership rule holds.
+    `prefetch_col` reads a column in the background & keeps it for the
+    nodes of a level sharing it
+  */
+template <typename T>
+class BasicHDF5IO: public BasicMemoryIO<T> {
+    private:
+        typedef BasicIO<T> IO;
+        typedef BasicMemoryIO<T> MemoryIO;
+        static BasicHDF5IO* singleton;
+
+        // Bytes per read when loading & of chunks cached for column reads
+        static constexpr size_t READ_BYTES = 64 << 20;
+
+        std::string path, dset_name;
+        hid_t file, dset, fspace;
+        dimpair fdim; // Shape on disk
+        std::mutex h5_lock; // The serial library isn't thread safe
+
+        // The last prefetched column
+        offset_t pf_col;
+        std::vector<T> pf_buf;
+        std::shared_future<void> pending;
+        std::mutex pf_lock;
+
+        void open() {
+            H5E_BEGIN_TRY {
+                file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+            } H5E_END_TRY;
+            if (file < 0)
+                throw io_exception(std::string("Failure to open file: '")
+                        + path + std::string("'\n"));
+
+            hid_t dapl = H5Pcreate(H5P_DATASET_ACCESS);
+            H5Pset_chunk_cache(dapl, H5D_CHUNK_CACHE_NSLOTS_DEFAULT,
+                    READ_BYTES, H5D_CHUNK_CACHE_W0_DEFAULT);
+            H5E_BEGIN_TRY {
+                dset = H5Dopen2(file, dset_name.c_str(), dapl);
+            } H5E_END_TRY;
+            H5Pclose(dapl);
+            if (dset < 0) {
+                close();
+                throw io_exception(std::string("No dataset '") + dset_name +
+                        std::string("' in '") + path + std::string("'\n"));
+            }
+
+            fspace = H5Dget_space(dset);
+            hsize_t dims[2];
+            if (H5Sget_simple_extent_ndims(fspace) != 2) {
+                close();
+                throw io_exception(std::string("Dataset '") + dset_name +
+                        std::string("' is not 2D\n"));
+            }
+            H5Sget_simple_extent_dims(fspace, dims, NULL);
+            fdim = dimpair(dims[0], dims[1]);
+        }
+
+        void close() {
+            if (pending.valid())
+                pending.wait();
+            pf_col = std::numeric_limits<offset_t>::max();
+            if (fspace >= 0) H5Sclose(fspace);
+            if (dset >= 0) H5Dclose(dset);
+            if (file >= 0) H5Fclose(file);
+            file = dset = fspace = -1;
+        }
+
+        // The `count` block at `start` into `buf`, row major
+        void read_block(T* buf, const hsize_t* start, const hsize_t* count) {
+            std::lock_guard<std::mutex> lock(h5_lock);
+            hid_t mspace = H5Screate_simple(2, count, NULL);
+            H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, NULL,
+                    count, NULL);
+            herr_t err = H5Dread(dset, h5_type(buf), mspace, fspace,
+                    H5P_DEFAULT, buf);
+            H5Sclose(mspace);
+            if (err < 0)
+                throw io_exception(std::string("Failure to read '") +
+                        dset_name + std::string("' of '") + path +
+                        std::string("'\n"));
+        }
+
+        // Rows per read: about READ_BYTES, whole chunks when chunked
+        const size_t block_rows() {
+            size_t nrow = std::max<size_t>(1,
+                    READ_BYTES / (dim.second*sizeof(T)));
+            hid_t dcpl = H5Dget_create_plist(dset);
+            if (H5Pget_layout(dcpl) == H5D_CHUNKED) {
+                hsize_t chunk[2];
+                H5Pget_chunk(dcpl, 2, chunk);
+                nrow = std::max<size_t>(chunk[0], nrow / chunk[0] * chunk[0]);
+            }
+            H5Pclose(dcpl);
+            return nrow;
+        }
+
+        void check_shape() {
+            if (file < 0)
+                throw io_exception("No HDF5 file set\n");
+            if (dim == dimpair(0,0))
+                dim = fdim;
+            // A prefix of the samples is fine
+            if (dim.first > fdim.first || dim.second != fdim.second)
+                throw io_exception(std::string("Dataset '") + dset_name +
+                        std::string("' is ") + std::to_string(fdim.first) +
+                        std::string(" x ") + std::to_string(fdim.second) +
+                        std::string(" not ") + std::to_string(dim.first) +
+                        std::string(" x ") + std::to_string(dim.second) +
+                        std::string("\n"));
+        }
+
+    protected:
+        using IO::fn;
+        using IO::data;
+        using IO::orientation;
+        using IO::dim;
+
+    public:
+        using IO::shape;
+
+        static BasicHDF5IO* create() {
+            if (!singleton)
+                singleton = new BasicHDF5IO;
+            return singleton;
+        }
+
+        BasicHDF5IO(): MemoryIO(), dset_name("/train"),
+            file(-1), dset(-1), fspace(-1), fdim(0, 0),
+            pf_col(std::numeric_limits<offset_t>::max()) {
+        }
+
+        BasicHDF5IO(const std::string fn, const mat_orient_t orient,
+                const dimpair dim=dimpair(0,0)) : BasicHDF5IO() {
+            set_fn(fn);
+            IO::set_orientation(orient);
+            IO::shape(dim);
+        }
+
+        static BasicHDF5IO* cast2(typename IO::raw_ptr iop) {
+            return static_cast<BasicHDF5IO*>(iop);
+        }
+
+        void set_fn(const std::string fn) override {
+            if (!this->fn.empty())
+                return;
+
+            IO::set_fn(fn);
+            size_t pos = fn.rfind(":/");
+            path = fn.substr(0, pos);
+            if (pos != std::string::npos)
+                dset_name = fn.substr(pos + 1);
+            open();
+        }
+
+        const dimpair& file_shape() const {
+            return fdim;
+        }
+
+        const std::string& dataset() const {
+            return dset_name;
+        }
+
+        void from_file() override {
+            if (NULL != data) return;
+            check_shape();
+            if (orientation != mat_orient_t::ROW &&
+                    orientation != mat_orient_t::COL)
+                throw parameter_exception("HDF5 data loads as ROW or COL");
+
+            data = new T[dim.first*dim.second];
+            const size_t nrow = block_rows();
+            std::vector<T> block;
+            if (orientation == mat_orient_t::COL)
+                block.resize(nrow*dim.second);
+
+            for (size_t row = 0; row < dim.first; row += nrow) {
+                hsize_t start[2] = { row, 0 };
+                hsize_t count[2] = { std::min(nrow, dim.first - row),
+                    dim.second };
+
+                if (orientation == mat_orient_t::ROW) {
+                    read_block(&data[row*dim.second], start, count);
+                } else {
+                    read_block(&block[0], start, count);
+                    // Each column gets a contiguous run of the block's rows
+#pragma omp parallel for
+                    for (size_t col = 0; col < dim.second; col++)
+                        for (size_t i = 0; i < count[0]; i++)
+                            data[col*dim.first + row + i] =
+                                block[i*dim.second + col];
+                }
+            }
+        }
+
+        T* get_col(const offset_t offset) override {
+            if (NULL != data)
+                return MemoryIO::get_col(offset);
+
+            check_shape();
+            utils::add_io_bytes(dim.first*sizeof(T));
+            T* col = orientation == mat_orient_t::ROW ? new T[dim.first] :
+                scratch_row<T>(dim.first);
+            {
+                std::lock_guard<std::mutex> lock(pf_lock);
+                if (offset == pf_col) {
+                    pending.get(); // Rethrows a failed read
+                    std::copy(pf_buf.begin(), pf_buf.end(), col);
+                    return col;
+                }
+            }
+            hsize_t start[2] = { 0, offset };
+            hsize_t count[2] = { dim.first, 1 };
+            read_block(col, start, count);
+            return col;
+        }
+
+        // One column is in flight or kept at a time
+        void prefetch_col(const offset_t offset) override {
+            if (NULL != data)
+                return;
+
+            std::lock_guard<std::mutex> lock(pf_lock);
+            if (offset == pf_col)
+                return;
+            if (pending.valid())
+                pending.wait();
+            check_shape();
+
+            pf_col = offset;
+            pf_buf.resize(dim.first);
+            pending = std::async(std::launch::async, [this, offset] {
+                    hsize_t start[2] = { 0, offset };
+                    hsize_t count[2] = { dim.first, 1 };
+                    read_block(&pf_buf[0], start, count);
+                    }).share();
+        }
+
+        T* get_row(const offset_t offset) override {
+            if (NULL != data)
+                return MemoryIO::get_row(offset);
+
+            check_shape();
+            utils::add_io_bytes(dim.second*sizeof(T));
+            T* row = orientation == mat_orient_t::ROW ?
+                scratch_row<T>(dim.second) : new T[dim.second];
+            hsize_t start[2] = { offset, 0 };
+            hsize_t count[2] = { 1, dim.second };
+            read_block(row, start, count);
+            return row;
+        }
+
+        void destroy() override {
+            if (NULL != data) {
+                delete [] data;
+                data = NULL;
+            }
+            close();
+        }
+};
+
+template <typename T>
+BasicHDF5IO<T>* BasicHDF5IO<T>::singleton = NULL;
+
+typedef BasicHDF5IO<data_t> HDF5IO;
+
+} } // End namespace monya::io
+
+#endif // USE_HDF5
+#endif // MONYA_HDF5_IO_HPP__
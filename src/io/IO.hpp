@@ -25,10 +25,16 @@
 #include <memory>
 #include <cassert>
 #include <utility>
+#include <vector>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "../common/exception.hpp"
 #include "../common/types.hpp"
+#include "../common/distance.hpp"
 #include "../utils/FileUtil.hpp"
+#include "../utils/instrument.hpp"
 #include "vecs_reader.hpp"
 
 namespace monya { namespace io {
@@ -57,18 +63,36 @@ void print_mat(T* matrix, const unsigned rows, const unsigned cols) {
 #endif
 }
 
-class IO {
+// Rows a thread may hold at once from formats that decode rows on demand,
+//  e.g. two rows compared to each other. A caller keeping a row while it
+//  reads an unbounded number of others (a ball tree's pivots) copies it
+constexpr unsigned NROW_BUF = 4;
+
+// Per thread scratch for such rows, valid until the NROW_BUF-th next call
+template <typename T>
+T* scratch_row(const size_t nelem) {
+    static thread_local std::vector<T> rows[NROW_BUF];
+    static thread_local unsigned next = 0;
+    std::vector<T>& row = rows[next++ % NROW_BUF];
+    row.resize(nelem);
+    return &row[0];
+}
+
+// Rows & columns of `T` from some storage. Distances are elem_traits<T>::dist_t
+template <typename T>
+class BasicIO {
     protected:
         std::string fn;
         size_t dtype_size;
-        data_t* data;
+        T* data;
         mat_orient_t orientation;
         dimpair dim;
 
     public:
-        typedef IO* raw_ptr;
+        typedef BasicIO* raw_ptr;
+        typedef typename elem_traits<T>::dist_t dist_t;
 
-        IO() : fn(""), dtype_size(sizeof(data_t)), data(NULL),
+        BasicIO() : fn(""), dtype_size(sizeof(T)), data(NULL),
                 orientation(INVALID), dim(dimpair(0,0)) {
         }
 
@@ -83,11 +107,11 @@ class IO {
                  dim.first, dim.second);
         }
 
-        IO(const std::string fn): IO() {
+        BasicIO(const std::string fn): BasicIO() {
             this->fn = fn;
         }
 
-        IO(const dimpair dim, mat_orient_t orient): IO() {
+        BasicIO(const dimpair dim, mat_orient_t orient): BasicIO() {
             this->dim = dim;
             this->orientation = orient;
         }
@@ -109,17 +133,17 @@ class IO {
         }
 
         // Read everything in the file
-        virtual void read(data_t* buf) {
+        virtual void read(T* buf) {
             throw not_implemented_exception(__FILE__, __LINE__);
         }
 
         // Write everything in the buffer out
-        virtual void write(const data_t* buf, const size_t nbytes) {
+        virtual void write(const T* buf, const size_t nbytes) {
             throw not_implemented_exception(__FILE__, __LINE__);
         };
 
         // Read `nbytes` at `offset` location in the file to `buf`
-        virtual void read(data_t* buf, const size_t offset,
+        virtual void read(T* buf, const size_t offset,
                 const size_t nbytes) {
             throw not_implemented_exception(__FILE__, __LINE__);
         }
@@ -129,12 +153,12 @@ class IO {
         }
 
         // Write `nbytes` at `offset` location in the file to `buf`
-        virtual void write(const data_t* buf, const size_t offset,
+        virtual void write(const T* buf, const size_t offset,
                 const size_t nbytes) {
             throw not_implemented_exception(__FILE__, __LINE__);
         }
 
-        virtual void append(const data_t* buf, const size_t nbytes) {
+        virtual void append(const T* buf, const size_t nbytes) {
             throw not_implemented_exception(__FILE__, __LINE__);
         }
 
@@ -146,49 +170,83 @@ class IO {
             return this->dim;
         }
 
-        virtual data_t* get_row(const offset_t offset) {
+        virtual T* get_row(const offset_t offset) {
             throw not_implemented_exception(__FILE__, __LINE__);
         }
 
-        virtual data_t* get_col(const offset_t offset) {
+        virtual T* get_col(const offset_t offset) {
+            throw not_implemented_exception(__FILE__, __LINE__);
+        }
+
+        // Euclidean distance from `sample` to row `offset`. Formats that
+        //  can skip materializing the row override this
+        virtual dist_t euclidean(const T* sample, const offset_t offset) {
+            T* row = get_row(offset);
+            dist_t dist = distance::euclidean(sample, row, dim.second);
+            if (get_orientation() != mat_orient_t::ROW)
+                delete [] row;
+            return dist;
+        }
+
+        // Hint that `get_col(offset)` follows soon. Formats reading from disk
+        //  start loading it without blocking
+        virtual void prefetch_col(const offset_t offset) {
+        }
+
+        // Load the dataset named by `set_fn` into memory
+        virtual void from_file() {
             throw not_implemented_exception(__FILE__, __LINE__);
         }
 
         virtual void destroy() {
             throw abstract_exception("IO::destroy");
         }
+
+        virtual ~BasicIO() {
+        }
 };
 
-// Basically a matrix represented as a vector
-class MemoryIO;
-static MemoryIO* memIOSingleton = NULL;
+typedef BasicIO<data_t> IO;
 
-// Singleton, but not thread safe. Called serially by `TreeProgram`s
-class MemoryIO: public IO {
+// Basically a matrix represented as a vector
+// Singleton per element type, but not thread safe. Called serially by
+//  `TreeProgram`s
+template <typename T>
+class BasicMemoryIO: public BasicIO<T> {
     private:
+        typedef BasicIO<T> IO;
         bool is_data_local;
+        static BasicMemoryIO* singleton;
+
+    protected:
+        using IO::fn;
+        using IO::dtype_size;
+        using IO::data;
+        using IO::orientation;
+        using IO::dim;
 
     public:
-        static MemoryIO* create() {
-            if (!memIOSingleton)
-                memIOSingleton = new MemoryIO;
-            return memIOSingleton;
+        static BasicMemoryIO* create() {
+            if (!singleton)
+                singleton = new BasicMemoryIO;
+            return singleton;
         }
 
-        static MemoryIO* create(data_t* data, dimpair dim,
+        static BasicMemoryIO* create(T* data, dimpair dim,
                 mat_orient_t orient) {
-            if (!memIOSingleton)
-                memIOSingleton = new MemoryIO(data, dim, orient);
-            return memIOSingleton;
+            if (!singleton)
+                singleton = new BasicMemoryIO(data, dim, orient);
+            return singleton;
         }
 
-        MemoryIO(): IO() {
+        BasicMemoryIO(): IO() {
             is_data_local = false;
         }
 
-        MemoryIO(data_t* data, dimpair _dim,
+        BasicMemoryIO(T* data, dimpair _dim,
                 mat_orient_t orient): IO (_dim, orient) {
             this->data = data;
+            is_data_local = false;
         }
 
         void set_fn(const std::string fn) override {
@@ -208,18 +266,24 @@ class MemoryIO: public IO {
             // else do nothing
         }
 
-        void from_file() {
+        void from_file() override {
             if (NULL != data) return;
 
             assert (!this->fn.empty());
             if (NULL == data)
-                data = new data_t[dim.first*dim.second];
+                data = new T[dim.first*dim.second];
 
             // TODO: Use an enum for filetype
-            if (utils::get_file_ext(fn) == "fvecs") {
-                vecs_reader* vr = new fvecs_reader(fn, dim.first,
-                        dim.second);
-                vr->read(data);
+            const std::string ext = utils::get_file_ext(fn);
+            if (ext == "fvecs" || ext == "ivecs" || ext == "bvecs") {
+                vecs_reader* vr;
+                if (ext == "fvecs")
+                    vr = new fvecs_reader(fn, dim.first, dim.second);
+                else if (ext == "ivecs")
+                    vr = new ivecs_reader(fn, dim.first, dim.second);
+                else
+                    vr = new bvecs_reader(fn, dim.first, dim.second);
+                vr->read_as(data);
                 delete vr;
             } else {
                 std::fstream fs;
@@ -238,17 +302,17 @@ class MemoryIO: public IO {
 #endif
         }
 
-        void read(data_t* buf, const offset_t offset,
+        void read(T* buf, const offset_t offset,
                 const size_t nbytes=0) override {
             buf = &data[offset];
         }
 
-        void set_data(data_t* data) {
+        void set_data(T* data) {
             if (this->data) return;
             this->data = data;
         }
 
-        data_t* get_data() {
+        T* get_data() {
             return this->data;
         }
 
@@ -263,7 +327,7 @@ class MemoryIO: public IO {
 
         // TODO: Slow
         void transpose() override {
-            data_t* tmp = new data_t[dim.first*dim.second];
+            T* tmp = new T[dim.first*dim.second];
 
             if (orientation == mat_orient_t::ROW) {
                 for (size_t row = 0; row < dim.first; row++) {
@@ -283,13 +347,13 @@ class MemoryIO: public IO {
             std::swap(dim.first, dim.second);
         }
 
-        data_t* get_col(const offset_t offset) override {
-
+        T* get_col(const offset_t offset) override {
+            utils::add_io_bytes(dim.first*sizeof(T));
             if (this->orientation == mat_orient_t::COL) {
                 return &data[offset*this->dim.first];
             } else if (this->orientation == mat_orient_t::ROW) {
                 // FIXME: Memory leak if not freed
-                data_t* tmp = new data_t[dim.first];
+                T* tmp = new T[dim.first];
                 for (size_t row = 0; row < dim.first; row++)
                     tmp[row] = data[row*dim.second+offset];
                 return tmp;
@@ -299,12 +363,13 @@ class MemoryIO: public IO {
         }
 
         // No copying
-        data_t* get_row(const offset_t offset) override {
+        T* get_row(const offset_t offset) override {
+            utils::add_io_bytes(dim.second*sizeof(T));
             if (this->orientation == mat_orient_t::ROW) {
                 return &data[offset*this->dim.second];
             } else if (this->orientation == mat_orient_t::COL) {
                 // FIXME: Memory leak if not freed
-                data_t* tmp = new data_t[dim.second];
+                T* tmp = new T[dim.second];
                 for (size_t col = 0; col < dim.second; col++)
                     tmp[col] = data[col*dim.first+offset];
                 return tmp;
@@ -313,8 +378,8 @@ class MemoryIO: public IO {
             }
         }
 
-        static MemoryIO* cast2(IO::raw_ptr iop) {
-            return static_cast<MemoryIO*>(iop);
+        static BasicMemoryIO* cast2(typename IO::raw_ptr iop) {
+            return static_cast<BasicMemoryIO*>(iop);
         }
 
         void destroy() override {
@@ -325,21 +390,39 @@ class MemoryIO: public IO {
         }
 };
 
-class SyncIO: public IO {
+template <typename T>
+BasicMemoryIO<T>* BasicMemoryIO<T>::singleton = NULL;
+
+typedef BasicMemoryIO<data_t> MemoryIO;
+
+template <typename T>
+class BasicSyncIO: public BasicIO<T> {
     private:
+        typedef BasicIO<T> IO;
         std::fstream fs;
+        int fd; // Only for readahead hints
+        offset_t last_prefetch;
+
+    protected:
+        using IO::fn;
+        using IO::dtype_size;
+        using IO::data;
+        using IO::orientation;
+        using IO::dim;
 
     public:
-        SyncIO(): IO() {
+        BasicSyncIO(): IO(), fd(-1),
+            last_prefetch(std::numeric_limits<offset_t>::max()) {
         }
 
-        SyncIO(const std::string fn):
-            IO(fn) {
+        BasicSyncIO(const std::string fn): BasicSyncIO() {
             this->fn = fn;
         }
 
-        SyncIO(const std::string fn, dimpair dim,
-                mat_orient_t orient) : IO (dim, orient) {
+        BasicSyncIO(const std::string fn, dimpair dim,
+                mat_orient_t orient) : BasicSyncIO() {
+            this->dim = dim;
+            this->orientation = orient;
             set_fn(fn);
         }
 
@@ -354,9 +437,23 @@ class SyncIO: public IO {
             if (!fs.is_open())
                 throw io_exception(std::string("Failure to open file: '")
                         + fn + std::string("'\n"));
+            if (fd < 0)
+                fd = ::open(this->fn.c_str(), O_RDONLY);
         }
 
-        void read(data_t* buf) override {
+        // The kernel reads the column into the page cache in the background
+        //  so the coming `get_col` is served from memory. Nodes of a level
+        //  often share a column so repeats are dropped
+        void prefetch_col(const offset_t offset) override {
+            if (fd < 0 || orientation != mat_orient_t::COL ||
+                    offset == last_prefetch)
+                return;
+            last_prefetch = offset;
+            const size_t nbytes = dim.first*dtype_size;
+            posix_fadvise(fd, offset*nbytes, nbytes, POSIX_FADV_WILLNEED);
+        }
+
+        void read(T* buf) override {
             if (!fs.is_open()) {
                 open();
             }
@@ -365,32 +462,33 @@ class SyncIO: public IO {
             fs.read(reinterpret_cast<char*>(buf), size);
         }
 
-        void write(const data_t* buf, const size_t nbytes) override {
+        void write(const T* buf, const size_t nbytes) override {
             fs.write(reinterpret_cast<const char*>(buf), nbytes);
         }
 
         // TODO: Verify NO accidental overrite due to block size
-        void write(const data_t* buf, const size_t offset,
+        void write(const T* buf, const size_t offset,
                 const size_t nbytes) override {
             fs.seekp(offset);
             write(buf, nbytes);
         }
 
-        void append(const data_t* buf, const size_t nelem) {
+        void append(const T* buf, const size_t nelem) {
             fs.write(reinterpret_cast<const char*>(buf),dtype_size*nelem);
         }
 
-        static SyncIO* cast2(IO::raw_ptr iop) {
-            return static_cast<SyncIO*>(iop);
+        static BasicSyncIO* cast2(typename IO::raw_ptr iop) {
+            return static_cast<BasicSyncIO*>(iop);
         }
 
         // No copying
-        data_t* get_col(const offset_t offset) override {
+        T* get_col(const offset_t offset) override {
             assert(fs.is_open());
+            utils::add_io_bytes(dim.first*dtype_size);
             if (this->orientation == mat_orient_t::COL) {
                 fs.seekp(offset*dim.first*dtype_size);
                 if (NULL == data)
-                    data = new data_t[dim.first];
+                    data = new T[dim.first];
 
                 fs.read(reinterpret_cast<char*>(&data[0]),
                         dtype_size*dim.first);
@@ -406,7 +504,7 @@ class SyncIO: public IO {
             } else if (this->orientation == mat_orient_t::ROW) {
                 // FIXME: Memory leak if not freed
                 printf("WARNING: Inefficent method `get_col` for rowwise\n");
-                data_t* tmp = new data_t[dim.first];
+                T* tmp = new T[dim.first];
                 for (size_t row = 0; row < dim.first; row++) {
                     fs.seekp((row*dim.second+offset)*dtype_size);
                     fs.read(reinterpret_cast<char*>(&tmp[row]),
@@ -419,11 +517,12 @@ class SyncIO: public IO {
         }
 
         // No copying
-        data_t* get_row(const offset_t offset) override {
+        T* get_row(const offset_t offset) override {
             assert(fs.is_open());
+            utils::add_io_bytes(dim.second*dtype_size);
 
             if (this->orientation == mat_orient_t::ROW) {
-                data_t* tmp = new data_t[dim.second];
+                T* tmp = new T[dim.second];
                 fs.seekp((offset*dim.second)*dtype_size);
                 fs.read(reinterpret_cast<char*>(tmp), dtype_size*dim.second);
                 return tmp;
@@ -431,7 +530,7 @@ class SyncIO: public IO {
 #if 1
                 // FIXME: Memory leak if not freed
                 printf("WARNING: Inefficent method `get_row` for colwise\n");
-                data_t* tmp = new data_t[dim.second];
+                T* tmp = new T[dim.second];
                 for (size_t col = 0; col < dim.second; col++) {
 
                     fs.seekp(((col*dim.first)+offset)*dtype_size);
@@ -449,10 +548,16 @@ class SyncIO: public IO {
         void destroy() override {
             if (fs.is_open())
                 fs.close();
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
             if (data != NULL)
                 delete [] data;
         }
 };
 
+typedef BasicSyncIO<data_t> SyncIO;
+
 } } // End namespace monya::io
 #endif
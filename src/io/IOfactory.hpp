@@ -21,15 +21,29 @@
 #define MONYA_IO_FACTORY_HPP
 
 #include "IO.hpp"
+#include "QuantizedIO.hpp"
+#include "SparseIO.hpp"
+#include "HDF5IO.hpp"
 #include "../common/types.hpp"
 
 namespace monya {
 class IOfactory {
     public:
-        static io::IO::raw_ptr create(io_t iotype) {
+        static io::IO::raw_ptr create(io_t iotype,
+                const storage_t storage=storage_t::F32,
+                const file_t filetype=file_t::BIN) {
+
+            if (filetype == file_t::HDF5)
+                return create_hdf5(iotype, storage);
 
             switch (iotype) {
                 case MEM:
+                    if (storage == storage_t::F16)
+                        return io::QuantizedIO<uint16_t>::create();
+                    if (storage == storage_t::INT8)
+                        return io::QuantizedIO<uint8_t>::create();
+                    if (storage == storage_t::SPARSE)
+                        return io::SparseIO::create();
                     return io::MemoryIO::create();
                     break;
                 case SEM:
@@ -42,6 +56,27 @@ class IOfactory {
                     throw not_implemented_exception(__FILE__, __LINE__);
             }
         }
+
+    private:
+        // One in memory copy shared by the forest, else a reader per tree
+        static io::IO::raw_ptr create_hdf5(io_t iotype,
+                const storage_t storage) {
+#ifdef USE_HDF5
+            if (storage != storage_t::F32)
+                throw parameter_exception("HDF5 data is only held as f32");
+            switch (iotype) {
+                case MEM:
+                    return io::HDF5IO::create();
+                case SYNC:
+                    return new io::HDF5IO();
+                default:
+                    throw not_implemented_exception(__FILE__, __LINE__);
+            }
+#else
+            throw parameter_exception("HDF5 input needs a build with"
+                    " USE_HDF5=1");
+#endif
+        }
 };
 }
 
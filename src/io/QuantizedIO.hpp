@@ -0,0 +1,157 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_QUANTIZED_IO_HPP__
+#define MONYA_QUANTIZED_IO_HPP__
+
+#include <vector>
+#include <cstdint>
+
+#include "IO.hpp"
+#include "../common/quantize.hpp"
+#include "../common/distance.hpp"
+
+namespace monya { namespace io {
+
+/**
+  \brief An in memory dataset stored row major as `code_t` codes, uint8_t
+    (INT8) or IEEE halves in uint16_t (F16), with a scale & offset per
+    dimension. Leaf scans call `euclidean` which reads the codes directly;
+    `get_row` decodes into a `scratch_row` so callers never free it. Like
+    MemoryIO it is a singleton, but not a thread safe one.
+  */
+template <typename code_t>
+class QuantizedIO: public IO {
+    private:
+        std::vector<code_t> codes;
+        std::vector<data_t> scale;
+        std::vector<data_t> offset;
+        mat_orient_t file_orient; // Of the data being quantized
+        static QuantizedIO* singleton;
+
+        void encode(const data_t* data, const mat_orient_t orient) {
+            const size_t nrow = dim.first, ncol = dim.second;
+            quantize::fit<code_t>(data, nrow, ncol, orient, scale, offset);
+            codes.resize(nrow*ncol);
+
+#pragma omp parallel for
+            for (size_t row = 0; row < nrow; row++)
+                for (size_t col = 0; col < ncol; col++)
+                    quantize::encode(orient == ROW ? data[row*ncol+col] :
+                            data[col*nrow+row], scale[col], offset[col],
+                            codes[row*ncol+col]);
+        }
+
+    public:
+        static QuantizedIO* create() {
+            if (!singleton)
+                singleton = new QuantizedIO;
+            return singleton;
+        }
+
+        QuantizedIO() : IO(), file_orient(INVALID) {
+            this->orientation = mat_orient_t::ROW;
+        }
+
+        // Quantize `data` laid out in `orient`. The caller keeps `data`
+        QuantizedIO(const data_t* data, const dimpair dim,
+                const mat_orient_t orient) : IO(dim, mat_orient_t::ROW),
+        file_orient(orient) {
+            encode(data, orient);
+        }
+
+        static QuantizedIO* cast2(IO::raw_ptr iop) {
+            return static_cast<QuantizedIO*>(iop);
+        }
+
+        void set_fn(const std::string fn) override {
+            if (this->fn.empty())
+                IO::set_fn(fn);
+        }
+
+        // The orientation of the file. Codes are always row major
+        void set_orientation(const mat_orient_t orient) override {
+            if (file_orient == INVALID)
+                file_orient = orient;
+        }
+
+        void shape(const dimpair dim) override {
+            if (this->dim == dimpair(0,0))
+                IO::shape(dim);
+        }
+
+        const dimpair& shape() override {
+            return IO::shape();
+        }
+
+        // Read the full precision file through a transient MemoryIO
+        void from_file() override {
+            if (!codes.empty()) return;
+
+            MemoryIO full;
+            full.set_fn(fn);
+            full.set_orientation(file_orient);
+            full.shape(dim);
+            full.from_file();
+            encode(full.get_data(), file_orient);
+            full.destroy();
+        }
+
+        data_t* get_row(const offset_t offset) override {
+            utils::add_io_bytes(dim.second*sizeof(code_t));
+            data_t* row = scratch_row<data_t>(dim.second);
+            const code_t* code = &codes[offset*dim.second];
+            for (size_t col = 0; col < dim.second; col++)
+                row[col] = quantize::decode(code[col], scale[col],
+                        this->offset[col]);
+            return row;
+        }
+
+        // Caller frees
+        data_t* get_col(const offset_t offset) override {
+            utils::add_io_bytes(dim.first*sizeof(code_t));
+            data_t* col = new data_t[dim.first];
+            for (size_t row = 0; row < dim.first; row++)
+                col[row] = quantize::decode(codes[row*dim.second+offset],
+                        scale[offset], this->offset[offset]);
+            return col;
+        }
+
+        data_t euclidean(const data_t* sample,
+                const offset_t offset) override {
+            utils::add_io_bytes(dim.second*sizeof(code_t));
+            return distance::euclidean(sample, &codes[offset*dim.second],
+                    &scale[0], &this->offset[0], dim.second);
+        }
+
+        // Bytes held by the codes
+        const size_t nbytes() const {
+            return codes.size()*sizeof(code_t);
+        }
+
+        void destroy() override {
+            std::vector<code_t>().swap(codes);
+        }
+};
+
+template <typename code_t>
+QuantizedIO<code_t>* QuantizedIO<code_t>::singleton = NULL;
+
+} } // End namespace monya::io
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_SPARSE_IO_HPP__
+#define MONYA_SPARSE_IO_HPP__
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "IO.hpp"
+#include "../common/distance.hpp"
+
+namespace monya { namespace io {
+
+// The nonzeros of one row (indexes are dimensions) or one column (indexes
+//  are sample ids), in ascending index order
+template <typename T>
+struct sparse_slice {
+    const unsigned* indexes;
+    const T* vals;
+    size_t nnz;
+
+    sparse_slice(const unsigned* indexes, const T* vals, const size_t nnz) :
+        indexes(indexes), vals(vals), nnz(nnz) { }
+};
+
+/**
+  \brief An in memory sparse matrix held as both CSR & CSC so rows & columns
+    are each a contiguous run of nonzeros. `get_sparse_row`/`get_sparse_col`
+    & `euclidean` never densify. `get_row` fills a `scratch_row` & `get_col`
+    a new column the caller frees, as for any ROW ordered IO. A singleton
+    per element type, but not a thread safe one.
+  */
+template <typename T>
+class BasicSparseIO: public BasicIO<T> {
+    private:
+        typedef BasicIO<T> IO;
+        std::vector<size_t> row_ptr; // nrow+1 offsets into the CSR arrays
+        std::vector<feature_id_t> col_idx;
+        std::vector<T> row_vals;
+        std::vector<size_t> col_ptr; // ncol+1 offsets into the CSC arrays
+        std::vector<sample_id_t> row_idx;
+        std::vector<T> col_vals;
+        static BasicSparseIO* singleton;
+
+    protected:
+        using IO::fn;
+        using IO::dim;
+
+        // Sort (row, col, val) triplets into CSR then transpose into CSC.
+        //  Duplicate entries are summed
+        void build(const std::vector<sample_id_t>& rows,
+                const std::vector<feature_id_t>& cols,
+                const std::vector<T>& vals) {
+            const size_t nrow = dim.first, ncol = dim.second;
+            std::vector<size_t> order(rows.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(),
+                    [&] (const size_t a, const size_t b) {
+                    return rows[a] != rows[b] ? rows[a] < rows[b] :
+                    cols[a] < cols[b]; });
+
+            row_ptr.assign(nrow+1, 0);
+            col_idx.clear();
+            row_vals.clear();
+            for (size_t i = 0; i < order.size(); i++) {
+                const size_t e = order[i];
+                if (i && rows[e] == rows[order[i-1]] &&
+                        cols[e] == cols[order[i-1]]) {
+                    row_vals.back() += vals[e];
+                    continue;
+                }
+                col_idx.push_back(cols[e]);
+                row_vals.push_back(vals[e]);
+                row_ptr[rows[e]+1]++;
+            }
+            std::partial_sum(row_ptr.begin(), row_ptr.end(), row_ptr.begin());
+
+            // Rows are visited in order so each column's samples ascend
+            col_ptr.assign(ncol+1, 0);
+            for (auto col : col_idx)
+                col_ptr[col+1]++;
+            std::partial_sum(col_ptr.begin(), col_ptr.end(), col_ptr.begin());
+            row_idx.resize(col_idx.size());
+            col_vals.resize(col_idx.size());
+            std::vector<size_t> next(col_ptr.begin(), col_ptr.end()-1);
+            for (size_t row = 0; row < nrow; row++)
+                for (size_t i = row_ptr[row]; i < row_ptr[row+1]; i++) {
+                    const size_t pos = next[col_idx[i]]++;
+                    row_idx[pos] = row;
+                    col_vals[pos] = row_vals[i];
+                }
+        }
+
+    public:
+        static BasicSparseIO* create() {
+            if (!singleton)
+                singleton = new BasicSparseIO;
+            return singleton;
+        }
+
+        BasicSparseIO() : IO() {
+            this->orientation = mat_orient_t::ROW;
+        }
+
+        // From `nnz` (row, col, val) triplets in any order
+        BasicSparseIO(const dimpair dim, const sample_id_t* rows,
+                const feature_id_t* cols, const T* vals, const size_t nnz) :
+            IO(dim, mat_orient_t::ROW) {
+            for (size_t i = 0; i < nnz; i++)
+                if (rows[i] >= dim.first || cols[i] >= dim.second)
+                    throw parameter_exception("Sparse entry out of bounds");
+            build(std::vector<sample_id_t>(rows, rows+nnz),
+                    std::vector<feature_id_t>(cols, cols+nnz),
+                    std::vector<T>(vals, vals+nnz));
+        }
+
+        static BasicSparseIO* cast2(typename IO::raw_ptr iop) {
+            return static_cast<BasicSparseIO*>(iop);
+        }
+
+        void set_fn(const std::string fn) override {
+            if (this->fn.empty())
+                IO::set_fn(fn);
+        }
+
+        // Both layouts are kept so the orientation is always ROW
+        void set_orientation(const mat_orient_t orient) override {
+        }
+
+        void shape(const dimpair dim) override {
+            if (this->dim == dimpair(0,0))
+                IO::shape(dim);
+        }
+
+        const dimpair& shape() override {
+            return IO::shape();
+        }
+
+        /**
+          \brief Read a COO file as written by test-data/gensparse.py: float64
+            n, nnz then the nnz row ids, col ids & values. An unset shape is
+            taken to be n x n
+          */
+        void from_file() override {
+            if (!row_ptr.empty()) return;
+
+            std::ifstream fs(fn, std::ios::binary);
+            double header[2];
+            if (!fs.read(reinterpret_cast<char*>(header), sizeof(header)))
+                throw io_exception(std::string("Failure to read file: '")
+                        + fn + std::string("'\n"));
+            if (dim == dimpair(0,0))
+                IO::shape(dimpair(header[0], header[0]));
+
+            const size_t nnz = header[1];
+            std::vector<double> coo(3*nnz);
+            if (!fs.read(reinterpret_cast<char*>(&coo[0]),
+                        coo.size()*sizeof(double)))
+                throw io_exception("Short read of COO file: '" + fn + "'");
+
+            std::vector<sample_id_t> rows(nnz);
+            std::vector<feature_id_t> cols(nnz);
+            std::vector<T> vals(nnz);
+            for (size_t i = 0; i < nnz; i++) {
+                rows[i] = coo[i];
+                cols[i] = coo[nnz+i];
+                vals[i] = coo[2*nnz+i];
+                if (rows[i] >= dim.first || cols[i] >= dim.second)
+                    throw io_exception("COO entry " + std::to_string(i) +
+                            " of '" + fn + "' is outside the shape");
+            }
+            build(rows, cols, vals);
+        }
+
+        sparse_slice<T> get_sparse_row(const offset_t offset) {
+            const size_t start = row_ptr[offset];
+            const size_t nnz = row_ptr[offset+1] - start;
+            utils::add_io_bytes(nnz*(sizeof(feature_id_t) + sizeof(T)));
+            return sparse_slice<T>(col_idx.data() + start,
+                    row_vals.data() + start, nnz);
+        }
+
+        sparse_slice<T> get_sparse_col(const offset_t offset) {
+            const size_t start = col_ptr[offset];
+            const size_t nnz = col_ptr[offset+1] - start;
+            utils::add_io_bytes(nnz*(sizeof(sample_id_t) + sizeof(T)));
+            return sparse_slice<T>(row_idx.data() + start,
+                    col_vals.data() + start, nnz);
+        }
+
+        T* get_row(const offset_t offset) override {
+            T* row = scratch_row<T>(dim.second);
+            std::fill(row, row + dim.second, 0);
+            sparse_slice<T> nz = get_sparse_row(offset);
+            for (size_t i = 0; i < nz.nnz; i++)
+                row[nz.indexes[i]] = nz.vals[i];
+            return row;
+        }
+
+        // Caller frees
+        T* get_col(const offset_t offset) override {
+            T* col = new T[dim.first]();
+            sparse_slice<T> nz = get_sparse_col(offset);
+            for (size_t i = 0; i < nz.nnz; i++)
+                col[nz.indexes[i]] = nz.vals[i];
+            return col;
+        }
+
+        typename IO::dist_t euclidean(const T* sample,
+                const offset_t offset) override {
+            sparse_slice<T> nz = get_sparse_row(offset);
+            return distance::sparse_euclidean(sample, nz.indexes, nz.vals,
+                    nz.nnz, dim.second);
+        }
+
+        const size_t nnz() const {
+            return row_vals.size();
+        }
+
+        // Bytes held by both layouts
+        const size_t nbytes() const {
+            return (row_ptr.size() + col_ptr.size())*sizeof(size_t) +
+                nnz()*(sizeof(feature_id_t) + sizeof(sample_id_t) +
+                        2*sizeof(T));
+        }
+
+        void destroy() override {
+            std::vector<size_t>().swap(row_ptr);
+            std::vector<feature_id_t>().swap(col_idx);
+            std::vector<T>().swap(row_vals);
+            std::vector<size_t>().swap(col_ptr);
+            std::vector<sample_id_t>().swap(row_idx);
+            std::vector<T>().swap(col_vals);
+        }
+};
+
+template <typename T>
+BasicSparseIO<T>* BasicSparseIO<T>::singleton = NULL;
+
+typedef BasicSparseIO<data_t> SparseIO;
+
+} } // End namespace monya::io
+#endif
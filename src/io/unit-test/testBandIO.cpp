@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <random>
+
+#include "BandIO.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t M = 50, N = 40, KL = 3, KU = 5;
+
+// Row major with nonzeros only within the band
+std::vector<data_t> make_banded() {
+    std::default_random_engine gen(42);
+    std::uniform_real_distribution<data_t> dist(-1, 1);
+    std::vector<data_t> dense(M*N, 0);
+    for (size_t i = 0; i < M; i++)
+        for (size_t j = 0; j < N; j++)
+            if (j + KL >= i && i + KU >= j)
+                dense[i*N+j] = dist(gen);
+    return dense;
+}
+
+void test_layout(const mat_orient_t layout) {
+    std::vector<data_t> dense = make_banded();
+    io::BandIO bio(&dense[0], dimpair(M, N), ROW, KL, KU, layout);
+    assert(bio.get_orientation() == BAND);
+    assert(bio.nbytes() == (layout == ROW ? M : N)*(KL+KU+1)*sizeof(data_t));
+
+    for (size_t i = 0; i < M; i++) {
+        data_t* row = bio.get_row(i);
+        for (size_t j = 0; j < N; j++)
+            assert(row[j] == dense[i*N+j] && bio.get(i, j) == dense[i*N+j]);
+        assert(std::fabs(bio.euclidean(&dense[0], i) - distance::euclidean(
+                        &dense[0], row, N)) < 1e-5);
+        delete [] row; // Not ROW ordered
+    }
+    for (size_t j = 0; j < N; j++) {
+        data_t* col = bio.get_col(j);
+        for (size_t i = 0; i < M; i++)
+            assert(col[i] == dense[i*N+j]);
+    }
+
+    // Banded & dense products agree
+    std::vector<data_t> x(N), xt(M), y(M), yt(N);
+    for (size_t j = 0; j < N; j++) x[j] = j % 7 - 3.;
+    for (size_t i = 0; i < M; i++) xt[i] = i % 5 - 2.;
+    bio.gbmv(&x[0], &y[0]);
+    bio.gbmv(&xt[0], &yt[0], true);
+    for (size_t i = 0; i < M; i++) {
+        double expect = 0;
+        for (size_t j = 0; j < N; j++)
+            expect += dense[i*N+j]*x[j];
+        assert(std::fabs(y[i] - expect) < 1e-4);
+    }
+    for (size_t j = 0; j < N; j++) {
+        double expect = 0;
+        for (size_t i = 0; i < M; i++)
+            expect += dense[i*N+j]*xt[i];
+        assert(std::fabs(yt[j] - expect) < 1e-4);
+    }
+
+    // The band storage round trips through a file
+    const std::string fn = "test_band.bin";
+    bio.set_fn(fn);
+    bio.write();
+    io::BandIO copy(dimpair(M, N), KL, KU, layout);
+    copy.set_fn(fn);
+    copy.from_file();
+    for (size_t i = 0; i < M; i++)
+        for (size_t j = 0; j < N; j++)
+            assert(copy.get(i, j) == dense[i*N+j]);
+    assert(!std::remove(fn.c_str()));
+
+    bool thrown = false;
+    try {
+        bio.set(0, KU+1, 1);
+    } catch (parameter_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    bio.set(0, KU+1, 0); // Zeros outside the band are fine
+    printf("%s band IO test successful!\n", layout == ROW ? "Row" : "Col");
+}
+}
+
+int main(int argc, char* argv[]) {
+    test_layout(ROW);
+    test_layout(COL);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BinnedMatrix.hpp"
+#include <vector>
+#include <cassert>
+
+using namespace monya;
+
+int main(int argc, char* argv[]) {
+    constexpr size_t NROW = 1000;
+    constexpr size_t NCOL = 3;
+
+    // Col 0: Distinct values, col 1: Two values, col 2: Constant
+    std::vector<data_t> v(NROW*NCOL);
+    for (size_t i = 0; i < NROW; i++) {
+        v[i] = NROW - i;
+        v[NROW + i] = i % 2;
+        v[2*NROW + i] = 7;
+    }
+
+    io::MemoryIO ioer(&v[0], dimpair(NROW, NCOL), mat_orient_t::COL);
+    io::BinnedMatrix::ptr bins = io::BinnedMatrix::create(&ioer, 16);
+
+    assert(bins->get_nsamples() == NROW);
+    assert(bins->nbytes() == NROW*NCOL);
+    assert(bins->get_nbins(0) == 16);
+    assert(bins->get_nbins(1) == 2);
+    assert(bins->get_nbins(2) == 1);
+
+    // Codes agree with the thresholds & quantiles fill bins evenly
+    std::vector<size_t> counts(16);
+    for (size_t f = 0; f < NCOL; f++) {
+        const io::bin_t* col = bins->get_col(f);
+        for (size_t i = 0; i < NROW; i++) {
+            const data_t val = v[f*NROW + i];
+            assert(col[i] == bins->bin(f, val));
+            if (col[i] + 1u < bins->get_nbins(f))
+                assert(val <= bins->get_threshold(f, col[i]));
+            if (col[i])
+                assert(val > bins->get_threshold(f, col[i]-1));
+            if (!f)
+                counts[col[i]]++;
+        }
+    }
+    for (auto count : counts)
+        assert(count >= NROW/16 - 2 && count <= NROW/16 + 2);
+
+    // Edges from a prefix still code every sample
+    io::BinnedMatrix::ptr prefix = io::BinnedMatrix::create(&ioer, 4, 10);
+    assert(prefix->get_edges(0).back() <= NROW);
+    assert(prefix->get_col(0)[0] == 3); // Above every edge
+    assert(prefix->get_col(0)[NROW-1] == 0);
+
+    bool thrown = false;
+    try {
+        io::BinnedMatrix::create(&ioer, io::MAX_BINS+1);
+    } catch (parameter_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::cout << "BinnedMatrix Test successful!\n\n";
+    return EXIT_SUCCESS;
+}
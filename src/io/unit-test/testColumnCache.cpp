@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+
+#include "ColumnCache.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NROW = 500, NCOL = 8;
+
+void check(const io::ColumnCache::column_ptr& col, const size_t c) {
+    assert(col->size() == NROW);
+    for (size_t r = 0; r < NROW; r++)
+        assert((*col)[r] == r*NCOL + c);
+}
+
+// A ROW ioer hands out new columns, a COL ioer its own memory
+void test_cache(const mat_orient_t orient) {
+    std::vector<data_t> v(NROW*NCOL);
+    for (size_t r = 0; r < NROW; r++)
+        for (size_t c = 0; c < NCOL; c++)
+            v[orient == ROW ? r*NCOL+c : c*NROW+r] = r*NCOL + c;
+    io::MemoryIO ioer(&v[0], dimpair(NROW, NCOL), orient);
+
+    io::ColumnCache cache;
+    {
+        io::ColumnCache::column_ptr a = cache.get(&ioer, 2);
+        io::ColumnCache::column_ptr b = cache.get(&ioer, 2);
+        assert(a == b);
+        check(a, 2);
+        assert(cache.get_nfetched() == 1 && cache.get_nshared() == 1);
+    }
+    // Nobody holds it so it's read again
+    check(cache.get(&ioer, 2), 2);
+    assert(cache.get_nfetched() == 2);
+
+    // Many concurrent holders, one read per column
+    std::vector<io::ColumnCache::column_ptr> held(64*NCOL);
+#pragma omp parallel for num_threads(16)
+    for (size_t i = 0; i < held.size(); i++)
+        held[i] = cache.get(&ioer, i % NCOL);
+    for (size_t i = 0; i < held.size(); i++)
+        check(held[i], i % NCOL);
+    assert(cache.get_nfetched() == 2 + NCOL);
+    assert(cache.get_nshared() == 1 + held.size() - NCOL);
+    printf("%s column cache test successful!\n",
+            orient == ROW ? "Row" : "Col");
+}
+}
+
+int main(int argc, char* argv[]) {
+    test_cache(ROW);
+    test_cache(COL);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+
+#include "IOfactory.hpp"
+
+using namespace monya;
+
+#ifdef USE_HDF5
+namespace {
+constexpr size_t NROW = 1000, NCOL = 24;
+const std::string FN = "test.h5";
+
+// Element (r, c) of every dataset
+data_t val(const size_t r, const size_t c) {
+    return r*NCOL + c;
+}
+
+// A chunked float /train & a contiguous double /test in ann-benchmarks style
+void write_h5() {
+    hid_t file = H5Fcreate(FN.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+            H5P_DEFAULT);
+    hsize_t dims[2] = { NROW, NCOL };
+    hid_t space = H5Screate_simple(2, dims, NULL);
+
+    std::vector<float> fbuf(NROW*NCOL);
+    std::vector<double> dbuf(NROW*NCOL);
+    for (size_t r = 0; r < NROW; r++)
+        for (size_t c = 0; c < NCOL; c++)
+            fbuf[r*NCOL+c] = dbuf[r*NCOL+c] = val(r, c);
+
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    hsize_t chunk[2] = { 37, NCOL }; // Doesn't divide NROW
+    H5Pset_chunk(dcpl, 2, chunk);
+    hid_t dset = H5Dcreate2(file, "/train", H5T_IEEE_F32LE, space,
+            H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &fbuf[0]);
+    H5Dclose(dset);
+    H5Pclose(dcpl);
+
+    dset = H5Dcreate2(file, "/test", H5T_IEEE_F64LE, space,
+            H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            &dbuf[0]);
+    H5Dclose(dset);
+    H5Sclose(space);
+    H5Fclose(file);
+}
+
+void check_row(const data_t* row, const size_t r) {
+    for (size_t c = 0; c < NCOL; c++)
+        assert(row[c] == val(r, c));
+}
+
+void check_col(const data_t* col, const size_t c, const size_t nrow) {
+    for (size_t r = 0; r < nrow; r++)
+        assert(col[r] == val(r, c));
+}
+
+void test_from_file(const std::string fn, const mat_orient_t orient) {
+    io::HDF5IO h5(fn, orient);
+    assert(h5.file_shape() == dimpair(NROW, NCOL));
+    h5.from_file();
+    assert(h5.shape() == dimpair(NROW, NCOL));
+
+    data_t* data = h5.get_data();
+    for (size_t r = 0; r < NROW; r++)
+        for (size_t c = 0; c < NCOL; c++)
+            assert(data[orient == ROW ? r*NCOL+c : c*NROW+r] == val(r, c));
+    h5.destroy();
+    printf("%s %s from_file test successful!\n", h5.dataset().c_str(),
+            orient == ROW ? "row" : "col");
+}
+
+// Hyperslabs of a prefix of the samples, as NodeView::prep fetches them
+void test_out_of_core(const mat_orient_t orient) {
+    const size_t nrow = NROW/2;
+    io::HDF5IO h5(FN, orient, dimpair(nrow, NCOL));
+
+    for (size_t c = 0; c < NCOL; c++) {
+        data_t* col = h5.get_col(c);
+        check_col(col, c, nrow);
+        if (orient == ROW)
+            delete [] col;
+    }
+    for (size_t r = 0; r < nrow; r += 7) {
+        data_t* row = h5.get_row(r);
+        check_row(row, r);
+        if (orient != ROW)
+            delete [] row;
+    }
+
+    // Prefetched columns are read in the background & kept for repeats
+    for (size_t c = 0; c < NCOL; c++) {
+        h5.prefetch_col(c);
+        for (int rep = 0; rep < 2; rep++) {
+            data_t* col = h5.get_col(c);
+            check_col(col, c, nrow);
+            if (orient == ROW)
+                delete [] col;
+        }
+    }
+    h5.prefetch_col(0); // Still in flight at destroy
+    h5.destroy();
+    printf("%s out of core test successful!\n", orient == ROW ? "Row" : "Col");
+}
+
+void test_errors() {
+    bool thrown = false;
+    try {
+        io::HDF5IO h5(FN + ":/neighbors", ROW);
+    } catch (io_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    io::HDF5IO h5(FN, ROW, dimpair(NROW, NCOL+1));
+    try {
+        h5.from_file();
+    } catch (io_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    h5.destroy();
+    printf("HDF5 error test successful!\n");
+}
+
+// A forest shares one in memory copy
+void test_factory() {
+    io::IO* ioer = IOfactory::create(MEM, F32, file_t::HDF5);
+    assert(ioer == IOfactory::create(MEM, F32, file_t::HDF5));
+    ioer->set_fn(FN);
+    ioer->set_orientation(COL);
+    ioer->shape(dimpair(NROW, NCOL));
+    ioer->from_file();
+    check_col(ioer->get_col(3), 3, NROW);
+    ioer->destroy();
+
+    ioer = IOfactory::create(SYNC, F32, file_t::HDF5);
+    ioer->set_fn(FN + ":/test");
+    ioer->set_orientation(COL);
+    ioer->shape(dimpair(NROW, NCOL));
+    check_col(ioer->get_col(5), 5, NROW);
+    ioer->destroy();
+    delete ioer;
+    printf("HDF5 factory test successful!\n");
+}
+}
+
+int main(int argc, char* argv[]) {
+    write_h5();
+    test_from_file(FN, ROW);
+    test_from_file(FN, COL);
+    test_from_file(FN + ":/test", COL);
+    test_out_of_core(ROW);
+    test_out_of_core(COL);
+    test_errors();
+    test_factory();
+    assert(!std::remove(FN.c_str()));
+    return EXIT_SUCCESS;
+}
+#else
+int main(int argc, char* argv[]) {
+    printf("Built without HDF5, USE_HDF5=1 to test it\n");
+    return EXIT_SUCCESS;
+}
+#endif
@@ -118,6 +118,19 @@ int main(int argc, char* argv[]) {
     }
 #endif
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Test prefetch_col: the file's rows are the columns of a COL matrix
+    ////////////////////////////////////////////////////////////////////////////
+    io::SyncIO colioer(fn, dimpair(NCOL, NROW), mat_orient_t::COL);
+    for (size_t row = 0; row < NROW; row++) {
+        colioer.prefetch_col(row);
+        colioer.prefetch_col(row); // Dropped
+        syncbuf = colioer.get_col(row);
+        for (size_t col = 0; col < NCOL; col++)
+            assert(syncbuf[col] == v[row*NCOL+col]);
+    }
+    colioer.destroy();
+
     std::cout << "Cleaning up\n";
     syncioer->destroy();
     assert(!std::remove(fn.c_str()));
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <random>
+
+#include "IOfactory.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NROW = 1000;
+constexpr size_t NCOL = 16;
+
+// Column major data with a different range per dimension
+std::vector<data_t> make_data() {
+    std::default_random_engine gen(1234);
+    std::vector<data_t> data(NROW*NCOL);
+    for (size_t col = 0; col < NCOL; col++) {
+        std::uniform_real_distribution<data_t> dist(-(col+1.), 3*(col+1.));
+        for (size_t row = 0; row < NROW; row++)
+            data[col*NROW+row] = dist(gen);
+    }
+    return data;
+}
+
+void test_half() {
+    const float vals[] = { 0, -0., 1, -2.5, 65504, 1e-7, 6.1e-5, 3.14159 };
+    for (float val : vals) {
+        float back = quantize::half2float(quantize::float2half(val));
+        assert(std::fabs(back - val) <= std::fabs(val)*1e-3 + 6e-8);
+    }
+    // Every finite half survives the round trip
+    for (uint32_t h = 0; h < 0x7c00; h++) {
+        assert(quantize::float2half(quantize::half2float(h)) == h);
+        assert(quantize::float2half(-quantize::half2float(h)) ==
+                (h | 0x8000));
+    }
+    assert(std::isinf(quantize::half2float(quantize::float2half(1e6))));
+    printf("Half conversion test successful!\n");
+}
+
+// Every decoded value is within half a quantization step of the original
+template <typename code_t>
+void test_quantized(const data_t tol) {
+    std::vector<data_t> data = make_data();
+    io::QuantizedIO<code_t> qio(&data[0], dimpair(NROW, NCOL), COL);
+    assert(qio.get_orientation() == ROW);
+    assert(qio.nbytes() == NROW*NCOL*sizeof(code_t));
+
+    std::vector<data_t> sample(NCOL);
+    for (size_t row = 0; row < NROW; row++) {
+        data_t* decoded = qio.get_row(row);
+        for (size_t col = 0; col < NCOL; col++) {
+            sample[col] = data[col*NROW+row];
+            assert(std::fabs(decoded[col] - sample[col]) <= tol*(col+1));
+        }
+
+        // Distance on the codes matches distance on the decoded row
+        data_t dist = qio.euclidean(&data[0], row); // A column as a sample
+        data_t ref = distance::euclidean(&data[0], decoded, NCOL);
+        assert(std::fabs(dist - ref) <= 1e-4*std::max<data_t>(1, ref));
+    }
+
+    data_t* col = qio.get_col(3);
+    for (size_t row = 0; row < NROW; row++)
+        assert(col[row] == qio.get_row(row)[3]);
+    delete [] col;
+
+    // Rows held at once stay valid
+    data_t* first = qio.get_row(0);
+    data_t first0 = first[0];
+    for (unsigned i = 1; i < io::NROW_BUF; i++)
+        qio.get_row(i);
+    assert(first[0] == first0);
+    printf("%lu byte quantized IO test successful!\n", sizeof(code_t));
+}
+
+void test_factory() {
+    std::vector<data_t> data = make_data();
+    std::string fn = "test_quantized.bin";
+    std::ofstream(fn, std::ios::binary).write(
+            reinterpret_cast<const char*>(&data[0]),
+            data.size()*sizeof(data_t));
+
+    io::IO* ioer = IOfactory::create(MEM, INT8);
+    ioer->set_fn(fn);
+    ioer->set_orientation(COL);
+    ioer->shape(dimpair(NROW, NCOL));
+    ioer->from_file();
+    assert(ioer == IOfactory::create(MEM, INT8));
+    assert(ioer != IOfactory::create(MEM, F16));
+    assert(std::fabs(ioer->get_row(7)[5] - data[5*NROW+7]) <= 6*4/255.);
+    ioer->destroy();
+    assert(!std::remove(fn.c_str()));
+
+    bool thrown = false;
+    try {
+        Params params(NROW, NCOL, fn, SYNC, 1, 1, COL, 2, 4, BIN, 0,
+                EUCLIDEAN, F16);
+    } catch (parameter_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    printf("Quantized IO factory test successful!\n");
+}
+}
+
+int main(int argc, char* argv[]) {
+    test_half();
+    // A step is range/255 for int8; the ranges here are 4*(col+1)
+    test_quantized<uint8_t>(.5*4/255. + 1e-5);
+    test_quantized<uint16_t>(4/2048.);
+    test_factory();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+
+#include "IOfactory.hpp"
+#include "../../structures/SampleVector.hpp"
+
+using namespace monya;
+
+namespace {
+// The COO file densified row major
+std::vector<data_t> read_dense(const std::string fn, size_t& n) {
+    std::ifstream fs(fn, std::ios::binary);
+    double header[2];
+    fs.read(reinterpret_cast<char*>(header), sizeof(header));
+    n = header[0];
+    const size_t nnz = header[1];
+    std::vector<double> coo(3*nnz);
+    fs.read(reinterpret_cast<char*>(&coo[0]), coo.size()*sizeof(double));
+
+    std::vector<data_t> dense(n*n, 0);
+    for (size_t i = 0; i < nnz; i++)
+        dense[coo[i]*n + coo[nnz+i]] += coo[2*nnz+i];
+    return dense;
+}
+
+void test_coo() {
+    const std::string fn = "../../test-data/coo_n10_m30.bin";
+    size_t n;
+    std::vector<data_t> dense = read_dense(fn, n);
+
+    io::IO* ioer = IOfactory::create(MEM, SPARSE);
+    ioer->set_fn(fn);
+    ioer->set_orientation(COL); // Ignored
+    ioer->from_file();
+    assert(ioer->shape() == dimpair(n, n));
+    assert(ioer->get_orientation() == ROW);
+    io::SparseIO* spio = io::SparseIO::cast2(ioer);
+    assert(spio->nnz() == 30);
+
+    for (size_t i = 0; i < n; i++) {
+        data_t* row = ioer->get_row(i);
+        data_t* col = ioer->get_col(i);
+        for (size_t j = 0; j < n; j++) {
+            assert(row[j] == dense[i*n+j]);
+            assert(col[j] == dense[j*n+i]);
+        }
+        delete [] col;
+
+        // Ascending nonzeros only
+        io::sparse_slice<data_t> nz = spio->get_sparse_col(i);
+        for (size_t k = 0; k < nz.nnz; k++) {
+            assert(nz.vals[k] != 0 && nz.vals[k] == dense[nz.indexes[k]*n+i]);
+            assert(!k || nz.indexes[k-1] < nz.indexes[k]);
+        }
+
+        // Sparse kernels agree with the dense one exactly
+        io::sparse_slice<data_t> a = spio->get_sparse_row(i);
+        for (size_t j = 0; j < n; j++) {
+            const data_t expect = distance::euclidean(&dense[i*n],
+                    &dense[j*n], n);
+            assert(ioer->euclidean(&dense[i*n], j) == expect);
+            io::sparse_slice<data_t> b = spio->get_sparse_row(j);
+            assert(distance::sparse_euclidean(a.indexes, a.vals, a.nnz,
+                        b.indexes, b.vals, b.nnz) == expect);
+        }
+    }
+    ioer->destroy();
+    printf("COO sparse IO test successful!\n");
+}
+
+void test_triplets() {
+    // Duplicates are summed; the last dimension is far from the rest
+    const sample_id_t rows[] = { 2, 0, 2, 1, 2 };
+    const feature_id_t cols[] = { 999999, 5, 0, 5, 999999 };
+    const data_t vals[] = { 1, 2, 3, 4, 5 };
+    io::SparseIO spio(dimpair(3, 1000000), rows, cols, vals, 5);
+    assert(spio.nnz() == 4);
+
+    io::sparse_slice<data_t> row = spio.get_sparse_row(2);
+    assert(row.nnz == 2 && row.indexes[0] == 0 && row.indexes[1] == 999999 &&
+            row.vals[0] == 3 && row.vals[1] == 6);
+    io::sparse_slice<data_t> col = spio.get_sparse_col(5);
+    assert(col.nnz == 2 && col.indexes[0] == 0 && col.indexes[1] == 1);
+    assert(spio.get_sparse_col(7).nnz == 0);
+
+    container::SparseVector sample;
+    sample.resize(1000000);
+    sample.append(5, 2);
+    assert(sample.nnz() == 1 && sample[5] == 2 && sample[6] == 0);
+    io::sparse_slice<data_t> r0 = spio.get_sparse_row(0);
+    assert(distance::sparse_euclidean(sample.get_indexes(),
+                sample.raw_data(), sample.nnz(), r0.indexes, r0.vals,
+                r0.nnz) == 0);
+
+    data_t dense[] = { 0, 1, 0, 0, 7 };
+    container::SparseVector from_dense(dense, 5);
+    assert(from_dense.size() == 5 && from_dense.nnz() == 2 &&
+            from_dense[4] == 7 && from_dense.get_indexes()[0] == 1);
+
+    bool thrown = false;
+    try {
+        io::SparseIO(dimpair(2, 2), rows, cols, vals, 1);
+    } catch (parameter_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    printf("Sparse triplets test successful!\n");
+}
+}
+
+int main(int argc, char* argv[]) {
+    test_coo();
+    test_triplets();
+    return EXIT_SUCCESS;
+}
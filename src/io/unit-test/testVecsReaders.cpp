@@ -0,0 +1,136 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <random>
+#include <type_traits>
+
+#include "vecs_reader.hpp"
+
+using namespace monya;
+
+namespace {
+// Write `nrow` records of `ncol` elements. Row r holds r+c in column c
+template <typename T>
+void write_vecs(const std::string fn, const size_t nrow, const int32_t ncol) {
+    std::ofstream fs(fn, std::ios::binary);
+    for (size_t row = 0; row < nrow; row++) {
+        fs.write(reinterpret_cast<const char*>(&ncol), sizeof(ncol));
+        for (int32_t col = 0; col < ncol; col++) {
+            T val = static_cast<T>(row + col);
+            fs.write(reinterpret_cast<const char*>(&val), sizeof(val));
+        }
+    }
+}
+
+template <typename T>
+void check(const T* buf, const size_t nrow, const size_t ncol) {
+    for (size_t row = 0; row < nrow; row++)
+        for (size_t col = 0; col < ncol; col++)
+            assert(buf[row*ncol+col] == static_cast<T>(row + col));
+}
+
+// Enough rows for several chunks per thread
+constexpr size_t NROW = 50000;
+constexpr size_t NCOL = 96;
+
+void test_fvecs() {
+    write_vecs<float>("test.fvecs", NROW, NCOL);
+    assert(io::vecs_shape("test.fvecs", sizeof(float)) ==
+            dimpair(NROW, NCOL));
+
+    std::vector<data_t> serial, parallel;
+    io::fvecs_reader("test.fvecs", NROW, NCOL, 1).read(serial);
+    io::fvecs_reader("test.fvecs", NROW, NCOL, 8).read(parallel);
+    check(&parallel[0], NROW, NCOL);
+    assert(serial == parallel);
+
+    // A prefix of the rows
+    std::vector<data_t> head;
+    io::fvecs_reader("test.fvecs", 10, NCOL, 4).read(head);
+    assert(head.size() == 10*NCOL);
+    check(&head[0], 10, NCOL);
+    assert(!std::remove("test.fvecs"));
+    printf("fvecs test successful!\n");
+}
+
+void test_ivecs() {
+    write_vecs<int32_t>("test.ivecs", NROW, NCOL);
+    std::vector<int32_t> ids;
+    io::ivecs_reader("test.ivecs", NROW, NCOL, 8).read(ids);
+    check(&ids[0], NROW, NCOL);
+
+    std::vector<data_t> inflated;
+    io::ivecs_reader("test.ivecs", NROW, NCOL, 8).read(inflated);
+    check(&inflated[0], NROW, NCOL);
+    assert(!std::remove("test.ivecs"));
+    printf("ivecs test successful!\n");
+}
+
+void test_bvecs() {
+    write_vecs<uint8_t>("test.bvecs", NROW, NCOL);
+    assert(io::vecs_shape("test.bvecs", sizeof(uint8_t)) ==
+            dimpair(NROW, NCOL));
+
+    // Stays one byte per element
+    std::vector<uint8_t> bytes;
+    io::bvecs_reader("test.bvecs", NROW, NCOL, 8).read(bytes);
+    assert(bytes.size() == NROW*NCOL);
+    check(&bytes[0], NROW, NCOL);
+
+    io::vecs_reader* vr = new io::bvecs_reader("test.bvecs", NROW, NCOL, 3);
+    std::vector<data_t> inflated;
+    vr->read(inflated);
+    delete vr;
+    for (size_t i = 0; i < bytes.size(); i++)
+        assert(inflated[i] == bytes[i]);
+    printf("bvecs test successful!\n");
+
+    // Claiming the wrong dimension is reported rather than misread
+    bool thrown = false;
+    try {
+        io::bvecs_reader("test.bvecs", NROW/2, NCOL+1, 4).read(bytes);
+    } catch (io_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(!std::remove("test.bvecs"));
+
+    thrown = false;
+    try {
+        io::bvecs_reader("test.bvecs", NROW, NCOL);
+    } catch (io_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    printf("bvecs error test successful!\n");
+}
+}
+
+// A reader owns its file descriptor
+static_assert(!std::is_copy_constructible<io::fvecs_reader>::value &&
+        !std::is_copy_assignable<io::fvecs_reader>::value,
+        "vecs readers must not be copyable");
+
+int main(int argc, char* argv[]) {
+    test_fvecs();
+    test_ivecs();
+    test_bvecs();
+    return EXIT_SUCCESS;
+}
@@ -21,9 +21,18 @@
 #define MONYA_VECS_READER_HPP__
 
 #include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "../common/exception.hpp"
 #include "../common/types.hpp"
+#include "../utils/FileUtil.hpp"
 
 namespace monya { namespace io {
 
@@ -33,46 +42,187 @@ namespace monya { namespace io {
         BVECS
     };
 
+    // # of rows & their dimension from the size of a vecs file whose
+    //  elements are `elem_size` bytes
+    inline dimpair vecs_shape(const std::string& fn, const size_t elem_size) {
+        std::ifstream fs(fn, std::ios::binary);
+        int32_t dim;
+        if (!fs.read(reinterpret_cast<char*>(&dim), sizeof(dim)) || dim <= 0)
+            throw io_exception("Failure to read a vecs header from '" +
+                    fn + "'");
+        return dimpair(utils::get_file_size(fn) /
+                (sizeof(dim) + dim*elem_size), dim);
+    }
+
+    /**
+      \brief Base of the *vecs readers. Every record is an int32 dimension
+        followed by that many elements so row offsets follow from the fixed
+        record size. Threads decode disjoint row ranges with pread.
+      */
     class vecs_reader {
         protected:
-            std::fstream fs;
+            std::string fn;
+            int fd;
             dimpair dim;
+            unsigned nthread; // 0: one per core
+            vecs_t format; // Set by the subclass
+
+            // Decode `dim.first` records of `T` elements into `buf` as `Out`
+            template <typename T, typename Out>
+            void decode(Out* buf) {
+                const size_t record = sizeof(int32_t) + dim.second*sizeof(T);
+                // A few MB per read keeps threads busy without much memory
+                const size_t chunk = std::max<size_t>(1, (4 << 20) / record);
+                const size_t nchunk = (dim.first + chunk - 1) / chunk;
+                const unsigned nworker = nthread ? nthread :
+                    std::max(1u, std::thread::hardware_concurrency());
+
+                std::string error; // Exceptions can't leave the loop
+#pragma omp parallel for num_threads(nworker) schedule(dynamic)
+                for (size_t c = 0; c < nchunk; c++) {
+                    const size_t first = c*chunk;
+                    const size_t nrow = std::min(chunk, dim.first - first);
+                    std::vector<char> raw(nrow*record);
+
+                    ssize_t rc = pread(fd, &raw[0], raw.size(),
+                            first*record);
+                    if (rc != (ssize_t)raw.size()) {
+#pragma omp critical
+                        error = "Short read of '" + fn + "' at row " +
+                            std::to_string(first);
+                        continue;
+                    }
+
+                    for (size_t i = 0; i < nrow; i++) {
+                        const char* rec = &raw[i*record];
+                        int32_t read_dim;
+                        std::copy(rec, rec + sizeof(read_dim),
+                                reinterpret_cast<char*>(&read_dim));
+                        if (read_dim != static_cast<int32_t>(dim.second)) {
+#pragma omp critical
+                            error = "Row " + std::to_string(first+i) +
+                                " of '" + fn + "' has dimension " +
+                                std::to_string(read_dim) + " not " +
+                                std::to_string(dim.second);
+                            break;
+                        }
+
+                        const T* elems = reinterpret_cast<const T*>(
+                                rec + sizeof(read_dim));
+                        std::copy(elems, elems + dim.second,
+                                &buf[(first+i)*dim.second]);
+                    }
+                }
+
+                if (!error.empty())
+                    throw io_exception(error);
+            }
 
         public:
             vecs_reader(const std::string fn, const size_t nrow,
-                    const size_t ncol) {
+                    const size_t ncol, const unsigned nthread=0) :
+                fn(fn), nthread(nthread), format(FVECS) {
                 dim = dimpair(nrow, ncol);
 
-                fs.open(fn.c_str(), std::ios_base::in);
-                if (!fs.is_open())
+                fd = open(fn.c_str(), O_RDONLY);
+                if (fd < 0)
                     throw io_exception(std::string("Failure to open file: '")
-                            + fn + std::string("'\n"));
+                            + fn + std::string("'\n"), errno);
             }
 
-            virtual void read(std::vector<data_t>& buf) = 0;
+            // Owns `fd`
+            vecs_reader(const vecs_reader&) = delete;
+            vecs_reader& operator=(const vecs_reader&) = delete;
+
+            // Inflate the elements to data_t
             virtual void read(data_t* buf) = 0;
-            virtual ~vecs_reader() { fs.close();}
+
+            void read(std::vector<data_t>& buf) {
+                buf.resize(dim.first*dim.second);
+                read(&buf[0]);
+            }
+
+            // Convert the elements to any element type `Out`
+            template <typename Out>
+            void read_as(Out* buf) {
+                switch (format) {
+                    case FVECS:
+                        decode<float>(buf);
+                        break;
+                    case IVECS:
+                        decode<int32_t>(buf);
+                        break;
+                    case BVECS:
+                        decode<uint8_t>(buf);
+                        break;
+                }
+            }
+
+            const dimpair& shape() const { return dim; }
+
+            virtual ~vecs_reader() { close(fd); }
     };
 
     class fvecs_reader : public vecs_reader {
         public:
             fvecs_reader(const std::string fn, const size_t nrow,
-                    const size_t ncol) : vecs_reader(fn, nrow, ncol) {
+                    const size_t ncol, const unsigned nthread=0) :
+                vecs_reader(fn, nrow, ncol, nthread) {
+                format = FVECS;
             }
 
-            void read(std::vector<data_t>& buf) override {
+            using vecs_reader::read;
+            void read(data_t* buf) override {
+                decode<float>(buf);
+            }
+    };
+
+    // e.g. ground truth neighbor ids
+    class ivecs_reader : public vecs_reader {
+        public:
+            ivecs_reader(const std::string fn, const size_t nrow,
+                    const size_t ncol, const unsigned nthread=0) :
+                vecs_reader(fn, nrow, ncol, nthread) {
+                format = IVECS;
+            }
+
+            using vecs_reader::read;
+            void read(data_t* buf) override {
+                decode<int32_t>(buf);
+            }
+
+            void read(int32_t* buf) {
+                decode<int32_t>(buf);
+            }
+
+            void read(std::vector<int32_t>& buf) {
+                buf.resize(dim.first*dim.second);
                 read(&buf[0]);
             }
+    };
 
+    // Byte vectors e.g. SIFT1B. Read into uint8_t to keep them 4x smaller
+    //  than when inflated to data_t
+    class bvecs_reader : public vecs_reader {
+        public:
+            bvecs_reader(const std::string fn, const size_t nrow,
+                    const size_t ncol, const unsigned nthread=0) :
+                vecs_reader(fn, nrow, ncol, nthread) {
+                format = BVECS;
+            }
+
+            using vecs_reader::read;
             void read(data_t* buf) override {
-                int read_dim;
-                for (size_t row = 0; row < dim.first; row++) {
-                    fs.read(reinterpret_cast<char*>(&read_dim), sizeof(buf[0]));
-                    assert(read_dim == static_cast<int>(dim.second));
+                decode<uint8_t>(buf);
+            }
 
-                    fs.read(reinterpret_cast<char*>((&buf[row*dim.second])),
-                            dim.second*sizeof(buf[0]));
-                }
+            void read(uint8_t* buf) {
+                decode<uint8_t>(buf);
+            }
+
+            void read(std::vector<uint8_t>& buf) {
+                buf.resize(dim.first*dim.second);
+                read(&buf[0]);
             }
     };
 
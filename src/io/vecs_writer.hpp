@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_VECS_WRITER_HPP__
+#define MONYA_VECS_WRITER_HPP__
+
+#include <fstream>
+#include <cerrno>
+
+#include "../common/exception.hpp"
+#include "../common/types.hpp"
+
+namespace monya { namespace io {
+
+    // Appends rows in the fvecs/ivecs layout: An int32 dimension then the
+    //  row. Rows can be written a chunk at a time.
+    template <typename T>
+    class vecs_writer {
+        private:
+            std::fstream fs;
+            size_t ncol;
+
+        public:
+            vecs_writer(const std::string fn, const size_t ncol) :
+                ncol(ncol) {
+                fs.open(fn.c_str(), std::ios_base::out |
+                        std::ios_base::trunc | std::ios_base::binary);
+                if (!fs.is_open())
+                    throw io_exception(std::string("Failure to open file: '")
+                            + fn + std::string("'\n"));
+            }
+
+            // `buf` is nrow x ncol row major
+            void write(const T* buf, const size_t nrow) {
+                const int dim = ncol;
+                for (size_t row = 0; row < nrow; row++) {
+                    fs.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+                    fs.write(reinterpret_cast<const char*>(&buf[row*ncol]),
+                            ncol*sizeof(T));
+                }
+                if (!fs)
+                    throw io_exception("vecs_writer: write failed", errno);
+            }
+
+            ~vecs_writer() { fs.close(); }
+    };
+
+    typedef vecs_writer<float> fvecs_writer;
+    typedef vecs_writer<int> ivecs_writer;
+
+} } // End namespace monya::io
+#endif
@@ -23,6 +23,8 @@
 // Represent a binary node
 
 #include "NodeView.hpp"
+#include "EMNode.hpp"
+#include "NodePager.hpp"
 #include <iostream>
 #include "../common/types.hpp"
 
@@ -33,7 +35,7 @@ class BinaryNode: public NodeView {
         // TODO: Visibility
         // TODO: rm
 #if 1
-        BinaryNode* parent;
+        using NodeView::parent; // No shadow copy
         BinaryNode* left;
         BinaryNode* right;
 #endif
@@ -45,7 +47,7 @@ class BinaryNode: public NodeView {
         // Inherit constructors
         using NodeView::NodeView;
 
-        BinaryNode* get_parent() { return parent; }
+        BinaryNode* get_parent() { return static_cast<BinaryNode*>(parent); }
 
         virtual void run() override {
             throw abstract_exception("BinaryNode::run");
@@ -63,18 +65,35 @@ class BinaryNode: public NodeView {
             return left|| right;
         }
 
+        // Fill the on disk record for this node. Programs that keep more
+        //  split state (e.g. the dimension) should extend this.
+        virtual void to_em(EMNode& em) {
+            em.comparator = comparator;
+        }
+
+        // Per feature bounds of this node's members, if the program keeps them
+        virtual const data_t* get_lower_bounds() { return NULL; }
+        virtual const data_t* get_upper_bounds() { return NULL; }
+
         void read_svm() {
             // TODO
         }
 
-        // Async writeback
-        void persist() {
-            // TODO
+        // Async writeback of the members. Only leaves registered with the
+        //  pager are written out; internal nodes stay pinned.
+        void persist(NodePager* pager) {
+            pager->evict(this);
         }
 
-        // Keep the node in memory
-        void cache() {
-            // TODO
+        // Keep the node in memory, faulting its members in if needed.
+        //  Returns the bytes read from disk
+        size_t cache(NodePager* pager) {
+            return pager->pin(this);
+        }
+
+        // Allow the node to be paged out again
+        void uncache(NodePager* pager) {
+            pager->unpin(this);
         }
 
         virtual ~BinaryNode() override {
@@ -0,0 +1,362 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <cerrno>
+#include <cmath>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "EMNode.hpp"
+#include "BinaryNode.hpp"
+#include "Query.hpp"
+#include "SampleVector.hpp"
+#include "Stack.hpp"
+#include "Tombstone.hpp"
+#include "../io/IO.hpp"
+#include "../common/NNVector.hpp"
+#include "../common/distance.hpp"
+
+namespace monya { namespace container {
+
+    static size_t align8(const size_t nbytes) {
+        return (nbytes + 7) & ~static_cast<size_t>(7);
+    }
+
+    static void pad8(std::ofstream& ofs) {
+        const char zeros[8] = { 0 };
+        size_t pos = ofs.tellp();
+        ofs.write(zeros, align8(pos) - pos);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // EMTree
+    ////////////////////////////////////////////////////////////////////////////
+
+    EMTree::EMTree(const char* base, const size_t nbytes,
+            const offset_t nfeatures) : nfeatures(nfeatures) {
+        // Each section must fit in what's left. Sizes are divided rather
+        //  than multiplied so a corrupt count can't overflow
+        size_t left = nbytes;
+        auto take = [&] (const size_t count, const size_t size) {
+            if (size && count > left / size)
+                throw io_exception("Persisted tree runs past the end of "
+                        "the file");
+            const char* section = base;
+            base += count*size;
+            left -= count*size;
+            return section;
+        };
+
+        header = reinterpret_cast<const BinaryTreeHeader*>(
+                take(1, sizeof(BinaryTreeHeader)));
+        take(1, align8(sizeof(BinaryTreeHeader)) - sizeof(BinaryTreeHeader));
+        nodes = reinterpret_cast<const EMNode*>(
+                take(header->nnodes, sizeof(EMNode)));
+        index = reinterpret_cast<const sample_id_t*>(
+                take(header->nindex, sizeof(sample_id_t)));
+        take(1, align8(header->nindex*sizeof(sample_id_t)) -
+                header->nindex*sizeof(sample_id_t));
+        bounds = header->has_bounds ? reinterpret_cast<const data_t*>(
+                take(header->nnodes, 2*nfeatures*sizeof(data_t))) : NULL;
+
+        // Children follow their parent (BFS) so descending terminates
+        for (node_id_t id = 0; id < header->nnodes; id++) {
+            const EMNode& node = nodes[id];
+            if ((node.left != EM_NO_CHILD &&
+                        (node.left <= id || node.left >= header->nnodes)) ||
+                    (node.right != EM_NO_CHILD &&
+                     (node.right <= id || node.right >= header->nnodes)) ||
+                    (!node.is_leaf() && node.split_dim >= nfeatures) ||
+                    node.index_offset > header->nindex ||
+                    node.nindex > header->nindex - node.index_offset)
+                throw io_exception("Persisted tree node out of range", id);
+        }
+    }
+
+    // Lower bound on the distance from `sample` to any member of node `id`
+    data_t EMTree::min_dist(const data_t* sample, const node_id_t id) const {
+        const data_t* lower = get_lower_bounds(id);
+        const data_t* upper = get_upper_bounds(id);
+
+        data_t res = 0;
+        for (offset_t i = 0; i < nfeatures; i++) {
+            data_t diff = 0;
+            if (sample[i] < lower[i])
+                diff = lower[i] - sample[i];
+            else if (sample[i] > upper[i])
+                diff = sample[i] - upper[i];
+            res += diff*diff;
+        }
+        return std::sqrt(res);
+    }
+
+    node_id_t EMTree::descend(const data_t* sample) const {
+        node_id_t id = 0;
+        while (!nodes[id].is_leaf()) {
+            const EMNode& node = nodes[id];
+            // NOTE: Always <= go left and > right
+            if (sample[node.split_dim] > node.comparator)
+                id = node.right == EM_NO_CHILD ? node.left : node.right;
+            else
+                id = node.left == EM_NO_CHILD ? node.right : node.left;
+        }
+        return id;
+    }
+
+    /**
+      * Exact kNN: Depth first visiting the child the sample falls into first.
+      *  When bounds were persisted, subtrees that cannot hold anything closer
+      *  than the current k-th neighbor are skipped.
+      */
+    void EMTree::find_neighbors(ProximityQuery* query, io::IO* ioer,
+            const tree_t tree_id) const {
+        const data_t* sample = query->get_qsample()->dense();
+        NNVector* nnv = query->getNN()[tree_id];
+        const size_t k = query->get_k();
+
+        QueryStats& stats = query->get_stats();
+
+        if (!get_nnodes())
+            return;
+
+        Stack<node_id_t> stack;
+        stack.push(0);
+
+        while (!stack.empty()) {
+            node_id_t id = stack.pop();
+            const EMNode& node = nodes[id];
+
+            if (bounds && nnv->size() == k &&
+                    min_dist(sample, id) >= (*nnv)[k-1].get_val()) {
+                stats[QueryStats::PRUNED]++;
+                continue;
+            }
+
+            if (node.is_leaf()) {
+                const sample_id_t* members = get_index(id);
+                stats[QueryStats::LEAVES]++;
+                stats[QueryStats::DISTANCES] += node.nindex;
+                stats[QueryStats::IO_BYTES] += node.nindex*
+                    (sizeof(sample_id_t) + nfeatures*sizeof(data_t));
+                for (sample_id_t i = 0; i < node.nindex; i++) {
+                    data_t* row = ioer->get_row(members[i]);
+                    query->eval(members[i],
+                            distance::euclidean(const_cast<data_t*>(sample),
+                                row, nfeatures), tree_id);
+
+                    if (ioer->get_orientation() != ROW)
+                        delete [] row;
+                }
+                continue;
+            }
+
+            // Push the far child first so the near one is visited first
+            stats[QueryStats::NODES]++;
+            node_id_t near = node.left, far = node.right;
+            if (sample[node.split_dim] > node.comparator)
+                std::swap(near, far);
+
+            if (far != EM_NO_CHILD) stack.push(far);
+            if (near != EM_NO_CHILD) stack.push(near);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // EMForest
+    ////////////////////////////////////////////////////////////////////////////
+
+    EMForest::EMForest(const std::string fn) {
+        fd = open(fn.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw io_exception(std::string("Failure to open file: '") + fn +
+                    std::string("'"), errno);
+
+        struct stat stat_buf;
+        if (fstat(fd, &stat_buf)) {
+            close(fd);
+            throw io_exception("fstat", errno);
+        }
+        nbytes = stat_buf.st_size;
+
+        if (nbytes < sizeof(ForestHeader)) {
+            close(fd);
+            throw io_exception(fn + std::string(" is not a monya forest"));
+        }
+
+        void* ret = mmap(NULL, nbytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (ret == MAP_FAILED) {
+            close(fd);
+            throw io_exception("mmap", errno);
+        }
+        addr = static_cast<char*>(ret);
+        header = reinterpret_cast<const ForestHeader*>(addr);
+
+        if (header->magic != EM_MAGIC || header->version != EM_VERSION) {
+            munmap(addr, nbytes);
+            close(fd);
+            throw io_exception(fn + std::string(" is not a monya forest"));
+        }
+
+        if (header->dtype != sizeof(data_t)) {
+            munmap(addr, nbytes);
+            close(fd);
+            throw io_exception("forest persisted with a different data_t",
+                    header->dtype);
+        }
+
+        const size_t offsets_pos = align8(sizeof(ForestHeader));
+        const offset_t* tree_offsets = reinterpret_cast<const offset_t*>(
+                addr + offsets_pos);
+        try {
+            if (header->ntree > (nbytes - offsets_pos) / sizeof(offset_t))
+                throw io_exception(fn + std::string(" is truncated"));
+            for (tree_t i = 0; i < header->ntree; i++) {
+                if (tree_offsets[i] > nbytes)
+                    throw io_exception(fn + std::string(
+                                ": tree offset past the end of the file"), i);
+                trees.push_back(EMTree(addr + tree_offsets[i],
+                            nbytes - tree_offsets[i], header->nfeatures));
+            }
+        } catch (io_exception& e) {
+            munmap(addr, nbytes);
+            close(fd);
+            throw;
+        }
+    }
+
+    void EMForest::write(const std::string fn,
+            std::vector<BinaryNode*>& roots, const offset_t nfeatures,
+            const std::vector<NodePager*>& pagers,
+            const Tombstone* tombstones) {
+        std::ofstream ofs(fn, std::ofstream::out | std::ofstream::binary);
+        if (!ofs.is_open())
+            throw io_exception(std::string("Failure to open file: '") + fn +
+                    std::string("'\n"));
+
+        ForestHeader fh;
+        fh.ntree = roots.size();
+        fh.nfeatures = nfeatures;
+        ofs.write(reinterpret_cast<char*>(&fh), sizeof(fh));
+        pad8(ofs);
+
+        // Filled in once each tree is written
+        const size_t offsets_pos = ofs.tellp();
+        std::vector<offset_t> tree_offsets(roots.size(), 0);
+        ofs.write(reinterpret_cast<char*>(tree_offsets.data()),
+                sizeof(offset_t)*tree_offsets.size());
+
+        for (size_t tid = 0; tid < roots.size(); tid++) {
+            tree_offsets[tid] = ofs.tellp();
+            NodePager* pager = tid < pagers.size() ? pagers[tid] : NULL;
+
+            // BFS order
+            std::vector<BinaryNode*> bfs;
+            std::vector<EMNode> recs;
+            std::vector<sample_id_t> index;
+            bool has_bounds = false;
+
+            if (roots[tid])
+                bfs.push_back(roots[tid]);
+
+            for (size_t id = 0; id < bfs.size(); id++) {
+                BinaryNode* node = bfs[id];
+                recs.push_back(EMNode());
+                node->to_em(recs.back());
+
+                if (node->left) {
+                    recs.back().left = bfs.size();
+                    bfs.push_back(node->left);
+                }
+
+                if (node->right) {
+                    recs.back().right = bfs.size();
+                    bfs.push_back(node->right);
+                }
+
+                if (!node->has_child()) {
+                    if (pager) node->cache(pager);
+                    IndexVector& members = node->get_data_index();
+                    recs.back().index_offset = index.size();
+                    for (auto it = members.begin(); it != members.end(); ++it)
+                        if (!tombstones || !tombstones->is_set(
+                                    it->get_index()))
+                            index.push_back(it->get_index());
+                    recs.back().nindex = index.size() -
+                        recs.back().index_offset;
+                    if (pager) node->uncache(pager);
+                }
+
+                if (node->get_lower_bounds())
+                    has_bounds = true;
+            }
+
+            BinaryTreeHeader th;
+            th.nnodes = recs.size();
+            th.nindex = index.size();
+            th.has_bounds = has_bounds;
+            ofs.write(reinterpret_cast<char*>(&th), sizeof(th));
+            pad8(ofs);
+
+            ofs.write(reinterpret_cast<char*>(recs.data()),
+                    sizeof(EMNode)*recs.size());
+            ofs.write(reinterpret_cast<char*>(index.data()),
+                    sizeof(sample_id_t)*index.size());
+            pad8(ofs);
+
+            if (has_bounds) {
+                // Nodes without bounds never prune
+                std::vector<data_t> lowest(nfeatures,
+                        std::numeric_limits<data_t>::lowest());
+                std::vector<data_t> highest(nfeatures,
+                        std::numeric_limits<data_t>::max());
+
+                for (auto node : bfs) {
+                    const data_t* lower = node->get_lower_bounds();
+                    const data_t* upper = node->get_upper_bounds();
+                    ofs.write(reinterpret_cast<const char*>(
+                                lower ? lower : &lowest[0]),
+                            sizeof(data_t)*nfeatures);
+                    ofs.write(reinterpret_cast<const char*>(
+                                upper ? upper : &highest[0]),
+                            sizeof(data_t)*nfeatures);
+                }
+            }
+            pad8(ofs);
+        }
+
+        ofs.seekp(offsets_pos);
+        ofs.write(reinterpret_cast<char*>(tree_offsets.data()),
+                sizeof(offset_t)*tree_offsets.size());
+
+        if (!ofs.good())
+            throw io_exception(std::string("Failure writing forest to '") +
+                    fn + std::string("'"));
+        ofs.close();
+    }
+
+    EMForest::~EMForest() {
+        munmap(addr, nbytes);
+        close(fd);
+    }
+
+} } // End monya::container
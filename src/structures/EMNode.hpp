@@ -22,25 +22,68 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
+#include <string>
 
 #include "../common/types.hpp"
 
+/**
+  * On disk layout of a persisted forest. Every section starts on an 8 byte
+  *  boundary so the whole file can be mmap'd & used in place:
+  *
+  *  ForestHeader | offset_t tree_offsets[ntree] |
+  *  per tree: BinaryTreeHeader | EMNode nodes[nnodes] |
+  *      sample_id_t index[nindex] | data_t bounds[nnodes][2][nfeatures]
+  *
+  *  Nodes are stored in BFS order so children always follow their parent.
+  */
+
 namespace monya {
+    namespace io {
+        template <typename T> class BasicIO;
+        typedef BasicIO<data_t> IO;
+    }
+
     namespace container {
 
+class BinaryNode;
+class NodePager;
+class ProximityQuery;
+class Tombstone;
+
+constexpr unsigned EM_MAGIC = 0x4d4f4e59; // "MONY"
+constexpr unsigned EM_VERSION = 1;
+constexpr node_id_t EM_NO_CHILD = std::numeric_limits<node_id_t>::max();
+
+class ForestHeader {
+    public:
+        unsigned magic;
+        unsigned version;
+        tree_t ntree;
+        unsigned dtype; // Size (Bytes) of data stored at node
+        offset_t nfeatures;
+
+        ForestHeader() : magic(EM_MAGIC), version(EM_VERSION), ntree(0),
+            dtype(sizeof(data_t)), nfeatures(0) {
+        }
+};
+
 class TreeHeader {
     public:
         node_id_t nnodes; // Total number of nodes in a tree
         short dtype; // Size (Bytes) of data stored at node
+
+        TreeHeader() : nnodes(0), dtype(sizeof(data_t)) {
+        }
 };
 
 class BinaryTreeHeader: public TreeHeader {
     public:
-        node_id_t nnodes;
         node_id_t nchilds; // How many children each node has
+        bool has_bounds; // Are per node feature bounds persisted
+        offset_t nindex; // Total # of sample ids held by the leaves
 
-    BinaryTreeHeader() {
-        this->nchilds = 2;
+    BinaryTreeHeader() : nchilds(2), has_bounds(false), nindex(0) {
     }
 };
 
@@ -71,9 +114,102 @@ class VarNodeHeader: public NodeHeader {
         // TODO
 };
 
-// Represent a node in the tree
+// Fixed size record representing a node on disk
 class EMNode {
-    // TODO
+    public:
+        data_t comparator; // The split comparator
+        unsigned split_dim; // The feature the comparator applies to
+        node_id_t left; // EM_NO_CHILD if none
+        node_id_t right;
+        offset_t index_offset; // Start of this node's members in the index
+        sample_id_t nindex; // Only leaves hold members
+
+        EMNode() : comparator(0), split_dim(0), left(EM_NO_CHILD),
+            right(EM_NO_CHILD), index_offset(0), nindex(0) {
+        }
+
+        const bool is_leaf() const {
+            return left == EM_NO_CHILD && right == EM_NO_CHILD;
+        }
+};
+
+// Read only view of a single tree within a mapped forest file
+class EMTree {
+    private:
+        const BinaryTreeHeader* header;
+        const EMNode* nodes;
+        const sample_id_t* index;
+        const data_t* bounds; // NULL if not persisted
+        offset_t nfeatures;
+
+        data_t min_dist(const data_t* sample, const node_id_t id) const;
+
+    public:
+        // Throws io_exception if the tree doesn't fit in the `nbytes` at
+        //  `base` or its nodes point outside it
+        EMTree(const char* base, const size_t nbytes,
+                const offset_t nfeatures);
+
+        const node_id_t get_nnodes() const { return header->nnodes; }
+        const offset_t get_nindex() const { return header->nindex; }
+        const bool has_bounds() const { return NULL != bounds; }
+
+        const EMNode& get_node(const node_id_t id) const {
+            return nodes[id];
+        }
+
+        const sample_id_t* get_index(const node_id_t id) const {
+            return &index[nodes[id].index_offset];
+        }
+
+        const data_t* get_lower_bounds(const node_id_t id) const {
+            return &bounds[id*2*nfeatures];
+        }
+
+        const data_t* get_upper_bounds(const node_id_t id) const {
+            return &bounds[(id*2 + 1)*nfeatures];
+        }
+
+        // The leaf `sample` falls into
+        node_id_t descend(const data_t* sample) const;
+        void find_neighbors(ProximityQuery* query, io::IO* ioer,
+                const tree_t tree_id) const;
+};
+
+// A persisted forest mapped into memory. Nothing is copied on load
+class EMForest {
+    private:
+        int fd;
+        char* addr;
+        size_t nbytes;
+        const ForestHeader* header;
+        std::vector<EMTree> trees;
+
+    public:
+        typedef std::shared_ptr<EMForest> ptr;
+
+        EMForest(const std::string fn);
+        // Owns the mapping
+        EMForest(const EMForest&) = delete;
+        EMForest& operator=(const EMForest&) = delete;
+
+        static ptr create(const std::string fn) {
+            return ptr(new EMForest(fn));
+        }
+
+        // Serialize the trees rooted at `roots` to `fn`. Paged out leaves
+        //  are faulted in through `pagers`, one per tree, NULL if none.
+        //  Members set in `tombstones` are left out
+        static void write(const std::string fn,
+                std::vector<BinaryNode*>& roots, const offset_t nfeatures,
+                const std::vector<NodePager*>& pagers =
+                std::vector<NodePager*>(), const Tombstone* tombstones = NULL);
+
+        const tree_t ntree() const { return trees.size(); }
+        const offset_t get_nfeatures() const { return header->nfeatures; }
+        const EMTree& get_tree(const tree_t id) const { return trees[id]; }
+
+        ~EMForest();
 };
 
 } } // End monya::container
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FlatBinaryTree.hpp"
+#include "BinaryNode.hpp"
+#include "EMNode.hpp"
+
+namespace monya { namespace container {
+
+    FlatBinaryTree::FlatBinaryTree(BinaryNode* root) {
+        if (NULL == root)
+            return;
+
+        // The BinaryNode each flat node was made from. NULL for FLAT_EMPTY
+        std::vector<BinaryNode*> bfs { root };
+        nodes.push_back(FlatNode());
+
+        for (node_id_t id = 0; id < bfs.size(); id++) {
+            BinaryNode* node = bfs[id];
+
+            if (NULL == node || !node->has_child()) {
+                nodes[id].comparator = node ? node->get_comparator() : 0;
+                nodes[id].split_dim = FLAT_LEAF;
+                if (node) {
+                    nodes[id].child = leaves.size();
+                    leaves.push_back(node);
+                } else {
+                    nodes[id].child = FLAT_EMPTY;
+                }
+                continue;
+            }
+
+            EMNode em;
+            node->to_em(em);
+            nodes[id].comparator = em.comparator;
+            nodes[id].split_dim = em.split_dim;
+
+            // Siblings are adjacent. A missing child becomes an empty leaf
+            nodes[id].child = bfs.size();
+            bfs.push_back(node->left);
+            bfs.push_back(node->right);
+            nodes.resize(bfs.size());
+        }
+    }
+
+} } // End monya::container
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_FLAT_BINARY_TREE_HPP__
+#define MONYA_FLAT_BINARY_TREE_HPP__
+
+#include <memory>
+#include <vector>
+
+#include "../common/types.hpp"
+
+namespace monya { namespace container {
+
+class BinaryNode;
+
+constexpr unsigned FLAT_LEAF = std::numeric_limits<unsigned>::max();
+constexpr node_id_t FLAT_EMPTY = std::numeric_limits<node_id_t>::max();
+
+// 12 Bytes so the top few levels of a tree share a handful of cache lines
+class FlatNode {
+    public:
+        data_t comparator;
+        unsigned split_dim; // FLAT_LEAF for leaves
+        // Internal: Left child. The right child is always at child+1.
+        //  Leaf: The leaf id or FLAT_EMPTY when the parent had no such child
+        node_id_t child;
+
+        const bool is_leaf() const { return split_dim == FLAT_LEAF; }
+};
+
+/**
+  * A frozen, pointer free copy of a trained tree used for queries. Nodes are
+  *  in BFS order with siblings adjacent so a descent only reads the split
+  *  dimension & comparator of the nodes on its path. The leaves keep pointing
+  *  at the BinaryNodes holding their membership.
+  */
+class FlatBinaryTree {
+    private:
+        std::vector<FlatNode> nodes;
+        std::vector<BinaryNode*> leaves;
+
+    public:
+        typedef std::shared_ptr<FlatBinaryTree> ptr;
+
+        // The split dimension of each node is taken from BinaryNode::to_em
+        FlatBinaryTree(BinaryNode* root);
+
+        static ptr create(BinaryNode* root) {
+            return ptr(new FlatBinaryTree(root));
+        }
+
+        const node_id_t get_nnodes() const { return nodes.size(); }
+        const node_id_t get_nleaves() const { return leaves.size(); }
+        const bool empty() const { return nodes.empty(); }
+
+        const FlatNode& get_node(const node_id_t id) const {
+            return nodes[id];
+        }
+
+        // NULL for FLAT_EMPTY
+        BinaryNode* get_leaf(const FlatNode& node) const {
+            return node.child == FLAT_EMPTY ? NULL : leaves[node.child];
+        }
+
+        // NOTE: Always <= go left and > right
+        const node_id_t get_child(const FlatNode& node,
+                const data_t* sample) const {
+            return node.child + (sample[node.split_dim] > node.comparator);
+        }
+
+        // Id of the leaf node `sample` falls into
+        node_id_t descend(const data_t* sample) const {
+            node_id_t id = 0;
+            while (!nodes[id].is_leaf())
+                id = get_child(nodes[id], sample);
+            return id;
+        }
+
+        const size_t nbytes() const {
+            return nodes.size()*sizeof(FlatNode) +
+                leaves.size()*sizeof(BinaryNode*);
+        }
+};
+
+} } // End monya::container
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "KNNGraph.hpp"
+#include "../common/distance.hpp"
+#include "../io/vecs_writer.hpp"
+
+namespace monya { namespace container {
+
+    KNNGraph::KNNGraph(const size_t nsamples, const unsigned k) :
+        nsamples(nsamples), k(k) {
+        if (!k)
+            throw parameter_exception("KNNGraph: k must be positive");
+
+        sizes.assign(nsamples, 0);
+        ids.resize(nsamples*k);
+        dists.resize(nsamples*k);
+    }
+
+    const data_t KNNGraph::get_bound(const sample_id_t row) const {
+        return sizes[row] < k ? std::numeric_limits<data_t>::max() :
+            dists[row*k + k-1];
+    }
+
+    bool KNNGraph::insert(const sample_id_t row, const sample_id_t id,
+            const data_t dist) {
+        if (dist >= get_bound(row))
+            return false;
+
+        sample_id_t* rids = &ids[row*k];
+        data_t* rdists = &dists[row*k];
+        const unsigned size = sizes[row];
+        if (std::find(rids, rids+size, id) != rids+size)
+            return false;
+
+        // Insertion sort. The last neighbor falls off a full row
+        unsigned pos = std::min(size, k-1);
+        while (pos && rdists[pos-1] > dist) {
+            rdists[pos] = rdists[pos-1];
+            rids[pos] = rids[pos-1];
+            pos--;
+        }
+        rdists[pos] = dist;
+        rids[pos] = id;
+        if (size < k)
+            sizes[row]++;
+        return true;
+    }
+
+    void KNNGraph::join(const std::vector<sample_id_t>& members,
+            data_t* data, const size_t nfeatures) {
+        const size_t n = members.size();
+        if (n < 2)
+            return;
+
+        std::vector<double> centroid(nfeatures, 0);
+        for (auto member : members)
+            for (size_t j = 0; j < nfeatures; j++)
+                centroid[j] += data[member*nfeatures+j];
+        for (size_t j = 0; j < nfeatures; j++)
+            centroid[j] /= n;
+
+        std::vector<data_t> norm2(n, 0); // Of the centered members
+        std::vector<data_t> centered(n*nfeatures);
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = 0; j < nfeatures; j++) {
+                centered[i*nfeatures+j] =
+                    data[members[i]*nfeatures+j] - centroid[j];
+                norm2[i] += centered[i*nfeatures+j]*centered[i*nfeatures+j];
+            }
+
+        std::vector<data_t> block(n*n);
+        distance::euclidean(&centered[0], n, &centered[0], n, nfeatures,
+                &block[0]);
+
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i+1; j < n; j++) {
+                const sample_id_t a = members[i], b = members[j];
+                if (a == b)
+                    continue; // Bootstrapped duplicates
+
+                const data_t bound = std::max(get_bound(a), get_bound(b));
+                if (bound != std::numeric_limits<data_t>::max() &&
+                        block[i*n+j]*block[i*n+j] > bound*bound +
+                        distance::gemm_slack(nfeatures, norm2[i], norm2[j]))
+                    continue;
+
+                const data_t dist = distance::euclidean(&data[a*nfeatures],
+                        &data[b*nfeatures], nfeatures);
+                insert(a, b, dist);
+                insert(b, a, dist);
+            }
+        }
+    }
+
+    size_t KNNGraph::refine(data_t* data, const size_t nfeatures,
+            const unsigned nthread) {
+        // Candidates come from the graph as it was before the round. Reverse
+        //  edges are followed too or rows never leave their own leaf group
+        std::vector<std::vector<sample_id_t> > nbrs(nsamples);
+        for (size_t row = 0; row < nsamples; row++)
+            nbrs[row].assign(&ids[row*k], &ids[row*k]+sizes[row]);
+        for (size_t row = 0; row < nsamples; row++)
+            for (unsigned i = 0; i < sizes[row]; i++) {
+                std::vector<sample_id_t>& rev = nbrs[ids[row*k+i]];
+                if (rev.size() < 2*k) // Caps the work for hubs
+                    rev.push_back(row);
+            }
+        size_t nchanged = 0;
+
+#pragma omp parallel for num_threads(nthread) schedule(dynamic, 256) \
+        reduction(+:nchanged)
+        for (size_t row = 0; row < nsamples; row++) {
+            bool changed = false;
+            for (const sample_id_t nbr : nbrs[row]) {
+                for (const sample_id_t cand : nbrs[nbr]) {
+                    if (cand == row)
+                        continue;
+                    changed |= insert(row, cand, distance::euclidean(
+                                &data[row*nfeatures], &data[cand*nfeatures],
+                                nfeatures));
+                }
+            }
+            nchanged += changed;
+        }
+        return nchanged;
+    }
+
+    void KNNGraph::write(const std::string ids_fn,
+            const std::string dists_fn, const size_t chunk) const {
+        io::ivecs_writer idsw(ids_fn, k);
+        std::unique_ptr<io::fvecs_writer> distsw(dists_fn.empty() ? NULL :
+                new io::fvecs_writer(dists_fn, k));
+
+        std::vector<int> id_buf(chunk*k);
+        std::vector<data_t> dist_buf(chunk*k);
+        for (size_t start = 0; start < nsamples; start += chunk) {
+            const size_t nrow = std::min(chunk, nsamples - start);
+            for (size_t row = 0; row < nrow; row++) {
+                for (unsigned i = 0; i < k; i++) {
+                    const bool found = i < sizes[start+row];
+                    id_buf[row*k+i] = found ? ids[(start+row)*k+i] : -1;
+                    dist_buf[row*k+i] = found ? dists[(start+row)*k+i] :
+                        std::numeric_limits<data_t>::max();
+                }
+            }
+            idsw.write(&id_buf[0], nrow);
+            if (distsw)
+                distsw->write(&dist_buf[0], nrow);
+        }
+    }
+} } // End monya::container
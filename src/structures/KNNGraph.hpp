@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_KNN_GRAPH_HPP__
+#define MONYA_KNN_GRAPH_HPP__
+
+#include <memory>
+#include <vector>
+#include <string>
+
+#include "../common/types.hpp"
+
+namespace monya { namespace container {
+
+/**
+  * The k nearest neighbors of every sample in a dataset. Rows are sorted by
+  *  distance & never hold a sample twice. Rows may be filled concurrently as
+  *  long as no two threads touch the same row.
+  */
+class KNNGraph {
+    private:
+        size_t nsamples;
+        unsigned k;
+        std::vector<unsigned> sizes; // # of neighbors found per row
+        std::vector<sample_id_t> ids; // nsamples x k
+        std::vector<data_t> dists; // nsamples x k
+
+    public:
+        typedef std::shared_ptr<KNNGraph> ptr;
+
+        KNNGraph(const size_t nsamples, const unsigned k);
+
+        static ptr create(const size_t nsamples, const unsigned k) {
+            return ptr(new KNNGraph(nsamples, k));
+        }
+
+        const size_t get_nsamples() const { return nsamples; }
+        const unsigned get_k() const { return k; }
+        const unsigned get_size(const sample_id_t row) const {
+            return sizes[row];
+        }
+
+        const sample_id_t* get_ids(const sample_id_t row) const {
+            return &ids[row*k];
+        }
+
+        const data_t* get_dists(const sample_id_t row) const {
+            return &dists[row*k];
+        }
+
+        // Distance a candidate must beat to enter `row`
+        const data_t get_bound(const sample_id_t row) const;
+
+        // False if `id` is already in `row` or isn't near enough
+        bool insert(const sample_id_t row, const sample_id_t id,
+                const data_t dist);
+
+        /**
+          \brief All pairs of `members` at once. Concurrent joins must have
+            disjoint members. Distances are screened with
+            one GEMM over the centered rows & recomputed directly for pairs
+            that may enter a row. Both rows of each pair are updated.
+          \param data: Row major nsamples x nfeatures
+          */
+        void join(const std::vector<sample_id_t>& members, data_t* data,
+                const size_t nfeatures);
+
+        // One round of neighbor-of-neighbor refinement over forward & reverse
+        //  edges. Returns the # of rows that changed
+        size_t refine(data_t* data, const size_t nfeatures,
+                const unsigned nthread);
+
+        /**
+          \brief Stream the rows out in chunks. Missing neighbors are -1 with
+            distance std::numeric_limits<data_t>::max().
+          \param dists_fn: Skipped if empty
+          */
+        void write(const std::string ids_fn, const std::string dists_fn="",
+                const size_t chunk=4096) const;
+};
+
+} } // End monya::container
+#endif
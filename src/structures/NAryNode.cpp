@@ -19,12 +19,13 @@
 
 // Represent an nary node
 
+#include <algorithm>
+
 #include "NAryNode.hpp"
 
 namespace monya { namespace container {
 
-         NAryNode::NAryNode () {
-            this->nchild = 0;
+         NAryNode::NAryNode () : nchild(0), capacity(0), childs(NULL) {
         }
 
         NAryNode::NAryNode (NodeView** childs, child_t nchild,
@@ -32,15 +33,43 @@ namespace monya { namespace container {
             /**
               * \param container_size: the length of the array containing children
               */
-            this->childs = childs;
+            assert(nchild <= container_size);
+            // The node owns a copy. The caller keeps its array
+            this->capacity = container_size;
+            this->childs = capacity ? new NodeView*[capacity] : NULL;
+            std::copy(childs, childs + nchild, this->childs);
             this->nchild = nchild;
         }
 
+        void NAryNode::resize_child_container(size_t to) {
+            assert(to >= nchild);
+            NodeView** resized = to ? new NodeView*[to] : NULL;
+            for (child_t i = 0; i < nchild; i++)
+                resized[i] = childs[i];
+
+            delete [] childs;
+            childs = resized;
+            capacity = to;
+        }
+
         void  NAryNode::add_child(NodeView* child) {
-            // TODO
+            assert(NULL != child);
+            if (nchild == capacity)
+                grow_container();
+
+            bestow(child);
+            childs[nchild++] = child;
         }
 
         void  NAryNode::remove_child() {
-            // TODO
+            if (!nchild)
+                return;
+
+            nchild--;
+            shrink_container();
+        }
+
+        NAryNode::~NAryNode() {
+            delete [] childs;
         }
 } } // End monya::container
@@ -29,33 +29,57 @@ namespace monya { namespace container {
 class NAryNode: public NodeView {
 
     private:
-        child_t nchild;
+        child_t nchild; // # of children held
+        child_t capacity; // Length of the `childs` array
         NodeView** childs;
 
-        void resize_child_container(size_t to) {
-            // TODO
-        }
+        void resize_child_container(size_t to);
 
         void grow_container() {
-            // TODO
+            resize_child_container(capacity ? 2*capacity : 2);
         }
 
+        // Give back memory once the array is less than a quarter full
         void shrink_container() {
-            // TODO
+            if (capacity > 2 && nchild <= capacity/4)
+                resize_child_container(capacity/2);
         }
 
     public:
 
         NAryNode ();
+        // Copies the first `nchild` of `childs` into an array the node owns
         NAryNode (NodeView** childs, child_t nchild,
                 child_t container_size);
+        NAryNode(const NAryNode&) = delete;
+        NAryNode& operator=(const NAryNode&) = delete;
         void add_child(NodeView* child);
-        void remove_child();
-        static NAryNode* cast2(NodeView* nv);
+        void remove_child(); // Drops the last child. Caller frees it
+        static NAryNode* cast2(NodeView* nv) {
+            return static_cast<NAryNode*>(nv);
+        }
+
+        NAryNode* get_parent() { return static_cast<NAryNode*>(parent); }
+
+        NAryNode* get_child(const child_t i) {
+            assert(i < nchild);
+            return static_cast<NAryNode*>(childs[i]);
+        }
+
+        const child_t get_nchild() const { return nchild; }
+        const child_t get_capacity() const { return capacity; }
+
+        virtual void init(Params&) override {
+            throw abstract_exception("NAryNode::init");
+        }
+
+        virtual void prep() override { NodeView::prep(); };
+        virtual void run() override {
+            throw abstract_exception("NAryNode::run");
+        };
+        virtual const bool has_child() override { return nchild > 0; }
 
-        virtual void prep() override { /*TODO*/ };
-        virtual void run() override { /*TODO*/ };
-        virtual const bool has_child() override { return NULL != childs; }
+        virtual ~NAryNode() override;
 };
 } } // End monya::container
 
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "NodePager.hpp"
+#include "NodeView.hpp"
+#include "../common/exception.hpp"
+
+namespace monya { namespace container {
+
+    void* writeback_callback(void* arg) {
+        NodePager* pager = static_cast<NodePager*>(arg);
+
+        pager->acquire_lock();
+        while (true) {
+            while (pager->writes.empty() && !pager->stop) {
+                int rc = pthread_cond_wait(&pager->write_cond, &pager->mutex);
+                if (rc) throw concurrency_exception("pthread_cond_wait", rc,
+                        __FILE__, __LINE__);
+            }
+
+            if (pager->writes.empty()) // Stopped & drained
+                break;
+
+            NodePager::write_t write = pager->writes.front();
+            pager->writes.pop();
+            pager->writing = true;
+            pager->release_lock();
+
+            const size_t nbytes = NodePager::nbytes(write.second->size());
+            ssize_t rc = pwrite(pager->fd, write.second->data(), nbytes,
+                    write.first);
+            if (rc != (ssize_t)nbytes)
+                throw io_exception("NodePager pwrite", errno);
+
+            pager->acquire_lock();
+            pager->writing = false;
+            if (pager->writes.empty())
+                pthread_cond_broadcast(&pager->drain_cond);
+        }
+        pager->release_lock();
+        pthread_exit(NULL);
+    }
+
+    NodePager::NodePager(const std::string fn, const size_t budget) :
+        fn(fn), budget(budget), resident_bytes(0), next_offset(0),
+        nfaults(0), nevictions(0), writing(false), stop(false) {
+
+        fd = open(fn.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw io_exception(std::string("Failure to open file: '") + fn +
+                    std::string("'"), errno);
+
+        pthread_mutexattr_init(&mutex_attr);
+        pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK);
+        pthread_mutex_init(&mutex, &mutex_attr);
+        pthread_cond_init(&write_cond, NULL);
+        pthread_cond_init(&drain_cond, NULL);
+        pthread_cond_init(&load_cond, NULL);
+
+        int rc = pthread_create(&writer, NULL, writeback_callback, this);
+        if (rc) throw concurrency_exception("pthread_create", rc,
+                __FILE__, __LINE__);
+    }
+
+    void NodePager::acquire_lock() {
+        int rc = pthread_mutex_lock(&mutex);
+        if (rc) throw concurrency_exception("pthread_mutex_lock", rc,
+                __FILE__, __LINE__);
+    }
+
+    void NodePager::release_lock() {
+        int rc = pthread_mutex_unlock(&mutex);
+        if (rc) throw concurrency_exception("pthread_mutex_unlock", rc,
+                __FILE__, __LINE__);
+    }
+
+    size_t NodePager::nbytes(const sample_id_t nindex) {
+        return nindex*sizeof(IndexVal<data_t>);
+    }
+
+    // Caller holds the lock
+    void NodePager::make_room() {
+        while (resident_bytes > budget && !lru.empty()) {
+            NodeView* victim = lru.front();
+            writeback(victim, pages[victim]);
+        }
+    }
+
+    // Caller holds the lock. `node` is resident. Counts its index as is
+    void NodePager::charge(NodeView* node, Page& page) {
+        const size_t bytes = nbytes(node->get_data_index().size());
+        resident_bytes = resident_bytes - page.charged + bytes;
+        page.charged = bytes;
+    }
+
+    // Caller holds the lock. `node` must be resident & unpinned
+    void NodePager::writeback(NodeView* node, Page& page) {
+        IndexVector& index = node->get_data_index();
+        std::shared_ptr<members_t> members =
+            std::make_shared<members_t>(index.begin(), index.end());
+
+        // Compaction only ever shrinks a leaf so the block is reused
+        assert(members->size() <= page.capacity);
+        page.nindex = members->size();
+        page.sorted = index.is_sorted();
+        page.inflight = members;
+        writes.push(write_t(page.offset, members));
+
+        int rc = pthread_cond_signal(&write_cond);
+        if (rc) throw concurrency_exception("pthread_cond_signal", rc,
+                __FILE__, __LINE__);
+
+        IndexVector empty;
+        node->swap_data_index(empty);
+        resident_bytes -= page.charged;
+        page.charged = 0;
+        page.resident = false;
+        lru.erase(page.lru_pos);
+        nevictions++;
+    }
+
+    // Caller holds the lock, which is dropped while reading. `page` is
+    //  marked loading so other pinners wait on `load_cond` instead
+    size_t NodePager::fault(NodeView* node, Page& page) {
+        page.loading = true;
+        // The block may still be queued for writing. If not the writer is
+        //  done with it & nothing writes it again until it's resident
+        std::shared_ptr<members_t> inflight;
+        if (page.inflight && page.inflight.use_count() > 1)
+            inflight = page.inflight;
+        page.inflight.reset();
+        const offset_t offset = page.offset;
+        const size_t nindex = page.nindex;
+        const bool sorted = page.sorted;
+        release_lock();
+
+        members_t members;
+        size_t nread = 0;
+        bool failed = false;
+        if (inflight) {
+            members = *inflight;
+        } else {
+            members.resize(nindex);
+            nread = nbytes(nindex);
+            failed = pread(fd, members.data(), nread, offset) !=
+                (ssize_t)nread;
+        }
+        const int err = errno;
+
+        IndexVector index;
+        index.reserve(members.size());
+        for (auto& iv : members)
+            index.append(iv);
+        index.set_sorted(sorted);
+
+        acquire_lock();
+        page.loading = false;
+        pthread_cond_broadcast(&load_cond);
+        if (failed)
+            throw io_exception("NodePager pread", err);
+
+        node->swap_data_index(index);
+        page.resident = true;
+        charge(node, page);
+        nfaults++;
+        return nread;
+    }
+
+    void NodePager::add(NodeView* leaf) {
+        acquire_lock();
+        assert(pages.find(leaf) == pages.end());
+
+        Page& page = pages[leaf];
+        page.capacity = page.nindex = leaf->get_data_index().size();
+        page.offset = next_offset;
+        next_offset += nbytes(page.capacity);
+
+        charge(leaf, page);
+        page.lru_pos = lru.insert(lru.end(), leaf);
+        make_room();
+        release_lock();
+    }
+
+    size_t NodePager::pin(NodeView* node) {
+        acquire_lock();
+        auto it = pages.find(node);
+        if (it == pages.end()) { // Not paged e.g. internal nodes
+            release_lock();
+            return 0;
+        }
+
+        size_t nread = 0;
+        Page& page = it->second;
+        // Unpinned & resident means it's on the lru list
+        if (page.resident && !page.pins)
+            lru.erase(page.lru_pos);
+        page.pins++; // Not evicted from here on
+
+        try {
+            while (!page.resident) {
+                if (page.loading) {
+                    int rc = pthread_cond_wait(&load_cond, &mutex);
+                    if (rc) throw concurrency_exception("pthread_cond_wait",
+                            rc, __FILE__, __LINE__);
+                } else {
+                    nread = fault(node, page);
+                }
+            }
+        } catch (...) {
+            page.pins--;
+            release_lock();
+            throw;
+        }
+
+        make_room();
+        release_lock();
+        return nread;
+    }
+
+    void NodePager::unpin(NodeView* node) {
+        acquire_lock();
+        auto it = pages.find(node);
+        if (it == pages.end()) {
+            release_lock();
+            return;
+        }
+
+        Page& page = it->second;
+        assert(page.pins && page.resident);
+        charge(node, page);
+        if (--page.pins == 0) {
+            page.lru_pos = lru.insert(lru.end(), node);
+            make_room();
+        }
+        release_lock();
+    }
+
+    void NodePager::evict(NodeView* node) {
+        acquire_lock();
+        auto it = pages.find(node);
+        if (it != pages.end() && it->second.resident && !it->second.pins)
+            writeback(node, it->second);
+        release_lock();
+    }
+
+    void NodePager::flush() {
+        acquire_lock();
+        while (!writes.empty() || writing) {
+            int rc = pthread_cond_wait(&drain_cond, &mutex);
+            if (rc) throw concurrency_exception("pthread_cond_wait", rc,
+                    __FILE__, __LINE__);
+        }
+        release_lock();
+    }
+
+    const bool NodePager::is_resident(NodeView* node) {
+        acquire_lock();
+        auto it = pages.find(node);
+        bool ret = it == pages.end() || it->second.resident;
+        release_lock();
+        return ret;
+    }
+
+    NodePager::~NodePager() {
+        acquire_lock();
+        stop = true;
+        pthread_cond_signal(&write_cond);
+        release_lock();
+
+        // Destructors can't throw. Report & release the rest regardless
+        void* join_status;
+        int rc = pthread_join(writer, &join_status);
+        if (rc)
+            fprintf(stderr, "[ERROR]: NodePager pthread_join: %s\n",
+                    strerror(rc));
+
+        pthread_mutex_destroy(&mutex);
+        pthread_mutexattr_destroy(&mutex_attr);
+        pthread_cond_destroy(&write_cond);
+        pthread_cond_destroy(&drain_cond);
+        pthread_cond_destroy(&load_cond);
+
+        close(fd);
+        unlink(fn.c_str()); // Scratch space only
+    }
+
+} } // End monya::container
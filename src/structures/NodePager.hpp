@@ -0,0 +1,129 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_NODE_PAGER_HPP__
+#define MONYA_NODE_PAGER_HPP__
+
+#include <list>
+#include <queue>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <pthread.h>
+
+#include "../common/types.hpp"
+
+namespace monya { namespace container {
+
+class NodeView;
+
+/**
+  * Keeps at most `budget` bytes of leaf membership (data_index) in memory.
+  *  Leaves beyond the budget are written back asynchronously to a scratch
+  *  file in least recently used order & faulted back in when pinned by a
+  *  query. The whole index (ids, values & sortedness) round trips. Faults
+  *  read without the pager lock so a cold leaf only stalls its own pinners.
+  *  Internal nodes are never registered so they stay resident.
+  */
+class NodePager {
+    private:
+        typedef std::vector<IndexVal<data_t> > members_t;
+
+        class Page {
+            public:
+                offset_t offset; // Location of the block in the file
+                sample_id_t capacity; // # of members the block can hold
+                sample_id_t nindex; // # of members on disk
+                size_t charged; // Bytes counted in resident_bytes
+                unsigned pins;
+                bool resident;
+                bool loading; // A pinner is faulting it in without the lock
+                bool sorted; // Of the index on disk
+                // Members not yet on disk. Faults are served from here
+                std::shared_ptr<members_t> inflight;
+                std::list<NodeView*>::iterator lru_pos; // If unpinned
+
+                Page() : offset(0), capacity(0), nindex(0), charged(0),
+                    pins(0), resident(true), loading(false), sorted(false) {
+                }
+        };
+
+        typedef std::pair<offset_t, std::shared_ptr<members_t> > write_t;
+
+        std::string fn;
+        int fd;
+        size_t budget; // Bytes
+        size_t resident_bytes;
+        offset_t next_offset;
+        std::unordered_map<NodeView*, Page> pages;
+        std::list<NodeView*> lru; // Resident, unpinned. Front is evicted first
+        size_t nfaults;
+        size_t nevictions;
+
+        // Writeback
+        std::queue<write_t> writes;
+        bool writing; // The writer is mid write
+        bool stop;
+        pthread_t writer;
+        pthread_mutex_t mutex;
+        pthread_mutexattr_t mutex_attr;
+        pthread_cond_t write_cond; // Work for the writer
+        pthread_cond_t drain_cond; // Writer went idle
+        pthread_cond_t load_cond; // A fault finished
+
+        void acquire_lock();
+        void release_lock();
+        static size_t nbytes(const sample_id_t nindex);
+        void make_room();
+        void charge(NodeView* node, Page& page);
+        void writeback(NodeView* node, Page& page);
+        size_t fault(NodeView* node, Page& page);
+
+        friend void* writeback_callback(void* arg);
+
+    public:
+        NodePager(const std::string fn, const size_t budget);
+
+        // Register a completed leaf. May evict other leaves
+        void add(NodeView* leaf);
+        // Fault `node` in if needed & keep it resident until unpinned.
+        //  Returns the bytes read from disk to do so
+        size_t pin(NodeView* node);
+        // Changes to the index while pinned (e.g. compaction) are accounted
+        //  for here
+        void unpin(NodeView* node);
+        // Write `node` back and drop it from memory unless it is pinned
+        void evict(NodeView* node);
+        // Block until all pending writes are on disk
+        void flush();
+
+        const bool is_resident(NodeView* node);
+        const size_t get_resident_bytes() const { return resident_bytes; }
+        const size_t get_budget() const { return budget; }
+        const size_t get_nfaults() const { return nfaults; }
+        const size_t get_nevictions() const { return nevictions; }
+        const std::string get_fn() const { return fn; }
+
+        ~NodePager();
+};
+
+} } // End monya::container
+#endif
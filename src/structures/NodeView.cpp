@@ -20,17 +20,20 @@
 #include "NodeView.hpp"
 #include "Query.hpp"
 #include "SampleVector.hpp"
+#include "Tombstone.hpp"
 
 #include <utility>
 #include <iostream>
 #include <algorithm>
 #include <parallel/algorithm>
 #include "../io/IO.hpp"
+#include "../io/ColumnCache.hpp"
+#include "../common/quantize.hpp"
 
 namespace monya {
     namespace container {
 
-    NodeView::NodeView() : depth(0) {
+    NodeView::NodeView() : comparator(0), depth(0), colcache(NULL) {
         req_indxs.resize(0);
     }
 
@@ -85,12 +88,55 @@ namespace monya {
             const data_t val) {
         data_index.append(idx, val);
     }
+
+    // Copy the members of data_index that have not been deleted to `live`.
+    //  Returns false (and leaves `live` empty) if there is nothing to drop.
+    bool NodeView::filter_deleted(const Tombstone& ts, IndexVector& live) {
+        size_t ndead = 0;
+        for (auto it = data_index.begin(); it != data_index.end(); ++it) {
+            if (ts.is_set(it->get_index()))
+                ndead++;
+        }
+
+        if (!ndead)
+            return false;
+
+        live.reserve(data_index.size() - ndead);
+        for (auto it = data_index.begin(); it != data_index.end(); ++it) {
+            if (!ts.is_set(it->get_index()))
+                live.append(*it);
+        }
+        live.set_sorted(data_index.is_sorted()); // Filtering keeps order
+        return true;
+    }
+
+    void NodeView::swap_data_index(IndexVector& other) {
+        data_index.swap(other);
+    }
+
+    // Internal nodes have handed their members to their children so only
+    //  leaves keep a data_index
+    void NodeView::release() {
+        std::vector<sample_id_t>().swap(req_indxs);
+        req_col.reset();
+
+        if (has_child()) {
+            IndexVector empty;
+            data_index.swap(empty);
+        } else {
+            data_index.shrink_to_fit();
+        }
+    }
     // End for data index
 
     void NodeView::set_ioer(io::IO* ioer) {
         this->ioer = ioer;
     }
 
+    void NodeView::set_colcache(io::ColumnCache* colcache) {
+        this->colcache = colcache;
+    }
+
     io::IO* NodeView::get_ioer() {
         assert(NULL != ioer);
         return ioer;
@@ -106,25 +152,53 @@ namespace monya {
 
     void NodeView::prep() {
         assert(req_indxs.size() == 1); // TODO: Impl
-        data_t* ret = ioer->get_col(req_indxs[0]);
+        if (!colcache) {
+            prep(ioer);
+            return;
+        }
+
+        // Shared with the other nodes & trees splitting on it
+        req_col = colcache->get(ioer, req_indxs[0]);
+        set_vals(&(*req_col)[0], ioer->shape().first);
+    }
+
+    template <typename T>
+    void NodeView::prep(io::BasicIO<T>* src) {
+        assert(req_indxs.size() == 1); // TODO: Impl
+        T* col = src->get_col(req_indxs[0]);
+        set_vals(col, src->shape().first);
+        if (src->get_orientation() == mat_orient_t::ROW)
+            delete [] col;
+#if 0
+        std::cout << "Printing full index after set:\n";
+        data_index.print();
+#endif
+    }
+
+    template <typename T>
+    void NodeView::set_vals(const T* col, const size_t nsamples) {
         // Check state of data_index to see if placeholder indexes are there
         if (data_index.empty()) {
-            data_index.set_indexes(ret, ioer->shape().first);
+            data_index.reserve(nsamples);
+            for (size_t i = 0; i < nsamples; i++)
+                data_index.append(i, static_cast<data_t>(col[i]));
         } else {
-            // TODO: Bad access pattern for ret vector..
+            // TODO: Bad access pattern for col vector..
             for (size_t i = 0; i < data_index.size(); i++) {
                 auto idx = data_index[i].get_index();
-                data_index[i].set_val(ret[idx]);
+                data_index[i].set_val(static_cast<data_t>(col[idx]));
             }
         }
+    }
 
-        if (ioer->get_orientation() == mat_orient_t::ROW)
-            delete [] ret;
-#if 0
-        std::cout << "Printing full index after set:\n";
-        data_index.print();
-#endif
+    template void NodeView::prep(io::BasicIO<float>*);
+    template void NodeView::prep(io::BasicIO<double>*);
+    template void NodeView::prep(io::BasicIO<uint8_t>*);
+    template void NodeView::prep(io::BasicIO<quantize::half_t>*);
 
+    void NodeView::prefetch() {
+        for (auto idx : req_indxs)
+            ioer->prefetch_col(idx);
     }
 
     void NodeView::sort_data_index(bool par) {
@@ -190,6 +264,7 @@ namespace monya {
      void NodeView::bestow(NodeView* node) {
          node->parent = this;
          node->set_ioer(ioer);
+         node->set_colcache(colcache);
          node->set_depth(depth+1);
 
          assert(node->parent->get_comparator() == get_comparator());
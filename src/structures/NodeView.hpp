@@ -19,6 +19,8 @@
 #ifndef MONYA_NODEVIEW_HPP__
 #define MONYA_NODEVIEW_HPP__
 
+#include <memory>
+
 #include "../common/types.hpp"
 #include "../common/exception.hpp"
 
@@ -28,14 +30,18 @@
 
 namespace monya {
     namespace io {
-        class IO;
+        template <typename T> class BasicIO;
+        typedef BasicIO<data_t> IO;
+        class ColumnCache;
     }
 
     namespace container {
 
 // Fwd decl
 class Query;
-class SampleVector;
+template <typename T> class BasicSampleVector;
+typedef BasicSampleVector<data_t> SampleVector;
+class Tombstone;
 
 // Represent a node in the tree
 #ifdef __unix__
@@ -53,9 +59,15 @@ class NodeView {
         // When the data required is in memory run this computation
         depth_t depth; // Depth of the node used as an idendifier
         io::IO* ioer;
+        io::ColumnCache* colcache; // NULL: prep() reads from the ioer
+        std::shared_ptr<const std::vector<data_t> > req_col; // Until release
         NodeView* parent;
         // TODO: End visibility
 
+        // Set data_index's values from a column of every sample
+        template <typename T>
+        void set_vals(const T* col, const size_t nsamples);
+
     public:
         data_t& get_comparator() { return comparator; }
 
@@ -100,6 +112,13 @@ class NodeView {
 
         // Defaults to grabbing index data
         virtual void prep();
+        // The split column from an IO of any element type, widened to the
+        //  data_t values of data_index. Instantiated for float, double,
+        //  uint8_t & half_t
+        template <typename T>
+        void prep(io::BasicIO<T>* src);
+        // Start loading what prep() will request without waiting on it
+        virtual void prefetch();
 
         // Request/Get Iterative index
         void set_index(const std::vector<sample_id_t>& indexes);
@@ -112,9 +131,17 @@ class NodeView {
         void data_index_append(const sample_id_t idx);
         void data_index_append(const sample_id_t idx, const data_t val=0);
 
+        // Drop build time state once the node is finished
+        virtual void release();
+
+        // Deletion support
+        bool filter_deleted(const Tombstone& ts, IndexVector& live);
+        void swap_data_index(IndexVector& other);
+
         // IO
         void set_ioer(io::IO* ioer);
         typename io::IO* get_ioer();
+        void set_colcache(io::ColumnCache* colcache);
 
         // Params
         void set_depth(depth_t depth);
@@ -19,7 +19,7 @@
 
 #include "Query.hpp"
 #include "BinaryNode.hpp"
-#include "../BinaryTreeProgram.hpp"
+#include "../TreeProgram.hpp"
 #include "SampleVector.hpp"
 #include "../common/NNVector.hpp"
 
@@ -50,7 +50,7 @@ namespace monya { namespace container {
 
     // Actually find what we're looking for!
     // Called by Compute Engine!
-    void ProximityQuery::run(BinaryTreeProgram* tp) {
+    void ProximityQuery::run(TreeProgram* tp) {
         assert(!qsample->empty());
         tp->find_neighbors(this);
     }
@@ -59,6 +59,71 @@ namespace monya { namespace container {
         return (*qsample)[idx];
     }
 
+    BatchProximityQuery::BatchProximityQuery(
+            std::vector<ProximityQuery*>& queries, const bool exact,
+            const size_t block) : queries(queries), exact(exact),
+    block(block) {
+        if (!block)
+            throw parameter_exception("BatchProximityQuery: block must be "
+                    "positive");
+    }
+
+    data_t& BatchProximityQuery::operator[](const size_t idx) {
+        throw not_implemented_exception(__FILE__, __LINE__);
+    }
+
+    void BatchProximityQuery::print() {
+        std::cout << "BatchProximityQuery:\n" << "# queries: " <<
+            queries.size() << "\nexact: " << exact << "\nblock: " <<
+            block << "\n";
+    }
+
+    void BatchProximityQuery::run(TreeProgram* tp) {
+        tp->find_neighbors_batch(this);
+    }
+
+    void BatchProximityQuery::clear_stats() {
+        for (auto query : queries)
+            query->clear_stats();
+    }
+
+    void BatchProximityQuery::record_stats(QueryHistograms& hists) {
+        for (auto query : queries)
+            query->record_stats(hists);
+    }
+
+    RangeQuery::RangeQuery(SampleVector* qsample, const data_t radius,
+            const tree_t ntree, const bool count_only, const size_t capacity)
+        : qsample(qsample), radius(radius), count_only(count_only),
+        counts(ntree, 0), result(ntree) {
+        if (radius < 0)
+            throw parameter_exception("RangeQuery: radius must be >= 0");
+        if (!count_only)
+            for (auto& matches : result)
+                matches.reserve(capacity);
+    }
+
+    void RangeQuery::clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (auto& matches : result)
+            matches.clear();
+    }
+
+    data_t& RangeQuery::operator[](const size_t idx) {
+        return (*qsample)[idx];
+    }
+
+    void RangeQuery::print() {
+        std::cout << "RangeQuery:\n" << "radius: " << radius <<
+            "\ncount only: " << count_only << "\nquery: ";
+        qsample->print(); std::cout << "\n";
+    }
+
+    void RangeQuery::run(TreeProgram* tp) {
+        assert(!qsample->empty());
+        tp->find_in_range(this);
+    }
+
     ProximityQuery::~ProximityQuery() {
         for (size_t i = 0; i < result.size(); i++)
             delete(result[i]);
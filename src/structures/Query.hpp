@@ -21,23 +21,31 @@
 #define MONYA_QUERY_HPP__
 
 #include "../common/types.hpp"
+#include "QueryStats.hpp"
 #include <memory>
+#include <vector>
 
 namespace monya {
-    class BinaryTreeProgram;
-    class NNVector;
+    class TreeProgram;
+    template <typename T> class BasicNNVector;
+    typedef BasicNNVector<data_t> NNVector;
     namespace container {
 
 class BinaryNode;
-class SampleVector;
+template <typename T> class BasicSampleVector;
+typedef BasicSampleVector<data_t> SampleVector;
 
 // Inherit from this class to query
 class Query {
 
     public:
         virtual void print() = 0;
-        virtual void run(BinaryTreeProgram* tpt) = 0;
+        virtual void run(TreeProgram* tpt) = 0;
         virtual data_t& operator[](const size_t idx) = 0;
+        // Queries that keep work counters zero them before a run & add them
+        //  to `hists` after
+        virtual void clear_stats() { }
+        virtual void record_stats(QueryHistograms& hists) { }
         virtual ~Query() { }
 };
 
@@ -48,6 +56,7 @@ class ProximityQuery: public Query {
         SampleVector* qsample;
         tree_t ntree;
         std::vector<NNVector*> result;
+        QueryStats stats;
 
     public:
 
@@ -76,12 +85,122 @@ class ProximityQuery: public Query {
             return result;
         }
 
+        // Bumped by the trees' find_neighbors
+        QueryStats& get_stats() {
+            return stats;
+        }
+
+        void clear_stats() override {
+            stats.clear();
+        }
+
+        void record_stats(QueryHistograms& hists) override {
+            hists.add(stats);
+        }
+
         void print() override;
 
         // Actually find what we're looking for
-        void run(BinaryTreeProgram* tp) override;
+        void run(TreeProgram* tp) override;
 
         ~ProximityQuery() override;
 };
+
+// Many ProximityQuery answered together so trees can share node & leaf
+//  accesses across them. Results land in each ProximityQuery
+class BatchProximityQuery: public Query {
+    private:
+        std::vector<ProximityQuery*> queries;
+        bool exact; // Else only the leaf each query falls into is scanned
+        size_t block; // # of queries carried down a tree together
+
+    public:
+        BatchProximityQuery(std::vector<ProximityQuery*>& queries,
+                const bool exact=true, const size_t block=64);
+
+        static BatchProximityQuery* raw_cast(Query* q) {
+            return static_cast<BatchProximityQuery*>(q);
+        }
+
+        std::vector<ProximityQuery*>& get_queries() {
+            return queries;
+        }
+
+        const bool is_exact() const { return exact; }
+        const size_t get_block() const { return block; }
+
+        void clear_stats() override;
+        void record_stats(QueryHistograms& hists) override;
+
+        data_t& operator[](const size_t idx) override;
+        void print() override;
+        void run(TreeProgram* tp) override;
+};
+// Every sample within `radius` of the query. Each tree's matches are kept
+//  apart like ProximityQuery's kNN. Count only queries never store matches,
+//  e.g. for density estimates
+class RangeQuery: public Query {
+    private:
+        SampleVector* qsample;
+        data_t radius;
+        bool count_only;
+        std::vector<size_t> counts; // Per tree
+        // Per tree. Capacity is kept across clear() so reused queries don't
+        //  reallocate
+        std::vector<std::vector<IndexVal<data_t> > > result;
+
+    public:
+        RangeQuery(SampleVector* qsample, const data_t radius,
+                const tree_t ntree, const bool count_only=false,
+                const size_t capacity=0);
+
+        static RangeQuery* raw_cast(Query* q) {
+            return static_cast<RangeQuery*>(q);
+        }
+
+        void set_qsample(SampleVector* qs) {
+            qsample = qs;
+        }
+
+        SampleVector* get_qsample() {
+            return qsample;
+        }
+
+        const data_t get_radius() const { return radius; }
+        void set_radius(const data_t radius) { this->radius = radius; }
+        const bool is_count_only() const { return count_only; }
+
+        // Keep `id` if it is within the radius
+        void eval(const sample_id_t id, const data_t dist,
+                const tree_t tree_id) {
+            if (dist > radius)
+                return;
+            counts[tree_id]++;
+            if (!count_only)
+                result[tree_id].push_back(IndexVal<data_t>(id, dist));
+        }
+
+        // `n` samples known to be within the radius without their distances
+        void count(const size_t n, const tree_t tree_id) {
+            assert(count_only);
+            counts[tree_id] += n;
+        }
+
+        const size_t get_count(const tree_t tree_id) const {
+            return counts[tree_id];
+        }
+
+        // Unordered
+        std::vector<IndexVal<data_t> >& get_result(const tree_t tree_id) {
+            return result[tree_id];
+        }
+
+        // Ready the query for another sample or radius
+        void clear();
+
+        data_t& operator[](const size_t idx) override;
+        void print() override;
+        void run(TreeProgram* tp) override;
+};
 } } // End namespace monya::container
 #endif
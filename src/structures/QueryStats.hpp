@@ -0,0 +1,159 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_QUERY_STATS_HPP__
+#define MONYA_QUERY_STATS_HPP__
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <cassert>
+
+namespace monya { namespace container {
+
+// The work one query did, summed over the trees it ran on
+struct QueryStats {
+    enum stat_t {
+        NODES, // Internal nodes visited
+        LEAVES, // Leaves scanned
+        DISTANCES, // Distance evaluations
+        PRUNED, // Subtrees (or leaves) skipped by a bound
+        IO_BYTES, // Sample rows & paged leaf indexes read
+        RESCORED, // Screened members recomputed exactly, a subset of DISTANCES
+        NSTAT
+    };
+
+    size_t counts[NSTAT];
+
+    QueryStats() { clear(); }
+
+    void clear() {
+        for (unsigned i = 0; i < NSTAT; i++)
+            counts[i] = 0;
+    }
+
+    size_t& operator[](const unsigned stat) { return counts[stat]; }
+    const size_t operator[](const unsigned stat) const { return counts[stat]; }
+
+    QueryStats& operator+=(const QueryStats& other) {
+        for (unsigned i = 0; i < NSTAT; i++)
+            counts[i] += other.counts[i];
+        return *this;
+    }
+
+    static const std::string name(const unsigned stat) {
+        static const char* names[NSTAT] = { "nodes", "leaves", "distances",
+            "pruned", "io_bytes", "rescored" };
+        return names[stat];
+    }
+};
+
+/**
+  \brief Power of two histograms of each QueryStats counter across many
+    queries. Bucket 0 holds zeros & bucket b holds [2^(b-1), 2^b)
+  */
+class QueryHistograms {
+    public:
+        static const unsigned NBUCKET = 8*sizeof(size_t) + 1;
+
+    private:
+        std::vector<size_t> buckets[QueryStats::NSTAT];
+        QueryStats totals;
+        size_t nquery;
+
+        static unsigned bucket(size_t val) {
+            unsigned b = 0;
+            for (; val; val >>= 1)
+                b++;
+            return b;
+        }
+
+    public:
+        QueryHistograms() : nquery(0) {
+            for (auto& hist : buckets)
+                hist.assign(NBUCKET, 0);
+        }
+
+        void add(const QueryStats& stats) {
+            for (unsigned s = 0; s < QueryStats::NSTAT; s++)
+                buckets[s][bucket(stats[s])]++;
+            totals += stats;
+            nquery++;
+        }
+
+        void clear() {
+            for (auto& hist : buckets)
+                std::fill(hist.begin(), hist.end(), 0);
+            totals.clear();
+            nquery = 0;
+        }
+
+        const size_t get_nquery() const { return nquery; }
+        const QueryStats& get_totals() const { return totals; }
+        const std::vector<size_t>& get_buckets(const unsigned stat) const {
+            return buckets[stat];
+        }
+
+        const double mean(const unsigned stat) const {
+            return nquery ? totals[stat] / (double)nquery : 0;
+        }
+
+        // Upper bound of the bucket holding the `p` quantile, p in [0, 1]
+        const size_t quantile(const unsigned stat, const double p) const {
+            assert(p >= 0 && p <= 1);
+            const size_t rank = p*nquery;
+            size_t seen = 0;
+            for (unsigned b = 0; b < NBUCKET; b++) {
+                seen += buckets[stat][b];
+                if (seen > rank || seen == nquery)
+                    return b ? ((size_t)1 << (b - 1))*2 - 1 : 0;
+            }
+            return 0;
+        }
+
+        // {"nquery": n, "<stat>": {"mean": m, "p50": .., "p99": ..,
+        //  "buckets": [...]}, ...}. Trailing empty buckets are dropped
+        void write_json(std::ostream& os) const {
+            os << "{\"nquery\": " << nquery;
+            for (unsigned s = 0; s < QueryStats::NSTAT; s++) {
+                unsigned nbucket = NBUCKET;
+                while (nbucket && !buckets[s][nbucket-1])
+                    nbucket--;
+
+                os << ", \"" << QueryStats::name(s) << "\": {\"mean\": " <<
+                    mean(s) << ", \"p50\": " << quantile(s, .5) <<
+                    ", \"p99\": " << quantile(s, .99) << ", \"buckets\": [";
+                for (unsigned b = 0; b < nbucket; b++)
+                    os << (b ? ", " : "") << buckets[s][b];
+                os << "]}";
+            }
+            os << "}";
+        }
+
+        void print(std::ostream& os) const {
+            os << "Query stats over " << nquery << " queries (mean/p50/p99):\n";
+            for (unsigned s = 0; s < QueryStats::NSTAT; s++)
+                os << "  " << QueryStats::name(s) << ": " << mean(s) << " / "
+                    << quantile(s, .5) << " / " << quantile(s, .99) << "\n";
+        }
+};
+
+} } // End namespace monya::container
+#endif
@@ -21,57 +21,67 @@
 #define MONYA_SAMPLE_VECTOR_HPP__
 
 #include <vector>
+#include <algorithm>
 #include "../common/types.hpp"
 #include "../io/IO.hpp"
 
 namespace monya { namespace container {
 
-    // An abstraction over a vector OR sparse vector
-    class SampleVector {
+    // An abstraction over a vector OR sparse vector of `T`
+    template <typename T>
+    class BasicSampleVector {
         public:
-            typedef SampleVector* raw_ptr;
+            typedef BasicSampleVector* raw_ptr;
 
-            SampleVector() { }
+            BasicSampleVector() { }
 
-            virtual data_t& operator[](size_t) = 0;
+            virtual T& operator[](size_t) = 0;
             virtual size_t size() = 0;
             virtual size_t nnz() = 0;
             virtual bool empty() = 0;
-            virtual void populate(data_t*, const size_t) { }
+            virtual void populate(T*, const size_t) { }
             virtual void print() = 0;
-            virtual data_t* raw_data() = 0;
+            virtual T* raw_data() = 0;
+            virtual T* dense() = 0; // All `size()` elements, as queries read
+            virtual ~BasicSampleVector() { }
     };
 
-    class DenseVector : public SampleVector {
+    template <typename T>
+    class BasicDenseVector : public BasicSampleVector<T> {
         private:
-            std::vector<data_t> data;
+            std::vector<T> data;
 
         public:
+            typedef typename BasicSampleVector<T>::raw_ptr raw_ptr;
 
             static raw_ptr create_raw() {
-                return new DenseVector;
+                return new BasicDenseVector;
             }
 
-            static raw_ptr create_raw(data_t* data, size_t nelem) {
-                return new DenseVector(data, nelem);
+            static raw_ptr create_raw(T* data, size_t nelem) {
+                return new BasicDenseVector(data, nelem);
             }
 
             static raw_ptr cast2(raw_ptr o) {
-                return static_cast<DenseVector*>(o);
+                return static_cast<BasicDenseVector*>(o);
             }
 
-            DenseVector() {
+            BasicDenseVector() {
             }
 
-            DenseVector(data_t* data, size_t nelem) {
+            BasicDenseVector(T* data, size_t nelem) {
                 populate(data, nelem);
             }
 
-            data_t& operator[](size_t idx) override {
+            T& operator[](size_t idx) override {
                 return data[idx];
             }
 
-            data_t* raw_data() override {
+            T* raw_data() override {
+                return &data[0];
+            }
+
+            T* dense() override {
                 return &data[0];
             }
 
@@ -87,7 +97,7 @@ namespace monya { namespace container {
                 return data.size();
             }
 
-            void populate(data_t* _data, const size_t nelem) override {
+            void populate(T* _data, const size_t nelem) override {
                 data.resize(nelem);
                 std::copy(_data, _data+nelem, data.begin());
             }
@@ -96,6 +106,132 @@ namespace monya { namespace container {
                 monya::io::print_arr(&data[0], data.size());
             }
     };
+
+    /**
+      \brief Only the nonzeros of a `size()` long vector, by ascending
+        dimension. `raw_data` holds the `nnz()` values & `get_indexes` their
+        dimensions. Indexing an absent dimension reads a zero; writing to it
+        has no effect. `dense` expands it on first use after a change; don't
+        call it on one vector from several threads
+      */
+    template <typename T>
+    class BasicSparseVector : public BasicSampleVector<T> {
+        private:
+            std::vector<feature_id_t> indexes;
+            std::vector<T> vals;
+            size_t nelem;
+            T zero;
+            std::vector<T> full; // Expanded by `dense`
+            bool stale; // `full` predates a change
+
+        public:
+            typedef typename BasicSampleVector<T>::raw_ptr raw_ptr;
+
+            static raw_ptr create_raw() {
+                return new BasicSparseVector;
+            }
+
+            static raw_ptr create_raw(T* data, size_t nelem) {
+                return new BasicSparseVector(data, nelem);
+            }
+
+            static BasicSparseVector* cast2(raw_ptr o) {
+                return static_cast<BasicSparseVector*>(o);
+            }
+
+            BasicSparseVector() : nelem(0), zero(0), stale(true) {
+            }
+
+            // Keep the nonzeros of a dense vector
+            BasicSparseVector(T* data, size_t nelem) : BasicSparseVector() {
+                populate(data, nelem);
+            }
+
+            BasicSparseVector(const feature_id_t* indexes, const T* vals,
+                    const size_t nnz, const size_t nelem) : BasicSparseVector() {
+                this->indexes.assign(indexes, indexes+nnz);
+                this->vals.assign(vals, vals+nnz);
+                this->nelem = nelem;
+                stale = true;
+            }
+
+            // Dimensions must be appended in ascending order
+            void append(const feature_id_t index, const T val) {
+                assert(index < nelem && (indexes.empty() ||
+                            index > indexes.back()));
+                indexes.push_back(index);
+                vals.push_back(val);
+                stale = true;
+            }
+
+            void resize(const size_t nelem) {
+                assert(indexes.empty() || indexes.back() < nelem);
+                this->nelem = nelem;
+                stale = true;
+            }
+
+            T& operator[](size_t idx) override {
+                auto it = std::lower_bound(indexes.begin(), indexes.end(),
+                        idx);
+                if (it == indexes.end() || *it != idx) {
+                    zero = 0;
+                    return zero;
+                }
+                stale = true; // May be written through
+                return vals[it - indexes.begin()];
+            }
+
+            T* raw_data() override {
+                return vals.empty() ? NULL : &vals[0];
+            }
+
+            T* dense() override {
+                if (stale) {
+                    full.assign(nelem, 0);
+                    for (size_t i = 0; i < vals.size(); i++)
+                        full[indexes[i]] = vals[i];
+                    stale = false;
+                }
+                return full.empty() ? NULL : &full[0];
+            }
+
+            const feature_id_t* get_indexes() const {
+                return indexes.empty() ? NULL : &indexes[0];
+            }
+
+            size_t size() override {
+                return nelem;
+            }
+
+            bool empty() override {
+                return nelem == 0;
+            }
+
+            size_t nnz() override {
+                return vals.size();
+            }
+
+            void populate(T* data, const size_t nelem) override {
+                indexes.clear();
+                vals.clear();
+                this->nelem = nelem;
+                stale = true;
+                for (size_t i = 0; i < nelem; i++)
+                    if (data[i] != 0)
+                        append(i, data[i]);
+            }
+
+            void print() override {
+                std::cout << "[ ";
+                for (size_t i = 0; i < vals.size(); i++)
+                    std::cout << indexes[i] << ":" << vals[i] << " ";
+                std::cout << "] (" << nelem << ")\n";
+            }
+    };
+
+    typedef BasicSampleVector<data_t> SampleVector;
+    typedef BasicDenseVector<data_t> DenseVector;
+    typedef BasicSparseVector<data_t> SparseVector;
 } }
 
 #endif
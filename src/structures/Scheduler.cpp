@@ -42,12 +42,17 @@ namespace monya { namespace container {
             pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK);
             pthread_mutex_init(&mutex, &mutex_attr);
             pthread_cond_init(&cond, NULL);
+            pthread_rwlock_init(&index_lock, NULL);
             pending_threads = nthread;
+            INSTR(trace = new utils::BuildTrace(tree_id, nthread));
 
             for (unsigned tid = 0; tid < nthread; tid++) {
                 threads.push_back(new WorkerThread(numa_id, tid));
                 threads.back()->set_parent_cond(&cond);
+                threads.back()->set_parent_lock(&mutex);
                 threads.back()->set_parent_pending_threads(&pending_threads);
+                threads.back()->set_index_lock(&index_lock);
+                INSTR(threads.back()->set_recorder(trace->get_recorder(tid)));
                 threads.back()->init();
             }
 
@@ -75,34 +80,50 @@ namespace monya { namespace container {
         }
     }
 
-    void Scheduler::run_level(const depth_t level) {
-        if (tree_id == 0) printf("Running level: %lu\n", level);
-
-        std::vector<NodeView*> level_nodes = nodes[level];
+    void Scheduler::schedule(std::vector<NodeView*>& level_nodes) {
+        pthread_mutex_lock(&mutex);
+        assert(current_level == nodes.size()); // No partial level pending
+        nodes.push_back(level_nodes);
+        current_level++;
+        pthread_mutex_unlock(&mutex);
 
-        // All worker thread created and in waiting state initially
-        assert(level_nodes.size());
+        run_level(current_level-1);
+    }
 
+    void Scheduler::distribute(std::vector<NodeView*>& tasks) {
         cunsigned tid(threads.size());
         size_t task_index = 0;
         size_t ntasks;
 
         // circular buffer the threads
         while (true) {
-            ntasks = task_index + MIN_TASKS_PT < level_nodes.size() + 1 ?
-                MIN_TASKS_PT : level_nodes.size() - task_index;
+            ntasks = task_index + MIN_TASKS_PT < tasks.size() + 1 ?
+                MIN_TASKS_PT : tasks.size() - task_index;
 
                 threads[tid.get()]->get_task_queue()->enqueue(
-                        &level_nodes[task_index], ntasks);
+                        &tasks[task_index], ntasks);
                 tid.inc();
                 task_index += ntasks;
-                if (task_index == level_nodes.size())
+                if (task_index == tasks.size())
                     break;
         }
+    }
+
+    void Scheduler::run_level(const depth_t level) {
+        if (tree_id == 0) printf("Running level: %lu\n", level);
+
+        std::vector<NodeView*> level_nodes = nodes[level];
+
+        // All worker thread created and in waiting state initially
+        assert(level_nodes.size());
+        distribute(level_nodes);
 
         // Run nodes in current level
+        INSTR(trace->begin_level(level));
+        INSTR(double start = utils::now());
         wake4run(BUILD);
         wait4completion(); // TODO: Level-wise barrier not necessary
+        INSTR(trace->end_level(level, start, utils::now()));
 #if 0
         std::this_thread::sleep_for(std::chrono::seconds(1));
         printf("NODES AFTER:\n");
@@ -111,6 +132,37 @@ namespace monya { namespace container {
 #endif
     }
 
+    void Scheduler::compact(std::vector<NodeView*>& tasks,
+            NodePager* pager) {
+        if (tasks.empty())
+            return;
+
+        for (auto thread : threads)
+            thread->set_pager(pager);
+        distribute(tasks);
+        wake4run(COMPACT);
+        wait4completion();
+    }
+
+    void Scheduler::set_tombstones(const Tombstone* tombstones) {
+        for (auto thread : threads)
+            thread->set_tombstones(tombstones);
+    }
+
+    void Scheduler::acquire_read_lock() {
+        int rc = pthread_rwlock_rdlock(&index_lock);
+        if (rc)
+            throw concurrency_exception("pthread_rwlock_rdlock", rc,
+                    __FILE__, __LINE__);
+    }
+
+    void Scheduler::release_read_lock() {
+        int rc = pthread_rwlock_unlock(&index_lock);
+        if (rc)
+            throw concurrency_exception("pthread_rwlock_unlock", rc,
+                    __FILE__, __LINE__);
+    }
+
     void Scheduler::wake4run(const ThreadState_t state) {
         for (auto thread : threads)
             thread->wake(state);
@@ -141,9 +193,11 @@ namespace monya { namespace container {
     }
 
     Scheduler::~Scheduler() {
+        destroy_threads(); // Joins them. They use the members below
         pthread_mutex_destroy(&mutex);
         pthread_mutexattr_destroy(&mutex_attr);
         pthread_cond_destroy(&cond);
-        destroy_threads();
+        pthread_rwlock_destroy(&index_lock);
+        INSTR(delete trace);
     }
 } } // End namespace monya::container
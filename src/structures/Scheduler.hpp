@@ -27,6 +27,7 @@
 
 #include "ThreadState.hpp"
 #include "../common/types.hpp"
+#include "../utils/instrument.hpp"
 
 namespace monya {
     class WorkerThread;
@@ -34,6 +35,8 @@ namespace monya {
     namespace container {
 
     class NodeView;
+    class Tombstone;
+    class NodePager;
 
     class Scheduler {
 
@@ -52,6 +55,13 @@ namespace monya {
             pthread_mutexattr_t mutex_attr;
             pthread_cond_t cond;
             std::atomic<unsigned> pending_threads;
+            // Readers (queries) share, compaction swaps node indexes
+            pthread_rwlock_t index_lock;
+#ifdef MONYA_INSTRUMENT
+            utils::BuildTrace* trace;
+#endif
+
+            void distribute(std::vector<NodeView*>& tasks);
 
         public:
             Scheduler(unsigned fanout, depth_t max_depth,
@@ -67,6 +77,11 @@ namespace monya {
               */
             void schedule(NodeView* node);
 
+            /**
+              \brief Add a whole level & run it. Levels need not be full
+              */
+            void schedule(std::vector<NodeView*>& level_nodes);
+
             /**
               \brief Handoff nodes to threads
               */
@@ -75,6 +90,16 @@ namespace monya {
             void wait4completion();
             void destroy_threads();
 
+            /**
+              \brief Drop deleted samples from `tasks` using the worker threads.
+                Leaves registered with `pager` are pinned while rewritten
+              */
+            void compact(std::vector<NodeView*>& tasks,
+                    NodePager* pager=NULL);
+            void set_tombstones(const Tombstone* tombstones);
+            void acquire_read_lock();
+            void release_read_lock();
+
             const depth_t get_max_depth() const { return max_levels; }
             const depth_t get_current_level() const { return current_level; }
             std::vector<NodeView*>& get_nodes(const unsigned level) {
@@ -85,9 +110,43 @@ namespace monya {
                 return threads.size();
             }
 
+#ifdef MONYA_INSTRUMENT
+            // Read only once the levels being inspected have completed
+            const utils::BuildTrace& get_trace() const {
+                return *trace;
+            }
+#endif
 
 
             ~Scheduler();
     };
+
+    /**
+      \brief Holds a scheduler's read lock for its scope. Compaction takes
+        the write lock to swap leaves' indexes, possibly from another
+        thread (ComputeEngine::compact_async), so anything reading a tree's
+        nodes or leaf indexes after training (queries, knn_graph) holds a
+        ReadGuard on that tree's scheduler for as long as it reads
+      */
+    class ReadGuard {
+        private:
+            Scheduler* scheduler;
+
+        public:
+            ReadGuard(Scheduler* scheduler) : scheduler(scheduler) {
+                scheduler->acquire_read_lock();
+            }
+
+            ReadGuard(const ReadGuard&) = delete;
+            ReadGuard& operator=(const ReadGuard&) = delete;
+
+            ~ReadGuard() {
+                try {
+                    scheduler->release_read_lock();
+                } catch (std::exception& e) { // A concurrency_exception
+                    std::cerr << e.what() << std::endl;
+                }
+            }
+    };
 } } // End namespace monya::container
 #endif
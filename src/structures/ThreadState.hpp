@@ -28,6 +28,7 @@ namespace monya {
         TEST, /* Just for testing*/
         BUILD, /* Tree building moving data for reduces rma*/
         QUERY, /* Querying the tree */
+        COMPACT, /* Dropping deleted samples from nodes */
         WAIT, /* When the thread is waiting for a new task*/
         EXIT /* Say goodnight */
     };
@@ -42,6 +43,8 @@ namespace monya {
                         return "BUILD";
                     case QUERY:
                         return "QUERY";
+                    case COMPACT:
+                        return "COMPACT";
                     case WAIT:
                         return "WAIT";
                     case EXIT:
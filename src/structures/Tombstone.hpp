@@ -0,0 +1,86 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_TOMBSTONE_HPP__
+#define MONYA_TOMBSTONE_HPP__
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "../common/types.hpp"
+#include "../common/exception.hpp"
+
+namespace monya { namespace container {
+
+/**
+  * Bitmap of deleted samples shared by all trees in a forest. Deleting only
+  *  sets a bit so it is safe to call while queries run. Queries skip marked
+  *  samples in the leaf scan until a compaction physically drops them.
+  */
+class Tombstone {
+    private:
+        std::vector<std::atomic<uint64_t> > bits;
+        std::atomic<size_t> ndeleted;
+        size_t nsamples;
+
+    public:
+        typedef Tombstone* raw_ptr;
+
+        Tombstone(const size_t nsamples) : bits((nsamples + 63) / 64),
+            ndeleted(0), nsamples(nsamples) {
+            for (size_t i = 0; i < bits.size(); i++)
+                bits[i].store(0);
+        }
+
+        // Returns false if `id` was already deleted
+        bool set(const sample_id_t id) {
+            if (id >= nsamples)
+                throw parameter_exception("Tombstone::set sample id out of "
+                        "range", id);
+
+            const uint64_t mask = static_cast<uint64_t>(1) << (id & 63);
+            if (bits[id >> 6].fetch_or(mask) & mask)
+                return false;
+
+            ndeleted++;
+            return true;
+        }
+
+        // Hot path: called for every member of every leaf scanned
+        const bool is_set(const sample_id_t id) const {
+            return (bits[id >> 6].load(std::memory_order_relaxed) >>
+                    (id & 63)) & 1;
+        }
+
+        const size_t count() const {
+            return ndeleted.load();
+        }
+
+        const bool empty() const {
+            return count() == 0;
+        }
+
+        const size_t size() const {
+            return nsamples;
+        }
+};
+
+} } // End monya::container
+#endif
@@ -21,6 +21,8 @@
 #include "TaskQueue.hpp"
 #include "../common/exception.hpp"
 #include "NodeView.hpp"
+#include "Tombstone.hpp"
+#include "NodePager.hpp"
 
 #ifdef USE_NUMA
 #include <numa.h>
@@ -28,13 +30,16 @@
 
 #include <thread>
 #include <chrono>
+#include <cstring>
 
 //#define VERB 1
 
 namespace monya {
 
     WorkerThread::WorkerThread(const int _node_id, const int _thd_id) :
-        node_id(_node_id), thd_id(_thd_id), state(WAIT) {
+        node_id(_node_id), thd_id(_thd_id), parent_lock(NULL), state(WAIT),
+        tombstones(NULL), index_lock(NULL), pager(NULL) {
+        INSTR(recorder = NULL);
 
 #ifdef VERB
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -74,6 +79,10 @@ namespace monya {
 #endif
         acquire_state_lock("wait");
         set_state(WAIT);
+
+        // Under the parent's lock or the last signal can land between its
+        //  check of the pending threads & its wait, stalling it forever
+        if (parent_lock) pthread_mutex_lock(parent_lock);
         dec_ppt();
 
         if (*parent_pending_threads == 0) {
@@ -81,6 +90,7 @@ namespace monya {
             if (rc) throw concurrency_exception("pthread_cond_signal", rc,
                     __FILE__, __LINE__);
         }
+        if (parent_lock) pthread_mutex_unlock(parent_lock);
 
         while (state == WAIT) {
             int rc = pthread_cond_wait(&cond, &state_lock);
@@ -126,19 +136,28 @@ namespace monya {
             case TEST:
                 test();
                 break;
-            case BUILD:
+            case BUILD: {
+                INSTR(double t = utils::now());
                 request_task();
+                INSTR(t = recorder->dequeued(t));
                 while (active_node) {
                     // TODO: Combine into some meta-method
                     active_node->prep();
+                    INSTR(t = recorder->prepped(t));
                     active_node->run();
+                    INSTR(t = recorder->ran(t));
                     request_task(); // Keep requesting tasks
+                    INSTR(t = recorder->dequeued(t));
                 }
                 break;
+            }
             case QUERY:
                 // TODO
                 throw not_implemented_exception(__FILE__, __LINE__);
                 break;
+            case COMPACT:
+                compact();
+                break;
             case EXIT:
                 throw concurrency_exception("Thread state: EXIT but running!\n",
                         911, __FILE__, __LINE__);
@@ -153,6 +172,37 @@ namespace monya {
 #endif
     }
 
+    /**
+      * Rewrite the data_index of each node in the queue without the deleted
+      *  samples. The filtering pass holds no lock so queries keep running;
+      *  only the O(1) swap of the new index is done under the write lock.
+      *  Paged leaves are pinned throughout so they are faulted in rather
+      *  than skipped & can't be evicted mid filter.
+      */
+    void WorkerThread::compact() {
+        assert(NULL != tombstones && NULL != index_lock);
+
+        request_task();
+        while (active_node) {
+            if (pager) pager->pin(active_node);
+            IndexVector live;
+            if (active_node->filter_deleted(*tombstones, live)) {
+                int rc = pthread_rwlock_wrlock(index_lock);
+                if (rc) throw concurrency_exception("pthread_rwlock_wrlock",
+                        rc, __FILE__, __LINE__);
+
+                active_node->swap_data_index(live);
+
+                rc = pthread_rwlock_unlock(index_lock);
+                if (rc) throw concurrency_exception("pthread_rwlock_unlock",
+                        rc, __FILE__, __LINE__);
+            }
+            if (pager) pager->unpin(active_node); // Accounts for the shrink
+            // `live` now holds the old index & is freed outside the lock
+            request_task();
+        }
+    }
+
     void WorkerThread::test() {
 #ifdef VERB
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -178,6 +228,7 @@ namespace monya {
 #if 1
         t->bind2node_id();
 #endif
+        INSTR(utils::local_recorder() = t->recorder);
         while (true) { // So we can receive task after task
             if (t->get_state() == WAIT)
                 t->wait();
@@ -274,6 +325,16 @@ namespace monya {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
         printf("\n****t: %d, dtor****\n", thd_id);
 #endif
+        // Callers wake the thread to EXIT first. It must be gone before its
+        //  lock & cond are destroyed or it can outlive its parent's memory
+        int rc = pthread_join(hw_thd, NULL);
+        if (rc) {
+            // Destructors can't throw. A thread we couldn't join may still
+            //  use its lock, cond & queue so leak them rather than free them
+            fprintf(stderr, "[ERROR]: WorkerThread %d pthread_join: %s\n",
+                    thd_id, strerror(rc));
+            return;
+        }
 
         pthread_cond_destroy(&cond);
         pthread_mutex_destroy(&state_lock);
@@ -28,6 +28,7 @@
 
 #include "ThreadState.hpp"
 #include "../common/exception.hpp"
+#include "../utils/instrument.hpp"
 
 #define MIN_BUILD_TASKS 2 // TODO: Make config
 
@@ -35,6 +36,8 @@ namespace monya {
     namespace container {
         class BuildTaskQueue;
         class NodeView;
+        class Tombstone;
+        class NodePager;
     }
 
 class WorkerThread {
@@ -48,6 +51,7 @@ protected:
     pthread_mutexattr_t mutex_attr;
 
     pthread_cond_t* parent_cond;
+    pthread_mutex_t* parent_lock; // Held by the parent checking pending
     std::atomic<unsigned>* parent_pending_threads;
     ThreadState_t state;
 
@@ -56,6 +60,15 @@ protected:
     container::NodeView* active_node;
     pthread_key_t thread_key;
 
+    // Unique to compaction
+    const container::Tombstone* tombstones;
+    pthread_rwlock_t* index_lock; // Guards swapping a node's data_index
+    container::NodePager* pager; // Pins paged leaves. May be NULL
+
+#ifdef MONYA_INSTRUMENT
+    utils::ThreadRecorder* recorder; // Owned by the parent's BuildTrace
+#endif
+
     friend void* callback(void* arg);
 
     void set_state(const ThreadState_t state) {
@@ -78,6 +91,7 @@ public:
     virtual void run();
     virtual void wait();
     void request_task();
+    void compact();
 
     // Class that
     virtual void set_driver(void* driver);
@@ -116,10 +130,33 @@ public:
         this->parent_cond = parent_cond;
     }
 
+    void set_parent_lock(pthread_mutex_t* parent_lock) {
+        this->parent_lock = parent_lock;
+    }
+
     void set_parent_pending_threads(std::atomic<unsigned>* ppt) {
         parent_pending_threads = ppt;
     }
 
+    void set_tombstones(const container::Tombstone* tombstones) {
+        this->tombstones = tombstones;
+    }
+
+    void set_index_lock(pthread_rwlock_t* index_lock) {
+        this->index_lock = index_lock;
+    }
+
+    void set_pager(container::NodePager* pager) {
+        this->pager = pager;
+    }
+
+#ifdef MONYA_INSTRUMENT
+    // Must be set before `init` as the thread binds it on start
+    void set_recorder(utils::ThreadRecorder* recorder) {
+        this->recorder = recorder;
+    }
+#endif
+
     virtual ~WorkerThread();
 };
 }
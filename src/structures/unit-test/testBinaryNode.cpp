@@ -18,6 +18,8 @@
  */
 
 #include "BinaryNode.hpp"
+#include "../../io/IO.hpp"
+#include "../../common/quantize.hpp"
 
 namespace mc = monya::container;
 
@@ -49,6 +51,41 @@ int main(int argc, char* argv[]) {
     assert(*root->left->right == *right);
     assert(*root->right->left == *left);
 
+    // A single parent shared with NodeView
+    left->parent = root;
+    assert(left->get_parent() == root);
+
+    // Finished internal nodes drop their members, leaves keep theirs
+    root->left->right = root->right->left = NULL;
+    left->left = left->right = right->left = right->right = NULL;
+    for (monya::sample_id_t i = 0; i < 8; i++) {
+        root->data_index_append(i, i);
+        left->data_index_append(i, i);
+    }
+    root->release();
+    left->release();
+    assert(root->get_data_index().empty());
+    assert(left->get_data_index().size() == 8);
+
+    // Byte & half columns widen to the node's values
+    uint8_t bytes[] = { 9, 0, 255, 7, 1, 128 }; // 3 x 2, row major
+    monya::io::BasicMemoryIO<uint8_t> bio(bytes, monya::dimpair(3, 2),
+            monya::ROW);
+    right->set_index(1);
+    right->prep(&bio);
+    assert(right->get_data_index().size() == 3);
+    for (monya::sample_id_t i = 0; i < 3; i++)
+        assert(right->get_data_index()[i].get_index() == i &&
+                right->get_data_index()[i].get_val() == bytes[i*2+1]);
+
+    std::vector<monya::quantize::half_t> halves = { -1.5, 2, 0.25 };
+    monya::io::BasicMemoryIO<monya::quantize::half_t> hio(&halves[0],
+            monya::dimpair(3, 1), monya::COL);
+    right->set_index(0);
+    right->prep(&hio); // Placeholder indexes keep their order
+    assert(right->get_data_index()[1].get_val() == 2);
+    assert(right->get_data_index()[2].get_val() == 0.25);
+
     delete(left);
     delete(right);
     delete(root);
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <cstdio>
+#include <fstream>
+#include <type_traits>
+
+#include "../EMNode.hpp"
+#include "../BinaryNode.hpp"
+#include "../Query.hpp"
+#include "../SampleVector.hpp"
+#include "../Tombstone.hpp"
+#include "../../common/NNVector.hpp"
+#include "../../common/distance.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 64;
+constexpr size_t NFEATURES = 2;
+constexpr depth_t DEPTH = 3;
+
+class TestNode : public container::BinaryNode {
+    public:
+        unsigned split_dim;
+
+        TestNode() : split_dim(0) {
+            parent = left = right = NULL;
+        }
+
+        void to_em(container::EMNode& em) override {
+            container::BinaryNode::to_em(em);
+            em.split_dim = split_dim;
+        }
+};
+
+// Median split alternating dims. Left holds <= comparator
+void build(TestNode* node, std::vector<sample_id_t> idxs,
+        std::vector<data_t>& data, const depth_t depth) {
+    if (depth == DEPTH) {
+        node->set_ph_data_index(idxs);
+        return;
+    }
+
+    node->split_dim = depth % NFEATURES;
+    std::sort(idxs.begin(), idxs.end(),
+            [&](sample_id_t a, sample_id_t b) {
+            return data[a*NFEATURES+node->split_dim] <
+                data[b*NFEATURES+node->split_dim]; });
+
+    const size_t half = idxs.size() / 2;
+    node->set_comparator(data[idxs[half-1]*NFEATURES+node->split_dim]);
+
+    TestNode* l = new TestNode();
+    TestNode* r = new TestNode();
+    node->left = l;
+    node->right = r;
+    build(l, std::vector<sample_id_t>(idxs.begin(), idxs.begin()+half),
+            data, depth+1);
+    build(r, std::vector<sample_id_t>(idxs.begin()+half, idxs.end()),
+            data, depth+1);
+}
+
+static_assert(!std::is_copy_constructible<container::EMForest>::value &&
+        !std::is_copy_assignable<container::EMForest>::value,
+        "EMForest owns its mapping");
+
+// Mapping `fn` cut to `nbytes` fails cleanly
+bool rejects_truncated(const std::string fn, const size_t nbytes) {
+    std::ifstream ifs(fn, std::ifstream::binary);
+    std::vector<char> buf(nbytes);
+    ifs.read(&buf[0], nbytes);
+
+    const std::string cut = fn + ".cut";
+    std::ofstream(cut, std::ofstream::binary).write(&buf[0], nbytes);
+    bool thrown = false;
+    try {
+        container::EMForest::create(cut);
+    } catch (io_exception& e) {
+        thrown = true;
+    }
+    std::remove(cut.c_str());
+    return thrown;
+}
+
+void destroy(container::BinaryNode* node) {
+    if (!node) return;
+    destroy(node->left);
+    destroy(node->right);
+    delete node;
+}
+}
+
+int main(int argc, char* argv[]) {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<data_t> distribution(-10, 10);
+
+    std::vector<data_t> data;
+    for (size_t i = 0; i < NSAMPLES*NFEATURES; i++)
+        data.push_back(distribution(generator));
+
+    std::vector<sample_id_t> idxs;
+    for (sample_id_t i = 0; i < NSAMPLES; i++)
+        idxs.push_back(i);
+
+    TestNode* root = new TestNode();
+    build(root, idxs, data, 0);
+
+    const std::string fn = "test_forest.bin";
+    std::vector<container::BinaryNode*> roots { root, root };
+    container::EMForest::write(fn, roots, NFEATURES);
+
+    container::EMForest::ptr forest = container::EMForest::create(fn);
+    assert(forest->ntree() == 2);
+    assert(forest->get_nfeatures() == NFEATURES);
+
+    const container::EMTree& tree = forest->get_tree(1);
+    assert(tree.get_nnodes() == std::pow(2, DEPTH+1) - 1);
+    assert(tree.get_nindex() == NSAMPLES);
+    assert(!tree.has_bounds());
+    assert(tree.get_node(0).comparator == root->get_comparator());
+    assert(tree.get_node(0).split_dim == 0);
+    assert(tree.get_node(tree.get_node(0).left).split_dim == 1);
+
+    // Every sample descends to the leaf holding it
+    for (sample_id_t sid = 0; sid < NSAMPLES; sid++) {
+        node_id_t leaf = tree.descend(&data[sid*NFEATURES]);
+        const sample_id_t* members = tree.get_index(leaf);
+        const sample_id_t nmembers = tree.get_node(leaf).nindex;
+        assert(std::find(members, members+nmembers, sid) !=
+                members+nmembers);
+    }
+
+    // Exact kNN from the mapped tree
+    io::IO* ioer = new io::MemoryIO(&data[0], dimpair(NSAMPLES, NFEATURES),
+            mat_orient_t::ROW);
+    constexpr short k = 5;
+    for (sample_id_t sid = 0; sid < NSAMPLES; sid += 7) {
+        container::DenseVector qsample(&data[sid*NFEATURES], NFEATURES);
+        container::ProximityQuery query(&qsample, k, 1);
+        tree.find_neighbors(&query, ioer, 0);
+
+        std::vector<data_t> dists;
+        for (sample_id_t i = 0; i < NSAMPLES; i++)
+            dists.push_back(distance::euclidean(&data[sid*NFEATURES],
+                        &data[i*NFEATURES], NFEATURES));
+        std::sort(dists.begin(), dists.end());
+
+        NNVector* nnv = query.getNN()[0];
+        assert(nnv->size() == (size_t)k);
+        for (short i = 0; i < k; i++)
+            assert((*nnv)[i].get_val() == dists[i]);
+
+        // Without bounds nothing is pruned & every sample is compared
+        container::QueryStats& stats = query.get_stats();
+        assert(stats[container::QueryStats::NODES] ==
+                std::pow(2, DEPTH) - 1);
+        assert(stats[container::QueryStats::LEAVES] == std::pow(2, DEPTH));
+        assert(stats[container::QueryStats::DISTANCES] == NSAMPLES);
+        assert(stats[container::QueryStats::PRUNED] == 0);
+    }
+    delete ioer;
+
+    // Deleted samples aren't persisted
+    container::Tombstone tombstones(NSAMPLES);
+    for (sample_id_t sid = 0; sid < NSAMPLES; sid += 3)
+        tombstones.set(sid);
+    const std::string live_fn = "test_forest_live.bin";
+    container::EMForest::write(live_fn, roots, NFEATURES,
+            std::vector<container::NodePager*>(), &tombstones);
+    {
+        container::EMForest::ptr live = container::EMForest::create(live_fn);
+        const container::EMTree& live_tree = live->get_tree(0);
+        assert(live_tree.get_nindex() == NSAMPLES - tombstones.count());
+        for (node_id_t id = 0; id < live_tree.get_nnodes(); id++) {
+            const container::EMNode& node = live_tree.get_node(id);
+            for (sample_id_t i = 0; node.is_leaf() && i < node.nindex; i++)
+                assert(!tombstones.is_set(live_tree.get_index(id)[i]));
+        }
+    }
+    assert(!std::remove(live_fn.c_str()));
+
+    // Offsets & counts past the end of a truncated file are caught
+    std::ifstream ifs(fn, std::ifstream::binary | std::ifstream::ate);
+    const size_t nbytes = ifs.tellg();
+    ifs.close();
+    for (size_t cut : { (size_t)40, nbytes/4, nbytes/2, nbytes - 8 })
+        assert(rejects_truncated(fn, cut));
+
+    destroy(root);
+    assert(!std::remove(fn.c_str()));
+    printf("EMNode persistence test successful!\n");
+    return EXIT_SUCCESS;
+}
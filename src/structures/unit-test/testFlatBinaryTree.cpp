@@ -0,0 +1,155 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <algorithm>
+
+#include "../FlatBinaryTree.hpp"
+#include "../BinaryNode.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 100;
+constexpr size_t NFEATURES = 3;
+constexpr depth_t DEPTH = 4;
+
+class TestNode : public container::BinaryNode {
+    public:
+        unsigned split_dim;
+
+        TestNode() : split_dim(0) {
+            parent = left = right = NULL;
+        }
+
+        void to_em(container::EMNode& em) override {
+            container::BinaryNode::to_em(em);
+            em.split_dim = split_dim;
+        }
+};
+
+// Median split cycling through dims. Left holds <= comparator. Nodes with
+//  fewer than 4 samples only get a left child
+void build(TestNode* node, std::vector<sample_id_t> idxs,
+        std::vector<data_t>& data, const depth_t depth) {
+    if (depth == DEPTH || idxs.size() < 2) {
+        node->set_ph_data_index(idxs);
+        return;
+    }
+
+    node->split_dim = depth % NFEATURES;
+    std::sort(idxs.begin(), idxs.end(),
+            [&](sample_id_t a, sample_id_t b) {
+            return data[a*NFEATURES+node->split_dim] <
+                data[b*NFEATURES+node->split_dim]; });
+
+    if (idxs.size() < 4) {
+        node->set_comparator(data[idxs.back()*NFEATURES+node->split_dim]);
+        node->left = new TestNode();
+        build(static_cast<TestNode*>(node->left), idxs, data, depth+1);
+        return;
+    }
+
+    const size_t half = idxs.size() / 2;
+    node->set_comparator(data[idxs[half-1]*NFEATURES+node->split_dim]);
+    node->left = new TestNode();
+    node->right = new TestNode();
+    build(static_cast<TestNode*>(node->left),
+            std::vector<sample_id_t>(idxs.begin(), idxs.begin()+half),
+            data, depth+1);
+    build(static_cast<TestNode*>(node->right),
+            std::vector<sample_id_t>(idxs.begin()+half, idxs.end()),
+            data, depth+1);
+}
+
+container::BinaryNode* pointer_descend(TestNode* node, const data_t* sample) {
+    while (node->has_child()) {
+        container::BinaryNode* next =
+            sample[node->split_dim] > node->get_comparator() ?
+            node->right : node->left;
+        if (NULL == next)
+            return NULL;
+        node = static_cast<TestNode*>(next);
+    }
+    return node;
+}
+
+void destroy(container::BinaryNode* node) {
+    if (!node) return;
+    destroy(node->left);
+    destroy(node->right);
+    delete node;
+}
+}
+
+int main(int argc, char* argv[]) {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<data_t> distribution(-10, 10);
+
+    std::vector<data_t> data;
+    for (size_t i = 0; i < NSAMPLES*NFEATURES; i++)
+        data.push_back(distribution(generator));
+
+    std::vector<sample_id_t> idxs;
+    for (sample_id_t i = 0; i < NSAMPLES; i++)
+        idxs.push_back(i);
+
+    TestNode* root = new TestNode();
+    build(root, idxs, data, 0);
+
+    container::FlatBinaryTree::ptr flat =
+        container::FlatBinaryTree::create(root);
+    assert(flat->get_node(0).comparator == root->get_comparator());
+    assert(flat->get_node(0).split_dim == root->split_dim);
+    assert(flat->get_node(flat->get_node(0).child).split_dim == 1);
+
+    // Every sample lands in the leaf holding it, as in the pointer tree
+    size_t nmembers = 0;
+    for (sample_id_t sid = 0; sid < NSAMPLES; sid++) {
+        const data_t* sample = &data[sid*NFEATURES];
+        const container::FlatNode& node =
+            flat->get_node(flat->descend(sample));
+        assert(node.is_leaf());
+
+        container::BinaryNode* leaf = flat->get_leaf(node);
+        assert(leaf == pointer_descend(root, sample));
+        assert(NULL != leaf);
+
+        IndexVector& members = leaf->get_data_index();
+        bool found = false;
+        for (auto it = members.begin(); it != members.end(); ++it)
+            found |= it->get_index() == sid;
+        assert(found);
+    }
+
+    // All members are reachable through the leaves
+    for (node_id_t id = 0; id < flat->get_nnodes(); id++) {
+        const container::FlatNode& node = flat->get_node(id);
+        if (node.is_leaf() && flat->get_leaf(node))
+            nmembers += flat->get_leaf(node)->get_data_index().size();
+    }
+    assert(nmembers == NSAMPLES);
+
+    container::FlatBinaryTree empty(NULL);
+    assert(empty.empty());
+
+    destroy(root);
+    printf("FlatBinaryTree test successful!\n");
+    return EXIT_SUCCESS;
+}
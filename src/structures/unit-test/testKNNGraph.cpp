@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <algorithm>
+#include <cstdio>
+
+#include "../KNNGraph.hpp"
+#include "../../common/distance.hpp"
+#include "../../io/IO.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NSAMPLES = 300;
+constexpr size_t NFEATURES = 4;
+constexpr unsigned K = 6;
+
+// Exact kNN of `row` excluding itself
+std::vector<std::pair<data_t, sample_id_t> > brute(std::vector<data_t>& data,
+        const sample_id_t row) {
+    std::vector<std::pair<data_t, sample_id_t> > dists;
+    for (sample_id_t i = 0; i < NSAMPLES; i++)
+        if (i != row)
+            dists.push_back(std::make_pair(distance::euclidean(
+                            &data[row*NFEATURES], &data[i*NFEATURES],
+                            NFEATURES), i));
+    std::sort(dists.begin(), dists.end());
+    dists.resize(K);
+    return dists;
+}
+}
+
+int main(int argc, char* argv[]) {
+    // Rows keep the K nearest distinct ids in order
+    container::KNNGraph row(1, 3);
+    const bool inserted[] = { row.insert(0, 5, 3), row.insert(0, 6, 1),
+        row.insert(0, 6, .5), // Already there
+        row.insert(0, 7, 2),
+        row.insert(0, 8, 4), // Not near enough
+        row.insert(0, 9, 0) };
+    const bool expected_inserted[] = { true, true, false, true, false, true };
+    assert(std::equal(inserted, inserted+6, expected_inserted));
+    assert(row.get_size(0) == 3);
+    assert(row.get_ids(0)[0] == 9 && row.get_ids(0)[2] == 7);
+    assert(row.get_bound(0) == 2);
+
+    std::default_random_engine generator;
+    std::normal_distribution<data_t> distribution(0, 10);
+    std::vector<data_t> data(NSAMPLES*NFEATURES);
+    for (auto& v : data)
+        v = distribution(generator);
+
+    // One group holding everything is exact
+    std::vector<sample_id_t> all(NSAMPLES);
+    std::iota(all.begin(), all.end(), 0);
+    container::KNNGraph::ptr exact = container::KNNGraph::create(NSAMPLES, K);
+    exact->join(all, &data[0], NFEATURES);
+    for (sample_id_t r = 0; r < NSAMPLES; r++) {
+        auto expected = brute(data, r);
+        assert(exact->get_size(r) == K);
+        for (unsigned i = 0; i < K; i++)
+            assert(exact->get_dists(r)[i] == expected[i].first);
+    }
+
+    // Random partitions, like the leaves of two trees, find part of it.
+    //  Refinement recovers most of the rest
+    container::KNNGraph::ptr graph = container::KNNGraph::create(NSAMPLES, K);
+    for (unsigned tree = 0; tree < 2; tree++) {
+        std::shuffle(all.begin(), all.end(), generator);
+        for (size_t start = 0; start < NSAMPLES; start += 30)
+            graph->join(std::vector<sample_id_t>(&all[start], &all[start+30]),
+                    &data[0], NFEATURES);
+    }
+
+    auto recall = [&] () {
+        size_t nfound = 0;
+        for (sample_id_t r = 0; r < NSAMPLES; r++)
+            for (auto nn : brute(data, r))
+                nfound += std::find(graph->get_ids(r), graph->get_ids(r)+
+                        graph->get_size(r), nn.second) !=
+                    graph->get_ids(r)+graph->get_size(r);
+        return (double)nfound / (NSAMPLES*K);
+    };
+
+    double before = recall();
+    for (unsigned round = 0; round < 5; round++)
+        graph->refine(&data[0], NFEATURES, 2);
+    double after = recall();
+    printf("Recall before refinement: %.3f, after: %.3f\n", before, after);
+    assert(after > before && after > .9);
+
+    // Stream out & read back
+    exact->write("knn_graph.ivecs", "knn_graph.fvecs", 7);
+    std::vector<data_t> dists(NSAMPLES*K);
+    io::fvecs_reader("knn_graph.fvecs", NSAMPLES, K).read(&dists[0]);
+    assert(std::equal(dists.begin(), dists.end(), exact->get_dists(0)));
+
+    FILE* f = fopen("knn_graph.ivecs", "rb");
+    for (sample_id_t r = 0; r < NSAMPLES; r++) {
+        int rec[K+1];
+        const size_t nread = fread(rec, sizeof(int), K+1, f);
+        assert(nread == K+1);
+        assert(rec[0] == (int)K);
+        for (unsigned i = 0; i < K; i++)
+            assert(rec[i+1] == (int)exact->get_ids(r)[i]);
+    }
+    fclose(f);
+    remove("knn_graph.ivecs");
+    remove("knn_graph.fvecs");
+
+    printf("KNNGraph test successful!\n");
+    return EXIT_SUCCESS;
+}
@@ -18,8 +18,63 @@
  */
 
 #include "NAryNode.hpp"
+#include "../../io/IO.hpp"
+
+using namespace monya;
 
 int main(int argc, char* argv[]) {
+    constexpr child_t NCHILD = 9;
+    std::vector<data_t> data(4, 0);
+    io::IO* ioer = new io::MemoryIO(&data[0], dimpair(2, 2),
+            mat_orient_t::ROW);
+
+    container::NAryNode* root = new container::NAryNode;
+    root->set_ioer(ioer);
+    assert(!root->has_child());
+    assert(root->get_capacity() == 0);
+
+    // The child array doubles as it fills
+    std::vector<container::NAryNode*> childs;
+    for (child_t i = 0; i < NCHILD; i++) {
+        childs.push_back(new container::NAryNode);
+        root->add_child(childs.back());
+        assert(root->get_nchild() == i+1);
+        assert(root->get_capacity() >= root->get_nchild());
+    }
+    assert(root->has_child());
+    assert(root->get_capacity() == 16);
+
+    for (child_t i = 0; i < NCHILD; i++) {
+        assert(root->get_child(i) == childs[i]);
+        assert(childs[i]->get_parent() == root);
+        assert(childs[i]->get_depth() == 1);
+        assert(childs[i]->get_ioer() == ioer);
+    }
+
+    // ... and halves once it is a quarter full
+    for (child_t i = 0; i < NCHILD; i++)
+        root->remove_child();
+    assert(!root->has_child());
+    assert(root->get_capacity() == 2);
+    root->remove_child(); // No-op when empty
+
+    // A node built over a caller's array copies it
+    container::NodeView* given[4] = { childs[0], childs[1], NULL, NULL };
+    container::NAryNode* copied = new container::NAryNode(given, 2, 4);
+    copied->set_ioer(ioer);
+    given[0] = childs[2];
+    assert(copied->get_nchild() == 2 && copied->get_capacity() == 4);
+    assert(copied->get_child(0) == childs[0]);
+    copied->add_child(childs[3]);
+    assert(copied->get_child(2) == childs[3] && given[2] == NULL);
+    delete copied; // Leaves `given` alone
+
+    // Children aren't owned by the node
+    for (auto child : childs)
+        delete child;
+    delete root;
+    delete ioer;
 
+    std::cout << "NAryNode Test successful!\n\n";
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+#include <unistd.h>
+
+#include "../NodePager.hpp"
+#include "../BinaryNode.hpp"
+
+using namespace monya;
+
+namespace {
+constexpr size_t NLEAVES = 64;
+constexpr size_t PER_LEAF = 100;
+const size_t LEAF_BYTES = PER_LEAF*sizeof(IndexVal<data_t>);
+
+class TestNode : public container::BinaryNode {
+    public:
+        TestNode() {
+            parent = left = right = NULL;
+        }
+
+        void prep() override { }
+        void run() override { }
+};
+
+// Ids, values & sortedness all survive a page out
+void check_leaf(container::NodeView* leaf, const size_t i) {
+    IndexVector& index = leaf->get_data_index();
+    assert(index.size() == PER_LEAF);
+    assert(index.is_sorted() == (i % 2 == 0));
+    for (size_t j = 0; j < PER_LEAF; j++) {
+        assert(index[j].get_index() == i*PER_LEAF + j);
+        assert(index[j].get_val() == j);
+    }
+}
+
+// The budget counts exactly the resident leaves
+void check_accounting(container::NodePager* pager,
+        std::vector<TestNode*>& leaves) {
+    size_t resident = 0;
+    for (auto leaf : leaves)
+        resident += leaf->get_data_index().size()*sizeof(IndexVal<data_t>);
+    assert(pager->get_resident_bytes() == resident);
+}
+}
+
+int main(int argc, char* argv[]) {
+    const std::string fn = "test_node_pager.pages";
+    const size_t budget = 8*LEAF_BYTES;
+
+    std::vector<TestNode*> leaves;
+    for (size_t i = 0; i < NLEAVES; i++) {
+        leaves.push_back(new TestNode());
+        for (size_t j = 0; j < PER_LEAF; j++)
+            leaves.back()->data_index_append(i*PER_LEAF + j, j);
+        leaves.back()->get_data_index().set_sorted(i % 2 == 0);
+    }
+
+    container::NodePager* pager = new container::NodePager(fn, budget);
+    for (auto leaf : leaves) {
+        pager->add(leaf);
+        assert(pager->get_resident_bytes() <= budget);
+    }
+    assert(pager->get_nevictions() == NLEAVES - 8);
+    check_accounting(pager, leaves);
+    assert(!pager->is_resident(leaves.front()));
+    assert(pager->is_resident(leaves.back()));
+    assert(leaves.front()->get_data_index().empty());
+
+    // Faults may be served before the writeback lands ...
+    leaves[0]->cache(pager);
+    check_leaf(leaves[0], 0);
+    leaves[0]->uncache(pager);
+
+    // ... or from disk
+    pager->flush();
+    for (size_t i = 0; i < NLEAVES; i++) {
+        leaves[i]->cache(pager);
+        check_leaf(leaves[i], i);
+        leaves[i]->uncache(pager);
+        assert(pager->get_resident_bytes() <= budget);
+    }
+    check_accounting(pager, leaves);
+
+    // Pinned leaves survive pressure beyond the budget
+    for (size_t i = 0; i < 16; i++)
+        leaves[i]->cache(pager);
+    for (size_t i = 0; i < 16; i++)
+        assert(pager->is_resident(leaves[i]));
+    for (size_t i = 0; i < 16; i++)
+        leaves[i]->uncache(pager);
+    assert(pager->get_resident_bytes() <= budget);
+
+    // Explicit writeback. Unregistered (internal) nodes are untouched
+    leaves[20]->cache(pager);
+    leaves[20]->uncache(pager);
+    leaves[20]->persist(pager);
+    assert(!pager->is_resident(leaves[20]));
+    TestNode internal;
+    internal.data_index_append(0, 0);
+    internal.persist(pager);
+    assert(pager->is_resident(&internal));
+    assert(internal.get_data_index().size() == 1);
+
+    // Concurrent queries
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; t++)
+        threads.push_back(std::thread([&, t]() {
+            for (size_t i = t; i < NLEAVES; i += 2) {
+                leaves[i]->cache(pager);
+                check_leaf(leaves[i], i);
+                leaves[i]->uncache(pager);
+            }
+        }));
+    for (auto& thd : threads)
+        thd.join();
+    assert(pager->get_resident_bytes() <= budget);
+    check_accounting(pager, leaves);
+
+    // Shrinking a pinned leaf is accounted for on unpin
+    leaves[1]->cache(pager);
+    IndexVector half;
+    for (size_t j = 0; j < PER_LEAF/2; j++)
+        half.append(PER_LEAF + j, j);
+    leaves[1]->swap_data_index(half);
+    leaves[1]->uncache(pager);
+    check_accounting(pager, leaves);
+
+    delete pager;
+    assert(access(fn.c_str(), F_OK)); // Scratch file removed
+    for (auto leaf : leaves)
+        delete leaf;
+
+    printf("NodePager test successful!\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <cstdio>
+
+#include "../QueryStats.hpp"
+
+using namespace monya;
+
+namespace {
+void test_histograms() {
+    container::QueryHistograms hists;
+    assert(hists.quantile(container::QueryStats::NODES, .5) == 0);
+
+    // Distances 0, 1, 2, .., 99: bucket b holds [2^(b-1), 2^b)
+    for (size_t i = 0; i < 100; i++) {
+        container::QueryStats stats;
+        stats[container::QueryStats::DISTANCES] = i;
+        stats[container::QueryStats::LEAVES] = 1;
+        hists.add(stats);
+    }
+
+    assert(hists.get_nquery() == 100);
+    assert(hists.get_totals()[container::QueryStats::DISTANCES] == 4950);
+    assert(hists.mean(container::QueryStats::DISTANCES) == 49.5);
+    auto& buckets = hists.get_buckets(container::QueryStats::DISTANCES);
+    assert(buckets[0] == 1 && buckets[1] == 1 && buckets[2] == 2);
+    assert(buckets[7] == 100 - 64);
+    assert(hists.quantile(container::QueryStats::DISTANCES, .5) == 63);
+    assert(hists.quantile(container::QueryStats::DISTANCES, 1) == 127);
+    assert(hists.quantile(container::QueryStats::LEAVES, .99) == 1);
+    assert(hists.quantile(container::QueryStats::PRUNED, .99) == 0);
+
+    std::ostringstream json;
+    hists.write_json(json);
+    assert(json.str().find("\"nquery\": 100") != std::string::npos);
+    assert(json.str().find("\"leaves\": {\"mean\": 1, \"p50\": 1, "
+                "\"p99\": 1, \"buckets\": [0, 100]}") != std::string::npos);
+
+    hists.clear();
+    assert(!hists.get_nquery());
+    assert(!hists.get_totals()[container::QueryStats::DISTANCES]);
+    printf("Query histogram test successful!\n");
+}
+}
+
+int main(int argc, char* argv[]) {
+    test_histograms();
+    return EXIT_SUCCESS;
+}
@@ -60,6 +60,23 @@ void serial_test() {
         scheduler.schedule(v[i]);
     }
 
+#ifdef MONYA_INSTRUMENT
+    // Every node is counted once, at its own level
+    const monya::utils::BuildTrace& trace = scheduler.get_trace();
+    assert(trace.get_level_spans().size() == LEVEL);
+    for (unsigned level = 0; level < LEVEL; level++) {
+        size_t ntasks = 0;
+        for (auto& rec : trace.get_recorders()) {
+            auto& lc = rec.levels[level];
+            ntasks += lc.ntasks;
+            assert(lc.busy() + lc.wait + lc.idle <=
+                    trace.get_level_spans()[level].dur + 1e-9);
+        }
+        assert(ntasks == std::pow(FANOUT, level));
+    }
+    std::cout << "Build trace of " << LEVEL << " levels verified\n";
+#endif
+
     for (unsigned i = 0; i <v.size(); i++)
         delete(v[i]);
 
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Tombstone.hpp"
+#include "../Scheduler.hpp"
+#include "../BinaryNode.hpp"
+#include "../NodePager.hpp"
+
+using namespace monya;
+
+namespace {
+class TestNode : public container::BinaryNode {
+    public:
+        TestNode() {
+            parent = left = right = NULL;
+        }
+
+        void prep() override { }
+        void run() override { }
+};
+
+void test_bitmap() {
+    constexpr size_t NSAMPLES = 200;
+    container::Tombstone ts(NSAMPLES);
+    assert(ts.empty());
+
+    for (sample_id_t id = 0; id < NSAMPLES; id += 3)
+        assert(ts.set(id));
+    assert(!ts.set(0)); // Already deleted
+
+    for (sample_id_t id = 0; id < NSAMPLES; id++)
+        assert(ts.is_set(id) == (id % 3 == 0));
+    assert(ts.count() == (NSAMPLES + 2) / 3);
+
+    bool thrown = false;
+    try {
+        ts.set(NSAMPLES);
+    } catch (parameter_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    printf("Tombstone bitmap test successful!\n");
+}
+
+void test_compaction() {
+    constexpr size_t NSAMPLES = 1024;
+    constexpr size_t NLEAVES = 32;
+    constexpr unsigned NTHREAD = 4;
+
+    container::Tombstone ts(NSAMPLES);
+    container::Scheduler scheduler(2, 8, 0, NTHREAD, 0);
+    scheduler.set_tombstones(&ts);
+
+    // Each leaf holds a contiguous block of samples
+    std::vector<container::NodeView*> leaves;
+    const size_t per_leaf = NSAMPLES / NLEAVES;
+    for (size_t i = 0; i < NLEAVES; i++) {
+        leaves.push_back(new TestNode());
+        for (size_t j = 0; j < per_leaf; j++)
+            leaves.back()->data_index_append(i*per_leaf + j, j);
+    }
+
+    // Delete all even samples & everything in leaf 0
+    for (sample_id_t id = 0; id < NSAMPLES; id += 2)
+        ts.set(id);
+    for (sample_id_t id = 0; id < per_leaf; id++)
+        ts.set(id);
+
+    scheduler.compact(leaves);
+
+    for (size_t i = 0; i < NLEAVES; i++) {
+        IndexVector& index = leaves[i]->get_data_index();
+        assert(index.size() == (i == 0 ? 0 : per_leaf / 2));
+
+        for (auto it = index.begin(); it != index.end(); ++it)
+            assert(!ts.is_set(it->get_index()));
+    }
+
+    // A second pass with no new deletes leaves the indexes untouched
+    scheduler.compact(leaves);
+    assert(leaves.back()->get_data_index().size() == per_leaf / 2);
+
+    // A reader leaving by an exception releases the lock, so a later
+    //  pass can take it to swap indexes
+    try {
+        container::ReadGuard guard(&scheduler);
+        throw io_exception("reader failed");
+    } catch (io_exception& e) {
+    }
+    ts.set(per_leaf + 1); // Odd, in leaf 1
+    scheduler.compact(leaves);
+    assert(leaves[1]->get_data_index().size() == per_leaf / 2 - 1);
+
+    for (auto leaf : leaves)
+        delete(leaf);
+
+    printf("Tombstone compaction test successful!\n");
+}
+
+// Leaves paged out are faulted in & compacted, not skipped
+void test_paged_compaction() {
+    constexpr size_t NLEAVES = 32, PER_LEAF = 64;
+    container::Tombstone ts(NLEAVES*PER_LEAF);
+    container::Scheduler scheduler(2, 8, 0, 4, 0);
+    scheduler.set_tombstones(&ts);
+
+    const size_t leaf_bytes = PER_LEAF*sizeof(IndexVal<data_t>);
+    container::NodePager pager("test_tombstone.pages", 4*leaf_bytes);
+    std::vector<container::NodeView*> leaves;
+    for (size_t i = 0; i < NLEAVES; i++) {
+        leaves.push_back(new TestNode());
+        for (size_t j = 0; j < PER_LEAF; j++)
+            leaves.back()->data_index_append(i*PER_LEAF + j, j);
+        pager.add(leaves.back());
+    }
+    assert(!pager.is_resident(leaves.front()));
+
+    for (sample_id_t id = 0; id < NLEAVES*PER_LEAF; id += 2)
+        ts.set(id);
+    scheduler.compact(leaves, &pager);
+
+    // Every leaf shrank & the budget counts the shrunk sizes
+    assert(pager.get_resident_bytes() <= 4*leaf_bytes);
+    for (auto leaf : leaves) {
+        pager.pin(leaf);
+        IndexVector& index = leaf->get_data_index();
+        assert(index.size() == PER_LEAF/2);
+        for (auto it = index.begin(); it != index.end(); ++it)
+            assert(!ts.is_set(it->get_index()));
+        pager.unpin(leaf);
+    }
+    size_t resident = 0;
+    for (auto leaf : leaves)
+        resident += leaf->get_data_index().size()*sizeof(IndexVal<data_t>);
+    assert(pager.get_resident_bytes() == resident);
+
+    for (auto leaf : leaves)
+        delete(leaf);
+    printf("Tombstone paged compaction test successful!\n");
+}
+}
+
+int main(int argc, char* argv[]) {
+    test_bitmap();
+    test_compaction();
+    test_paged_compaction();
+    return EXIT_SUCCESS;
+}
@@ -30,13 +30,15 @@ using namespace monya;
 
 namespace {
 void init_threads(std::vector<WorkerThread::raw_ptr>& threads,
-        const int NTHREADS, pthread_cond_t& cond, std::atomic<unsigned>& ppt ) {
+        const int NTHREADS, pthread_cond_t& cond, pthread_mutex_t& mutex,
+        std::atomic<unsigned>& ppt) {
 
     const int NNUMA_NODES = utils::get_num_nodes();
 
     for (int tid = 0; tid < NTHREADS; tid++) {
         threads.push_back(new WorkerThread(tid % NNUMA_NODES, tid));
         threads.back()->set_parent_cond(&cond);
+        threads.back()->set_parent_lock(&mutex);
         threads.back()->set_parent_pending_threads(&ppt);
         threads.back()->init();
     }
@@ -61,7 +63,7 @@ int main(int argv, char* argc[]) {
 
     // Make threads
     std::vector<WorkerThread::raw_ptr> threads;
-    init_threads(threads, NTHREADS, cond, ppt);
+    init_threads(threads, NTHREADS, cond, mutex, ppt);
 
     // Block for completion
     pthread_mutex_lock(&mutex);
@@ -92,6 +94,8 @@ int main(int argv, char* argc[]) {
 
     // Delete the threads (calls join)
     printf("Coordinated deallocates the threads ...\n");
+    for (WorkerThread* thread : threads)
+        thread->wake(EXIT); // Nothing may wait on a thread's cond at delete
     for (size_t tid = 0; tid < threads.size(); tid++) {
         delete(threads[tid]);
     }
@@ -36,7 +36,7 @@ inline bool file_exists(const std::string& fn) {
     return static_cast<bool>(file);
 }
 
-static std::string get_file_ext(const std::string& s) {
+inline std::string get_file_ext(const std::string& s) {
     size_t i = s.rfind('.', s.length());
 
     if (i != std::string::npos) {
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2018 Neurodata (https://neurodata.io)
+ * Written by Disa Mhembere (disa@cs.jhu.edu)
+ *
+ * This file is part of Monya.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONYA_INSTRUMENT_HPP__
+#define MONYA_INSTRUMENT_HPP__
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include "../common/types.hpp"
+
+// Build with `make INSTRUMENT=1` to record build timings. Otherwise the
+//  hooks below compile to nothing & the recorders are never allocated
+#ifdef MONYA_INSTRUMENT
+#define INSTR(stmt) stmt
+#else
+#define INSTR(stmt)
+#endif
+
+namespace monya { namespace utils {
+
+// Seconds on a monotonic clock
+inline double now() {
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// What one worker did during one level of the build
+struct LevelCounters {
+    size_t ntasks; // Nodes prepped & run
+    double prep; // Fetching data through the ioer
+    double run; // Node computation e.g. sorting
+    double wait; // Dequeueing tasks, including task queue lock contention
+    double idle; // Done with its tasks but held at the level barrier
+    size_t io_bytes; // Bytes served by the ioer to this thread
+
+    LevelCounters() : ntasks(0), prep(0), run(0), wait(0), idle(0),
+        io_bytes(0) { }
+
+    const double busy() const { return prep + run; }
+};
+
+// A complete ('X') event in Chrome's trace_event format
+struct TraceEvent {
+    const char* name;
+    depth_t level;
+    double start;
+    double dur;
+
+    TraceEvent(const char* name, const depth_t level, const double start,
+            const double dur) : name(name), level(level), start(start),
+            dur(dur) { }
+};
+
+/**
+  \brief Counters owned by a single worker thread. Only that thread writes
+    them while a level runs; the scheduler reads them at the level barrier
+  */
+class ThreadRecorder {
+    public:
+        int tid;
+        depth_t level; // Set by the scheduler before waking the thread
+        std::vector<LevelCounters> levels;
+        std::vector<TraceEvent> events;
+
+        ThreadRecorder() : tid(0), level(0) { }
+
+        LevelCounters& current() { return levels[level]; }
+
+        // Each returns the time it closed its interval to chain the next
+        double dequeued(const double start) {
+            double t = now();
+            current().wait += t - start;
+            return t;
+        }
+
+        double prepped(const double start) {
+            double t = now();
+            current().prep += t - start;
+            events.push_back(TraceEvent("prep", level, start, t - start));
+            return t;
+        }
+
+        double ran(const double start) {
+            double t = now();
+            current().run += t - start;
+            current().ntasks++;
+            events.push_back(TraceEvent("run", level, start, t - start));
+            return t;
+        }
+};
+
+// The recorder of the calling worker thread. NULL on any other thread
+inline ThreadRecorder*& local_recorder() {
+    static thread_local ThreadRecorder* rec = NULL;
+    return rec;
+}
+
+// Called by the IO layer for every row or column it hands out
+inline void add_io_bytes(const size_t nbytes) {
+#ifdef MONYA_INSTRUMENT
+    ThreadRecorder* rec = local_recorder();
+    if (NULL != rec && rec->level < rec->levels.size())
+        rec->current().io_bytes += nbytes;
+#endif
+}
+
+/**
+  \brief The build timeline of one tree: a span per level from the
+    scheduler plus a recorder per worker thread
+  */
+class BuildTrace {
+    private:
+        tree_t tree_id;
+        std::vector<ThreadRecorder> recorders;
+        std::vector<TraceEvent> level_spans;
+
+    public:
+        BuildTrace(const tree_t tree_id, const unsigned nthread) :
+            tree_id(tree_id), recorders(nthread) {
+            for (unsigned tid = 0; tid < nthread; tid++)
+                recorders[tid].tid = tid;
+        }
+
+        // Sized once so the pointers handed to workers stay valid
+        ThreadRecorder* get_recorder(const unsigned tid) {
+            return &recorders[tid];
+        }
+
+        // Call while the workers wait
+        void begin_level(const depth_t level) {
+            for (auto& rec : recorders) {
+                rec.level = level;
+                if (rec.levels.size() <= level)
+                    rec.levels.resize(level + 1);
+            }
+        }
+
+        // Call after the level barrier. Time a thread was neither busy nor
+        //  dequeueing was spent idle at the barrier
+        void end_level(const depth_t level, const double start,
+                const double end) {
+            level_spans.push_back(TraceEvent("level", level, start,
+                        end - start));
+            for (auto& rec : recorders) {
+                LevelCounters& lc = rec.levels[level];
+                lc.idle = std::max(0.0, (end - start) - lc.busy() - lc.wait);
+            }
+        }
+
+        const tree_t get_tree_id() const { return tree_id; }
+        const std::vector<ThreadRecorder>& get_recorders() const {
+            return recorders;
+        }
+        const std::vector<TraceEvent>& get_level_spans() const {
+            return level_spans;
+        }
+
+        const double get_start() const {
+            return level_spans.empty() ? 0 : level_spans[0].start;
+        }
+};
+
+/**
+  \brief Per-tree, per-level, per-thread counters as a JSON document
+  */
+inline void write_build_json(std::ostream& os,
+        const std::vector<const BuildTrace*>& traces) {
+    os << "{\"trees\": [";
+    for (size_t t = 0; t < traces.size(); t++) {
+        const BuildTrace* trace = traces[t];
+        os << (t ? ", " : "") << "\n  {\"tree\": " << trace->get_tree_id()
+            << ", \"levels\": [";
+
+        auto& spans = trace->get_level_spans();
+        for (size_t l = 0; l < spans.size(); l++) {
+            os << (l ? "," : "") << "\n    {\"level\": " << spans[l].level
+                << ", \"sec\": " << spans[l].dur << ", \"threads\": [";
+
+            auto& recs = trace->get_recorders();
+            for (size_t r = 0; r < recs.size(); r++) {
+                const LevelCounters& lc = recs[r].levels[spans[l].level];
+                os << (r ? ", " : "") << "{\"tid\": " << recs[r].tid
+                    << ", \"ntasks\": " << lc.ntasks
+                    << ", \"busy_sec\": " << lc.busy()
+                    << ", \"prep_sec\": " << lc.prep
+                    << ", \"run_sec\": " << lc.run
+                    << ", \"wait_sec\": " << lc.wait
+                    << ", \"idle_sec\": " << lc.idle
+                    << ", \"io_bytes\": " << lc.io_bytes << "}";
+            }
+            os << "]}";
+        }
+        os << "]}";
+    }
+    os << "\n]}\n";
+}
+
+/**
+  \brief Chrome trace_event JSON viewable in chrome://tracing or Perfetto.
+    One process per tree; the scheduler's level spans sit on the lane after
+    the worker threads
+  */
+inline void write_chrome_trace(std::ostream& os,
+        const std::vector<const BuildTrace*>& traces) {
+    double origin = 0;
+    bool first = true;
+    for (auto trace : traces) {
+        if (trace->get_level_spans().empty())
+            continue;
+        origin = first ? trace->get_start() :
+            std::min(origin, trace->get_start());
+        first = false;
+    }
+
+    first = true;
+    auto emit = [&](const TraceEvent& ev, const tree_t pid, const int tid) {
+        os << (first ? "\n" : ",\n") << "{\"name\": \"" << ev.name
+            << "\", \"cat\": \"build\", \"ph\": \"X\", \"ts\": "
+            << (ev.start - origin)*1e6 << ", \"dur\": " << ev.dur*1e6
+            << ", \"pid\": " << pid << ", \"tid\": " << tid
+            << ", \"args\": {\"level\": " << ev.level << "}}";
+        first = false;
+    };
+
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (auto trace : traces) {
+        const tree_t pid = trace->get_tree_id();
+        const int sched_tid = trace->get_recorders().size();
+
+        os << (first ? "\n" : ",\n") << "{\"name\": \"process_name\", "
+            "\"ph\": \"M\", \"pid\": " << pid << ", \"args\": {\"name\": "
+            "\"tree " << pid << "\"}},\n{\"name\": \"thread_name\", "
+            "\"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << sched_tid
+            << ", \"args\": {\"name\": \"scheduler\"}}";
+        first = false;
+
+        for (auto& span : trace->get_level_spans())
+            emit(span, pid, sched_tid);
+        for (auto& rec : trace->get_recorders())
+            for (auto& ev : rec.events)
+                emit(ev, pid, rec.tid);
+    }
+    os << "\n]}\n";
+}
+
+} } // End namespace monya::utils
+#endif
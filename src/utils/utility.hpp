@@ -22,6 +22,8 @@
 
 #include <limits>
 #include <algorithm>
+#include <fstream>
+#include <unistd.h>
 #include "../common/types.hpp"
 
 #ifdef USE_NUMA
@@ -45,5 +47,14 @@ int get_num_nodes() {
 #endif
 }
 
+// Resident set size of this process in bytes. 0 without /proc
+inline size_t get_resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t npages, nresident;
+    if (statm >> npages >> nresident)
+        return nresident*sysconf(_SC_PAGESIZE);
+    return 0;
+}
+
 } } // End namespace monya::utils
 #endif
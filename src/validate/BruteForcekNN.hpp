@@ -20,57 +20,262 @@
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
 
 #include "../common/monya.hpp"
 #include "../common/distance.hpp"
 
 namespace monya { namespace validate {
-// The idea is to collect all the data and pass it this class
-//  then compute all pairwise distances. This is not fast or
-//  scalable!
-class BruteForcekNN {
+/**
+  * Exact kNN by scanning every sample. Our ground truth for recall.
+  *  Batches of queries are split into blocks that run in parallel. Each
+  *  block is scored against a tile of samples with one GEMM
+  *  (||x||^2 + ||y||^2 - 2xy) & only the samples that may enter a query's
+  *  bounded heap get their distance recomputed directly, so results match
+  *  distance::euclidean bit for bit. Samples are either in memory or
+  *  streamed from disk a chunk at a time. `T` is float or double, e.g. a
+  *  double precision baseline for float trees.
+  */
+template <typename T>
+class BasicBruteForcekNN {
+    public:
+        // Fills `buf` with up to `nrow` of the next rows (row major).
+        //  Returns the # read, 0 once the rows run out
+        typedef std::function<size_t(T* buf, const size_t nrow)>
+            row_stream;
+        // Starts a new pass over the rows
+        typedef std::function<row_stream()> row_source;
 
     private:
-        data_t* data;
+        // Max-heap on (dist, id) of the k best so far
+        typedef std::vector<std::pair<T, sample_id_t> > heap_t;
+
+        static constexpr size_t QBLOCK = 64; // Queries per parallel task
+        static constexpr size_t TILE = 1024; // Samples per GEMM
+
+        T* data; // NULL when streaming
+        row_source source;
         size_t nsamples;
         size_t nfeatures;
+        unsigned nthread;
+        size_t chunk; // Rows streamed in at a time
 
-    public:
-        BruteForcekNN(data_t* _data, const sample_id_t _nsamples,
-                const size_t _nfeatures):
-            data(_data), nsamples(_nsamples), nfeatures(_nfeatures) {
+        static void offer(heap_t& heap, const size_t k, const T dist,
+                const sample_id_t id) {
+            if (heap.size() < k) {
+                heap.push_back(std::make_pair(dist, id));
+                std::push_heap(heap.begin(), heap.end());
+            } else if (std::make_pair(dist, id) < heap.front()) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = std::make_pair(dist, id);
+                std::push_heap(heap.begin(), heap.end());
+            }
         }
 
-        IndexVector getNN(data_t* sample, const long k) {
-            IndexVector NN;
+        static BasicIndexVector<T> to_index_vector(heap_t& heap) {
+            std::sort_heap(heap.begin(), heap.end());
+            BasicIndexVector<T> NN;
+            for (auto& nn : heap)
+                NN.append(nn.second, nn.first);
+            return NN;
+        }
+
+        // Offer the `nrow` rows numbered from `first` to the heap of every
+        //  query in [qstart, qend)
+        void scan_block(T* rows, const size_t nrow,
+                const sample_id_t first, T* queries, const size_t qstart,
+                const size_t qend, const size_t k,
+                std::vector<heap_t>& heaps) {
+            const size_t nq = qend - qstart;
+            std::vector<T> centered(TILE*nfeatures);
+            std::vector<T> cqueries(nq*nfeatures);
+            std::vector<T> qnorm2(nq);
+            std::vector<T> dists(nq*TILE);
+            std::vector<double> centroid(nfeatures);
+
+            for (size_t t = 0; t < nrow; t += TILE) {
+                const size_t ntile = nrow - t < TILE ? nrow - t : TILE;
+                T* tile = &rows[t*nfeatures];
 
-            for(size_t i = 0; i < nsamples; i++) {
-                auto dist = distance::euclidean(sample, &data[i*nfeatures],
-                        nfeatures);
+                // Centering on the tile keeps the norms small so the GEMM
+                //  form loses little precision for nearby queries
+                std::fill(centroid.begin(), centroid.end(), 0);
+                for (size_t i = 0; i < ntile; i++)
+                    for (size_t j = 0; j < nfeatures; j++)
+                        centroid[j] += tile[i*nfeatures+j];
+                for (size_t j = 0; j < nfeatures; j++)
+                    centroid[j] /= ntile;
 
-                if (i < (unsigned)k) {
-                    NN.append(i, dist);
-                } else {
-                    if (i == (unsigned) k)
-                        NN.sort();
+                T max_norm2 = 0;
+                for (size_t i = 0; i < ntile; i++) {
+                    T norm2 = 0;
+                    for (size_t j = 0; j < nfeatures; j++) {
+                        T v = tile[i*nfeatures+j] - centroid[j];
+                        centered[i*nfeatures+j] = v;
+                        norm2 += v*v;
+                    }
+                    max_norm2 = std::max(max_norm2, norm2);
+                }
 
-                    long repl_indx = -1;
-                    for (long j = k - 1; j >= 0; j--) {
-                        if (dist < NN[j].get_val()) { // NOTE: Strictly less than
-                            repl_indx = j;
-                        }
+                for (size_t q = 0; q < nq; q++) {
+                    qnorm2[q] = 0;
+                    for (size_t j = 0; j < nfeatures; j++) {
+                        T v = queries[(qstart+q)*nfeatures+j] -
+                            centroid[j];
+                        cqueries[q*nfeatures+j] = v;
+                        qnorm2[q] += v*v;
                     }
+                }
+
+                distance::euclidean(&cqueries[0], nq, &centered[0], ntile,
+                        nfeatures, &dists[0]);
+
+                for (size_t q = 0; q < nq; q++) {
+                    heap_t& heap = heaps[qstart+q];
+                    T* query = &queries[(qstart+q)*nfeatures];
+                    const T slack = distance::gemm_slack(nfeatures,
+                            qnorm2[q], max_norm2);
 
-                    if (repl_indx >= 0) {
-                        NN.insert(IndexVal<data_t>(i, dist), repl_indx);
+                    for (size_t i = 0; i < ntile; i++) {
+                        const T dist = dists[q*ntile+i];
+                        if (heap.size() == k && dist*dist >
+                                heap.front().first*heap.front().first + slack)
+                            continue;
+                        offer(heap, k, distance::euclidean(query,
+                                    &tile[i*nfeatures], nfeatures),
+                                first+t+i);
                     }
                 }
             }
+        }
+
+        // Offer `nrow` rows to every query, a block of queries per thread
+        void scan(T* rows, const size_t nrow, const sample_id_t first,
+                T* queries, const size_t nquery, const size_t k,
+                std::vector<heap_t>& heaps) {
+            const size_t nblock = (nquery + QBLOCK - 1) / QBLOCK;
+#pragma omp parallel for num_threads(nthread) schedule(dynamic)
+            for (size_t b = 0; b < nblock; b++)
+                scan_block(rows, nrow, first, queries, b*QBLOCK,
+                        std::min(nquery, (b+1)*QBLOCK), k, heaps);
+        }
 
-            if (NN.size() > (unsigned)k)  {
-                NN.trim(k);
+    public:
+        BasicBruteForcekNN(T* _data, const sample_id_t _nsamples,
+                const size_t _nfeatures, const unsigned _nthread=1):
+            data(_data), nsamples(_nsamples), nfeatures(_nfeatures),
+            nthread(_nthread), chunk(0) {
+        }
+
+        // Out-of-core: Only `chunk` rows are held at a time
+        BasicBruteForcekNN(row_source _source, const size_t _nfeatures,
+                const unsigned _nthread=1, const size_t _chunk=1<<16):
+            data(NULL), source(_source), nsamples(0), nfeatures(_nfeatures),
+            nthread(_nthread), chunk(_chunk) {
+            if (!chunk)
+                throw parameter_exception("BruteForcekNN: chunk must be "
+                        "positive");
+        }
+
+        // Row major binary file as written by SyncIO
+        static row_source bin_source(const std::string fn,
+                const size_t nfeatures) {
+            return [fn, nfeatures] () {
+                std::shared_ptr<std::ifstream> fs(
+                        new std::ifstream(fn, std::ios::binary));
+                if (!fs->is_open())
+                    throw io_exception(std::string("Failure to open file: '")
+                            + fn + std::string("'\n"));
+                return row_stream([fs, nfeatures] (T* buf,
+                            const size_t nrow) {
+                    fs->read(reinterpret_cast<char*>(buf),
+                            nrow*nfeatures*sizeof(T));
+                    return static_cast<size_t>(fs->gcount()) /
+                        (nfeatures*sizeof(T));
+                });
+            };
+        }
+
+        // Each row is prefixed with its dimension
+        static row_source fvecs_source(const std::string fn,
+                const size_t nfeatures) {
+            return [fn, nfeatures] () {
+                std::shared_ptr<std::ifstream> fs(
+                        new std::ifstream(fn, std::ios::binary));
+                if (!fs->is_open())
+                    throw io_exception(std::string("Failure to open file: '")
+                            + fn + std::string("'\n"));
+                return row_stream([fs, fn, nfeatures] (T* buf,
+                            const size_t nrow) {
+                    size_t nread = 0;
+                    int dim;
+                    std::vector<float> row(nfeatures);
+                    for (; nread < nrow; nread++) {
+                        if (!fs->read(reinterpret_cast<char*>(&dim),
+                                    sizeof(dim)))
+                            break;
+                        if (dim != static_cast<int>(nfeatures))
+                            throw io_exception("fvecs row dimension mismatch");
+                        if (!fs->read(reinterpret_cast<char*>(&row[0]),
+                                    nfeatures*sizeof(float)))
+                            throw io_exception("Short read of '" + fn +
+                                    "' at row " + std::to_string(nread));
+                        std::copy(row.begin(), row.end(),
+                                &buf[nread*nfeatures]);
+                    }
+                    return nread;
+                });
+            };
+        }
+
+        /**
+          \brief The exact kNN of each of `nquery` row major `queries`.
+            Ties go to the lower sample id.
+          */
+        void getNN(T* queries, const size_t nquery, const size_t k,
+                std::vector<BasicIndexVector<T>>& NN) {
+            std::vector<heap_t> heaps(nquery);
+            for (auto& heap : heaps)
+                heap.reserve(k);
+
+            if (data) {
+                scan(data, nsamples, 0, queries, nquery, k, heaps);
+            } else {
+                std::vector<T> rows(chunk*nfeatures);
+                row_stream stream = source();
+                sample_id_t first = 0;
+                size_t nrow;
+                while ((nrow = stream(&rows[0], chunk))) {
+                    scan(&rows[0], nrow, first, queries, nquery, k, heaps);
+                    first += nrow;
+                }
             }
-            return NN;
+
+            NN.resize(nquery);
+#pragma omp parallel for num_threads(nthread)
+            for (size_t q = 0; q < nquery; q++)
+                NN[q] = to_index_vector(heaps[q]);
+        }
+
+        BasicIndexVector<T> getNN(T* sample, const long k) {
+            if (NULL == data) {
+                std::vector<BasicIndexVector<T>> NN;
+                getNN(sample, 1, k, NN);
+                return NN[0];
+            }
+
+            // One query gains nothing from the GEMM
+            heap_t heap;
+            heap.reserve(k);
+            for (size_t i = 0; i < nsamples; i++)
+                offer(heap, k, distance::euclidean(sample, &data[i*nfeatures],
+                            nfeatures), i);
+            return to_index_vector(heap);
         }
 };
+typedef BasicBruteForcekNN<data_t> BruteForcekNN;
 }} // End namespace monya::validate
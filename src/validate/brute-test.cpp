@@ -17,6 +17,9 @@
  * limitations under the License.
  */
 
+#include <random>
+#include <algorithm>
+
 #include "BruteForcekNN.hpp"
 #include "../io/IO.hpp"
 
@@ -48,6 +51,107 @@ int main(int argc, char** argv) {
         iv.print();
     }
 
+    // Batched & streamed scans must agree with the single query scan
+    std::vector<IndexVector> batch, streamed;
+    BruteForcekNN pbf (&data[0], nsamples, nfeatures, 2);
+    pbf.getNN(&data[0], nsamples, k, batch);
+
+    BruteForcekNN sbf (BruteForcekNN::bin_source(fn, nfeatures), nfeatures,
+            2, 7);
+    sbf.getNN(&data[0], nsamples, k, streamed);
+
+    for (sample_id_t sid = 0; sid < nsamples; sid++) {
+        auto iv = bf.getNN(&data[sid*nfeatures], k);
+        assert(iv.size() == k && batch[sid].size() == k &&
+                streamed[sid].size() == k);
+        assert(iv[0].get_index() == sid && iv[0].get_val() == 0);
+        for (size_t i = 0; i < k; i++) {
+            assert(batch[sid][i].get_index() == iv[i].get_index());
+            assert(batch[sid][i].get_val() == iv[i].get_val());
+            assert(streamed[sid][i].get_index() == iv[i].get_index());
+            assert(streamed[sid][i].get_val() == iv[i].get_val());
+        }
+    }
+    std::cout << "Batched & streamed scans match\n";
+
+    // A double precision baseline finds the same neighbors
+    std::vector<double> ddata(data.begin(), data.end());
+    std::vector<BasicIndexVector<double> > dbatch;
+    BasicBruteForcekNN<double>(&ddata[0], nsamples, nfeatures, 2).getNN(
+            &ddata[0], nsamples, k, dbatch);
+    for (sample_id_t sid = 0; sid < nsamples; sid++)
+        for (size_t i = 0; i < k; i++) {
+            assert(dbatch[sid][i].get_index() == batch[sid][i].get_index());
+            assert(std::fabs(dbatch[sid][i].get_val() -
+                        batch[sid][i].get_val()) < 1e-4);
+        }
+    std::cout << "Double precision scan matches\n";
+
+    // A truncated fvecs row is reported, not streamed as garbage
+    {
+        std::ofstream fs("short.fvecs", std::ios::binary);
+        const int32_t dim = nfeatures;
+        for (sample_id_t sid = 0; sid < 2; sid++) {
+            fs.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+            fs.write(reinterpret_cast<const char*>(&data[sid*nfeatures]),
+                    (sid ? nfeatures/2 : nfeatures)*sizeof(float));
+        }
+    }
+    BruteForcekNN::row_stream fvecs =
+        BruteForcekNN::fvecs_source("short.fvecs", nfeatures)();
+    assert(fvecs(&data[0], 1) == 1);
+    bool thrown = false;
+    try {
+        fvecs(&data[0], 1);
+    } catch (io_exception& e) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::remove("short.fvecs");
+    std::cout << "Short fvecs row reported\n";
+
+    // At high dimension the GEMM screen still keeps every true neighbor:
+    //  matches a plain scalar scan, ties to the lower id
+    {
+        constexpr size_t HD_NSAMPLES = 1500, HD_NFEATURES = 960, NQUERY = 24;
+        constexpr size_t HD_K = 10;
+        // Two tight clusters far from the tiles' centroids: the GEMM form's
+        //  error dwarfs the gaps between a query's neighbors
+        std::default_random_engine generator(9);
+        std::normal_distribution<data_t> distribution(0, 1e-1);
+        std::vector<data_t> hd(HD_NSAMPLES*HD_NFEATURES);
+        for (size_t i = 0; i < hd.size(); i++)
+            hd[i] = (i / HD_NFEATURES % 2 ? 50 : -50) +
+                distribution(generator);
+
+        std::normal_distribution<data_t> noise(0, 1e-2);
+        std::vector<data_t> queries(NQUERY*HD_NFEATURES);
+        for (size_t q = 0; q < NQUERY; q++)
+            for (size_t j = 0; j < HD_NFEATURES; j++)
+                queries[q*HD_NFEATURES+j] =
+                    hd[q*61*HD_NFEATURES+j] + noise(generator);
+
+        std::vector<IndexVector> hdnn;
+        BruteForcekNN(&hd[0], HD_NSAMPLES, HD_NFEATURES, 2).getNN(
+                &queries[0], NQUERY, HD_K, hdnn);
+
+        for (size_t q = 0; q < NQUERY; q++) {
+            std::vector<std::pair<data_t, sample_id_t> > scalar;
+            for (sample_id_t sid = 0; sid < HD_NSAMPLES; sid++)
+                scalar.push_back(std::make_pair(distance::euclidean(
+                                &queries[q*HD_NFEATURES],
+                                &hd[sid*HD_NFEATURES], HD_NFEATURES), sid));
+            std::sort(scalar.begin(), scalar.end());
+
+            assert(hdnn[q].size() == HD_K);
+            for (size_t i = 0; i < HD_K; i++) {
+                assert(hdnn[q][i].get_index() == scalar[i].second);
+                assert(hdnn[q][i].get_val() == scalar[i].first);
+            }
+        }
+        std::cout << "High dimension scan matches the scalar scan\n";
+    }
+
     ioer->destroy();
     return 0;
 }